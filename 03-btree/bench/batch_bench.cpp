@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* A tree of N random keys takes sorted batches of fresh random keys, then
+ * has them removed again, one key at a time or one batch at a time. The
+ * larger the batch, the more of each descent a batch shares. */
+
+static constexpr size_t N = 1'000'000;
+static constexpr size_t BATCHED = 1'000'000;
+static constexpr size_t B = 6;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+static void measure(size_t batch_size, const std::vector<uint64_t>& base,
+                    const std::vector<uint64_t>& fresh) {
+    BTree<uint64_t, B> one, batched;
+    for (auto k : base) {
+        one.insert(k);
+        batched.insert(k);
+    }
+
+    /* Each batch is sorted up front, outside the timings */
+    std::vector<std::vector<uint64_t>> batches;
+    for (size_t i = 0; i < fresh.size(); i += batch_size) {
+        batches.emplace_back(fresh.begin() + i,
+                             fresh.begin() + std::min(i + batch_size, fresh.size()));
+        std::sort(batches.back().begin(), batches.back().end());
+    }
+
+    double insert_one = ns_per_op(fresh.size(), [&] {
+        for (auto& batch : batches)
+            for (auto k : batch)
+                one.insert(k);
+    });
+
+    double insert_batch = ns_per_op(fresh.size(), [&] {
+        for (auto& batch : batches)
+            batched.insert_batch(batch.begin(), batch.end());
+    });
+
+    double remove_one = ns_per_op(fresh.size(), [&] {
+        for (auto& batch : batches)
+            for (auto k : batch)
+                one.remove(k);
+    });
+
+    size_t removed = 0;
+    double remove_batch = ns_per_op(fresh.size(), [&] {
+        for (auto& batch : batches)
+            removed += batched.remove_batch(batch.begin(), batch.end());
+    });
+
+    if (removed != fresh.size())
+        std::fprintf(stderr, "batch %zu: removed %zu of %zu\n", batch_size, removed, fresh.size());
+
+    std::printf("%10zu %12.1f %12.1f %12.1f %12.1f\n",
+                batch_size, insert_one, insert_batch, remove_one, remove_batch);
+}
+
+int main() {
+    std::mt19937_64 g(42);
+
+    std::vector<uint64_t> base(N), fresh(BATCHED);
+    for (auto& k : base)
+        k = g();
+    for (auto& k : fresh)
+        k = g();
+
+    std::printf("%10s %12s %12s %12s %12s\n",
+                "batch", "insert ns", "batch ns", "remove ns", "batch ns");
+
+    for (size_t batch_size : {16, 256, 4096, 65536})
+        measure(batch_size, base, fresh);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "betree.hpp"
+#include "btree.hpp"
+
+/* Write-heavy workload: N random inserts, then LOOKUPS random lookups of
+ * present keys, for BTree and for Bε-trees with several buffer sizes.
+ *
+ * A BTree insert writes one leaf per key; the Bε-tree reports how many leaf
+ * writes its batched flushes needed per key. */
+
+static constexpr size_t N = 2'000'000;
+static constexpr size_t LOOKUPS = 1'000'000;
+static constexpr size_t B = 16;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename Tree>
+static void measure(const char* name, const std::vector<uint64_t>& keys) {
+    Tree tree;
+
+    double insert_ns = ns_per_op(keys.size(), [&] {
+        for (auto k : keys)
+            tree.insert(k);
+    });
+
+    std::mt19937_64 g(1);
+    size_t misses = 0;
+    double lookup_ns = ns_per_op(LOOKUPS, [&] {
+        for (size_t i = 0; i < LOOKUPS; i++)
+            misses += !tree.contains(keys[g() % keys.size()]);
+    });
+
+    if (misses)
+        std::fprintf(stderr, "%s: %zu unexpected misses\n", name, misses);
+
+    double leaf_writes = 1.0;
+    if constexpr (!std::is_same_v<Tree, BTree<uint64_t, B>>)
+        leaf_writes = double(tree.stats.leaf_writes) / keys.size();
+
+    std::printf("%-16s %12.1f %16.3f %12.1f\n", name, insert_ns, leaf_writes, lookup_ns);
+}
+
+int main() {
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 g(42);
+    for (auto& k : keys)
+        k = g();
+
+    std::printf("%-16s %12s %16s %12s\n", "tree", "insert ns", "leaf writes/key", "lookup ns");
+
+    measure<BTree<uint64_t, B>>("BTree", keys);
+    measure<BeTree<uint64_t, B, 4 * B>>("BeTree buf=4B", keys);
+    measure<BeTree<uint64_t, B, 16 * B>>("BeTree buf=16B", keys);
+    measure<BeTree<uint64_t, B, 64 * B>>("BeTree buf=64B", keys);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "btree.hpp"
+#include "concurrent_btree.hpp"
+
+/* Insert and lookup throughput of ConcurrentBTree against a BTree behind one
+ * global mutex, for 1, 2, 4, ... threads up to the number of cores (or the
+ * first argument).
+ *
+ * Insert phase: every thread inserts its own shuffled slice of N keys.
+ * Lookup phase: every thread looks up LOOKUPS random keys that are present. */
+
+static constexpr size_t N = 2'000'000;
+static constexpr size_t LOOKUPS = 2'000'000;
+static constexpr size_t B = 16;
+
+struct LockedBTree {
+    BTree<uint64_t, B> tree;
+    std::mutex lock;
+
+    bool insert(uint64_t k) {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.insert(k);
+    }
+
+    bool contains(uint64_t k) {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.contains(k);
+    }
+};
+
+template<typename F>
+static double run_threads(size_t threads, F&& body) {
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back(body, i);
+    for (auto& w : workers)
+        w.join();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template<typename Tree>
+static void measure(const char* name, size_t threads, const std::vector<uint64_t>& keys) {
+    Tree tree;
+
+    double insert_s = run_threads(threads, [&](size_t i) {
+        for (size_t j = i; j < keys.size(); j += threads)
+            tree.insert(keys[j]);
+    });
+
+    std::atomic<size_t> misses{0};
+    double lookup_s = run_threads(threads, [&](size_t i) {
+        std::mt19937_64 g(i);
+        size_t local_misses = 0;
+
+        for (size_t j = 0; j < LOOKUPS / threads; j++)
+            local_misses += !tree.contains(keys[g() % keys.size()]);
+
+        misses += local_misses;
+    });
+
+    if (misses)
+        std::fprintf(stderr, "%s: %zu unexpected misses\n", name, misses.load());
+
+    std::printf("%-12s %8zu %14.2f %14.2f\n", name, threads,
+                keys.size() / insert_s / 1e6,
+                (LOOKUPS / threads * threads) / lookup_s / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+    if (max_threads == 0)
+        max_threads = 1;
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 g(42);
+    for (auto& k : keys)
+        k = g();
+
+    std::printf("%-12s %8s %14s %14s\n", "tree", "threads", "insert Mop/s", "lookup Mop/s");
+
+    for (size_t threads = 1; ; threads *= 2) {
+        threads = std::min(threads, max_threads);
+
+        measure<LockedBTree>("mutex+BTree", threads, keys);
+        measure<ConcurrentBTree<uint64_t, B>>("OLC", threads, keys);
+
+        if (threads == max_threads)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "btree.hpp"
+
+/* Retention cleanup: a tree of N timestamps drops its oldest K, with one
+ * remove per key or with a single erase_range. */
+
+static constexpr size_t N = 2'000'000;
+static constexpr size_t B = 6;
+
+template<typename F>
+static double ms(F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+    std::vector<uint64_t> keys(N);
+    for (size_t i = 0; i < N; i++)
+        keys[i] = 1'700'000'000'000 + 3 * i;
+
+    std::printf("%10s %12s %12s\n", "erased", "remove ms", "range ms");
+
+    for (size_t k : { 1'000, 100'000, 1'000'000 }) {
+        BTree<uint64_t, B> one, ranged;
+        one.bulk_load(keys.begin(), keys.end());
+        ranged.bulk_load(keys.begin(), keys.end());
+
+        double remove_ms = ms([&] {
+            for (size_t i = 0; i < k; i++)
+                one.remove(keys[i]);
+        });
+
+        size_t erased = 0;
+        double range_ms = ms([&] { erased = ranged.erase_range(keys[0], keys[k]); });
+
+        if (erased != k)
+            std::fprintf(stderr, "erased %zu keys instead of %zu\n", erased, k);
+
+        std::printf("%10zu %12.3f %12.3f\n", k, remove_ms, range_ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+/* Sweep of B over the powers of two, for several key types: ns/key of N
+ * random inserts, N lookups of present keys, an in-order scan and N removes,
+ * and the bytes of nodes per key once all keys are in. The row marked with
+ * `*` is btree_fanout<T>(), the B picked from the size of the key. */
+
+static constexpr size_t N = 500'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename T, size_t B>
+static void measure(const char* name, const std::vector<T>& keys, const std::vector<T>& probes) {
+    BTree<T, B> tree;
+
+    double insert_ns = ns_per_op(keys.size(), [&] {
+        for (auto& k : keys)
+            tree.insert(k);
+    });
+
+    size_t misses = 0;
+    double lookup_ns = ns_per_op(probes.size(), [&] {
+        for (auto& k : probes)
+            misses += !tree.contains(k);
+    });
+
+    size_t scanned = 0;
+    double scan_ns = ns_per_op(keys.size(), [&] {
+        for (auto it = tree.begin(); it != tree.end(); ++it)
+            scanned++;
+    });
+
+    size_t bytes = 0;
+    tree.for_all_nodes([&bytes](const BTreeNode<T, B>& node) {
+        bytes += node.type == NodeType::LEAF ? sizeof(BTreeLeafNode<T, B>)
+                                             : sizeof(BTreeInternalNode<T, B>);
+    });
+
+    double remove_ns = ns_per_op(keys.size(), [&] {
+        for (auto& k : keys)
+            tree.remove(k);
+    });
+
+    if (misses || scanned != keys.size())
+        std::fprintf(stderr, "%s B=%zu: %zu misses, %zu scanned\n", name, B, misses, scanned);
+
+    std::printf("%-8s %4zu%c %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, B,
+                B == btree_fanout<T>() ? '*' : ' ',
+                insert_ns, lookup_ns, scan_ns, remove_ns, double(bytes) / keys.size());
+}
+
+template<typename T, size_t... Bs>
+static void sweep(const char* name, const std::vector<T>& keys) {
+    std::vector<T> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), std::mt19937(7));
+
+    (measure<T, Bs>(name, keys, probes), ...);
+    if (((btree_fanout<T>() != Bs) && ...))
+        measure<T, btree_fanout<T>()>(name, keys, probes);
+}
+
+int main() {
+    std::mt19937_64 g(42);
+
+    std::vector<uint32_t> u32(N);
+    std::vector<uint64_t> u64(N);
+    std::vector<std::string> strings(N);
+
+    for (size_t i = 0; i < N; i++) {
+        u64[i] = g();
+        u32[i] = static_cast<uint32_t>(u64[i]);
+        strings[i] = "key-" + std::to_string(u64[i]);
+    }
+
+    std::printf("%-8s %5s %10s %10s %10s %10s %10s\n",
+                "key", "B", "insert ns", "lookup ns", "scan ns", "remove ns", "bytes/key");
+
+    sweep<uint32_t, 2, 4, 8, 16, 32, 64, 128, 256>("uint32", u32);
+    sweep<uint64_t, 2, 4, 8, 16, 32, 64, 128, 256>("uint64", u64);
+    sweep<std::string, 2, 4, 8, 16, 32, 64, 128>("string", strings);
+
+    return 0;
+}
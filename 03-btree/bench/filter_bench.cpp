@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* Lookups in BTree with and without the negative-lookup filter, for mixes
+ * of present and absent keys: ns/lookup at each miss rate, and the bytes of
+ * the filter per key. */
+
+static constexpr size_t N = 1'000'000;
+static constexpr size_t LOOKUPS = 2'000'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename Tree>
+static double lookup_ns(const Tree& tree, const std::vector<uint64_t>& probes) {
+    size_t found = 0;
+    double ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            found += tree.contains(k);
+    });
+
+    /* Keep the lookups from being optimised out */
+    if (found > probes.size())
+        std::fprintf(stderr, "impossible\n");
+
+    return ns;
+}
+
+int main() {
+    std::mt19937_64 g(42);
+
+    /* Even keys are present, odd keys absent */
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys)
+        k = (g() >> 1) << 1;
+    std::sort(keys.begin(), keys.end());
+
+    BTree<uint64_t, 16> plain;
+    BTree<uint64_t, 16, BTreeFilteredTraits> filtered;
+    plain.bulk_load(keys.begin(), keys.end());
+    filtered.bulk_load(keys.begin(), keys.end());
+
+    std::printf("%-10s %12s %12s %8s\n", "miss rate", "BTree ns", "filtered ns", "speedup");
+
+    for (double miss : { 0.0, 0.5, 0.9, 0.99 }) {
+        std::vector<uint64_t> probes(LOOKUPS);
+        for (auto& k : probes)
+            k = std::uniform_real_distribution<>()(g) < miss ? g() | 1 : keys[g() % N];
+
+        double plain_ns = lookup_ns(plain, probes);
+        double filtered_ns = lookup_ns(filtered, probes);
+
+        std::printf("%9.0f%% %12.1f %12.1f %7.2fx\n", 100 * miss, plain_ns, filtered_ns,
+                    plain_ns / filtered_ns);
+    }
+
+    std::printf("filter: %.1f bytes/key\n", double(filtered.filter.memory_bytes()) / N);
+
+    return 0;
+}
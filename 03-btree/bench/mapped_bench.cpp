@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+/* Cold start from a saved image against building the tree again: the time
+ * to get N keys ready for queries by inserting them, by bulk loading them
+ * sorted, and by opening the image; then ns/lookup and ns/key of a full scan
+ * in the tree and in the image, with the image in the page cache. */
+
+static constexpr size_t N = 10'000'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename Tree>
+static void measure(const char* name, const Tree& tree, const std::vector<uint64_t>& probes) {
+    size_t found = 0;
+    double lookup_ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            found += tree.contains(k);
+    });
+
+    uint64_t sum = 0;
+    double scan_ns = ns_per_op(N, [&] {
+        for (auto k : tree)
+            sum += k;
+    });
+
+    if (found != probes.size())
+        std::fprintf(stderr, "%s: %zu unexpected misses\n", name, probes.size() - found);
+
+    std::printf("%-8s %10.1f %10.2f   (%llu)\n", name, lookup_ns, scan_ns, (unsigned long long)sum);
+}
+
+int main() {
+    std::mt19937_64 g(42);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys)
+        k = g();
+
+    std::vector<uint64_t> probes(keys.begin(), keys.begin() + N / 10);
+    std::shuffle(probes.begin(), probes.end(), g);
+
+    auto path = (std::filesystem::temp_directory_path() / "mapped_bench.img").string();
+
+    BTree<uint64_t, 16> tree;
+    double insert_ms = ns_per_op(1, [&] {
+        for (auto k : keys)
+            tree.insert(k);
+    }) / 1e6;
+
+    std::sort(keys.begin(), keys.end());
+    BTree<uint64_t, 16> loaded;
+    double load_ms = ns_per_op(1, [&] { loaded.bulk_load(keys.begin(), keys.end()); }) / 1e6;
+
+    double save_ms = ns_per_op(1, [&] { tree.save(path); }) / 1e6;
+
+    std::optional<MappedBTree<uint64_t, 16>> image;
+    double open_ms = ns_per_op(1, [&] { image.emplace(BTree<uint64_t, 16>::open_mapped(path)); }) / 1e6;
+
+    std::printf("%zu keys, image of %.1f MB\n", N, std::filesystem::file_size(path) / 1e6);
+    std::printf("  insert     %10.1f ms\n", insert_ms);
+    std::printf("  bulk_load  %10.1f ms\n", load_ms);
+    std::printf("  save       %10.1f ms\n", save_ms);
+    std::printf("  open       %10.3f ms\n", open_ms);
+
+    std::printf("\n%-8s %10s %10s\n", "", "lookup ns", "scan ns");
+    measure("tree", tree, probes);
+    measure("image", *image, probes);
+
+    image.reset();
+    std::filesystem::remove(path);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+#include "packed_btree.hpp"
+
+/* uint64_t keys in BTree and in PackedBTree, for three key sets: IDs
+ * handed out in order with small gaps, timestamps spread over a day in
+ * microseconds, and uniformly random keys. ns/key of N inserts, N lookups
+ * of present keys in random order and N removes, then the bytes of nodes
+ * per key and the depth once all keys are in. Each time is the best of
+ * ROUNDS runs. */
+
+static constexpr size_t N = 1'000'000;
+static constexpr size_t ROUNDS = 3;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<size_t B>
+static size_t memory_bytes(const BTree<uint64_t, B>& tree) {
+    size_t bytes = 0;
+
+    const_cast<BTree<uint64_t, B>&>(tree).for_all_nodes(
+        [&bytes](const BTreeNode<uint64_t, B>& node) {
+            bytes += node.type == NodeType::LEAF ? sizeof(BTreeLeafNode<uint64_t, B>)
+                                                 : sizeof(BTreeInternalNode<uint64_t, B>);
+        });
+
+    return bytes;
+}
+
+template<size_t B, size_t LeafBytes>
+static size_t memory_bytes(const PackedBTree<uint64_t, B, LeafBytes>& tree) {
+    return tree.memory_bytes();
+}
+
+template<typename Tree>
+static void measure(const char* keys_name, const char* name, const std::vector<uint64_t>& keys,
+                    const std::vector<uint64_t>& probes) {
+    double insert_ns = 1e9, lookup_ns = 1e9, remove_ns = 1e9;
+    size_t bytes = 0, depth = 0, misses = 0;
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        Tree tree;
+
+        insert_ns = std::min(insert_ns, ns_per_op(keys.size(), [&] {
+            for (auto k : keys)
+                tree.insert(k);
+        }));
+
+        lookup_ns = std::min(lookup_ns, ns_per_op(probes.size(), [&] {
+            for (auto k : probes)
+                misses += !tree.contains(k);
+        }));
+
+        bytes = memory_bytes(tree);
+        depth = tree.depth().value();
+
+        remove_ns = std::min(remove_ns, ns_per_op(keys.size(), [&] {
+            for (auto k : keys)
+                tree.remove(k);
+        }));
+    }
+
+    if (misses)
+        std::fprintf(stderr, "%s %s: %zu unexpected misses\n", keys_name, name, misses);
+
+    std::printf("%-10s %-24s %10.1f %10.1f %10.1f %10.2f %6zu\n", keys_name, name, insert_ns,
+                lookup_ns, remove_ns, double(bytes) / keys.size(), depth);
+}
+
+static void run(const char* name, const std::vector<uint64_t>& keys) {
+    std::vector<uint64_t> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), std::mt19937_64(7));
+
+    measure<BTree<uint64_t, 16>>(name, "BTree<16>", keys, probes);
+    measure<PackedBTree<uint64_t, 16, 128>>(name, "PackedBTree<16, 128>", keys, probes);
+    measure<PackedBTree<uint64_t, 16, 256>>(name, "PackedBTree<16, 256>", keys, probes);
+    measure<PackedBTree<uint64_t, 16, 512>>(name, "PackedBTree<16, 512>", keys, probes);
+}
+
+int main() {
+    std::mt19937_64 g(42);
+
+    std::vector<uint64_t> ids(N), timestamps(N), random(N);
+    uint64_t id = 1'700'000'000'000;
+    for (size_t i = 0; i < N; i++) {
+        id += 1 + g() % 4;
+        ids[i] = id;
+        timestamps[i] = 1'700'000'000'000'000 + g() % 86'400'000'000;
+        random[i] = g();
+    }
+
+    std::printf("%-10s %-24s %10s %10s %10s %10s %6s\n", "keys", "tree", "insert ns", "lookup ns",
+                "remove ns", "bytes/key", "depth");
+
+    run("ids", ids);
+    run("timestamps", timestamps);
+    run("random", random);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "paged_btree.hpp"
+
+/* Page faults, write-backs and time per operation of PagedBTree for a range
+ * of buffer pool sizes, from a pool much smaller than the tree to one that
+ * holds all of it.
+ *
+ * Insert phase: N random keys. Lookup phase: LOOKUPS random keys that are
+ * present. The file lives in the directory given as the first argument, or
+ * the system temp directory. */
+
+static constexpr size_t N = 1'000'000;
+static constexpr size_t LOOKUPS = 1'000'000;
+
+namespace fs = std::filesystem;
+
+template<typename F>
+static double time_ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+static void measure(const fs::path& path, size_t frames, const std::vector<uint64_t>& keys) {
+    fs::remove(path);
+    PagedBTree<uint64_t> tree(path, frames);
+    auto& pool = tree.buffer_pool();
+
+    double insert_ns = time_ns_per_op(keys.size(), [&] {
+        for (auto k : keys)
+            tree.insert(k);
+    });
+    auto insert_stats = pool.stats();
+    pool.reset_stats();
+
+    std::mt19937_64 g(1);
+    size_t misses = 0;
+    double lookup_ns = time_ns_per_op(LOOKUPS, [&] {
+        for (size_t i = 0; i < LOOKUPS; i++)
+            misses += !tree.contains(keys[g() % keys.size()]);
+    });
+    auto lookup_stats = pool.stats();
+
+    if (misses)
+        std::fprintf(stderr, "%zu unexpected misses\n", misses);
+
+    std::printf("%8zu %8zu %12.1f %10.3f %10.3f %12.1f %10.3f\n",
+                frames, tree.num_pages(),
+                insert_ns,
+                double(insert_stats.faults) / keys.size(),
+                double(insert_stats.writebacks) / keys.size(),
+                lookup_ns,
+                double(lookup_stats.faults) / LOOKUPS);
+}
+
+int main(int argc, char *argv[]) {
+    fs::path dir = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path();
+    fs::path path = dir / ("paged_bench." + std::to_string(getpid()));
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 g(42);
+    for (auto& k : keys)
+        k = g();
+
+    std::printf("%8s %8s %12s %10s %10s %12s %10s\n", "frames", "pages",
+                "insert ns", "faults/op", "writes/op", "lookup ns", "faults/op");
+
+    for (size_t frames : {16, 64, 256, 1024, 4096, 16384})
+        measure(path, frames, keys);
+
+    fs::remove(path);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* A burst of deletes, with eager and with relaxed rebalancing: ns/remove
+ * for removing 90% of N keys in random order, the time of the rebalance
+ * pass after it, and ns/lookup of the keys left before and after that. */
+
+static constexpr size_t N = 1'000'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename Tree>
+static double lookup_ns(const Tree& tree, const std::vector<uint64_t>& probes) {
+    size_t found = 0;
+    double ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            found += tree.contains(k);
+    });
+
+    if (found != probes.size())
+        std::fprintf(stderr, "%zu unexpected misses\n", probes.size() - found);
+
+    return ns;
+}
+
+template<typename Traits>
+static void measure(const char* name, const std::vector<uint64_t>& keys,
+                    const std::vector<uint64_t>& order) {
+    BTree<uint64_t, 16, Traits> tree;
+    tree.bulk_load(keys.begin(), keys.end());
+
+    std::vector<uint64_t> gone(order.begin(), order.begin() + N / 10 * 9);
+    std::vector<uint64_t> kept(order.begin() + N / 10 * 9, order.end());
+
+    double remove_ns = ns_per_op(gone.size(), [&] {
+        for (auto k : gone)
+            tree.remove(k);
+    });
+
+    double lookup_before = lookup_ns(tree, kept);
+
+    double rebalance_ms = 0;
+    if constexpr (Traits::relaxed)
+        rebalance_ms = ns_per_op(1, [&] { tree.rebalance(); }) / 1e6;
+
+    std::printf("%-14s %10.1f %12.2f %12.1f %12.1f\n", name, remove_ns, rebalance_ms,
+                lookup_before, lookup_ns(tree, kept));
+}
+
+struct RelaxedMinTraits : BTreeRelaxedTraits {
+    static constexpr size_t relaxed_min = 4;
+};
+
+int main() {
+    std::mt19937_64 g(42);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys)
+        k = g();
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint64_t> order(keys);
+    std::shuffle(order.begin(), order.end(), g);
+
+    std::printf("%-14s %10s %12s %12s %12s\n", "tree", "remove ns", "rebalance ms",
+                "lookup ns", "after ns");
+
+    measure<BTreeTraits>("eager", keys, order);
+    measure<BTreeRelaxedTraits>("relaxed", keys, order);
+    measure<RelaxedMinTraits>("relaxed, min 4", keys, order);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* Removes of keys that are there half of the time: ns/remove of calling
+ * remove on its own, and of checking with contains first as callers had
+ * to, over N keys in half-full nodes; and ns/op of misses alone next to
+ * lookups. */
+
+static constexpr size_t N = 1'000'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+int main() {
+    std::mt19937_64 g(42);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys)
+        k = g() & ~uint64_t(1);
+    std::sort(keys.begin(), keys.end());
+
+    /* Every key, or the odd key next to it */
+    std::vector<uint64_t> probes(keys);
+    for (auto& k : probes)
+        k |= g() & 1;
+    std::shuffle(probes.begin(), probes.end(), g);
+
+    std::vector<uint64_t> misses(keys);
+    for (auto& k : misses)
+        k |= 1;
+    std::shuffle(misses.begin(), misses.end(), g);
+
+    size_t removed = 0, checked = 0, found = 0;
+    BTree<uint64_t, 16> tree;
+
+    tree.bulk_load(keys.begin(), keys.end(), 0.5);
+    double remove_ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            removed += tree.remove(k);
+    });
+
+    tree.bulk_load(keys.begin(), keys.end(), 0.5);
+    double checked_ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            if (tree.contains(k))
+                checked += tree.remove(k);
+    });
+
+    tree.bulk_load(keys.begin(), keys.end(), 0.5);
+    double miss_ns = ns_per_op(misses.size(), [&] {
+        for (auto k : misses)
+            removed += tree.remove(k);
+    });
+    double lookup_ns = ns_per_op(misses.size(), [&] {
+        for (auto k : misses)
+            found += tree.contains(k);
+    });
+
+    if (removed != checked || found)
+        std::fprintf(stderr, "removed %zu, checked %zu, found %zu\n", removed, checked, found);
+
+    std::printf("%-22s %10s\n", "", "ns/op");
+    std::printf("%-22s %10.1f\n", "remove", remove_ns);
+    std::printf("%-22s %10.1f\n", "contains, then remove", checked_ns);
+    std::printf("%-22s %10.1f\n", "remove, misses only", miss_ns);
+    std::printf("%-22s %10.1f\n", "contains, misses only", lookup_ns);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* ns/lookup of every in-node search policy over B = 2..64.
+ *
+ * The tree is built once per B; the lookups then descend it with a fixed
+ * policy so that only the in-node search differs between the columns. Each
+ * figure is the best of ROUNDS runs. */
+
+static constexpr size_t N = 200'000;
+static constexpr size_t LOOKUPS = 1'000'000;
+static constexpr size_t ROUNDS = 3;
+
+template<typename Policy, typename T, size_t B>
+static bool descend(const BTreeNode<T, B>* node, const T& t) {
+    while (true) {
+        size_t idx = Policy::index(node->keys.data(), node->n, t);
+
+        if (idx < node->n && node->keys[idx] == t)
+            return true;
+
+        if (node->type == NodeType::LEAF)
+            return false;
+
+        node = node->edge(idx);
+    }
+}
+
+template<typename Policy, typename T, size_t B>
+static double ns_per_lookup(const BTree<T, B>& tree, const std::vector<T>& probes) {
+    double best = 0;
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        size_t hits = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& p : probes)
+            hits += descend<Policy>(tree.root, p);
+        auto end = std::chrono::steady_clock::now();
+
+        /* Keep the loop from being optimised away */
+        if (hits != probes.size())
+            std::fprintf(stderr, "unexpected miss\n");
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        if (r == 0 || ns < best)
+            best = ns;
+    }
+
+    return best / probes.size();
+}
+
+template<typename T, size_t B>
+static void run(const char* type_name) {
+    std::mt19937_64 g(42);
+    std::vector<T> xs(N);
+
+    for (size_t i = 0; i < N; i++)
+        xs[i] = static_cast<T>(i * 3);
+    std::shuffle(xs.begin(), xs.end(), g);
+
+    BTree<T, B> tree;
+    for (auto x : xs)
+        tree.insert(x);
+
+    std::vector<T> probes(LOOKUPS);
+    std::uniform_int_distribution<size_t> pick(0, N - 1);
+    for (auto& p : probes)
+        p = xs[pick(g)];
+
+    double linear = ns_per_lookup<LinearSearch>(tree, probes);
+    double binary = ns_per_lookup<BinarySearch>(tree, probes);
+    double simd = ns_per_lookup<SimdSearch>(tree, probes);
+    double chosen = ns_per_lookup<btree_search_policy_t<T, B>>(tree, probes);
+
+    std::printf("%-8s %4zu %10.1f %10.1f %10.1f %10.1f\n",
+                type_name, B, linear, binary, simd, chosen);
+}
+
+template<typename T, size_t... Bs>
+static void sweep(const char* type_name) {
+    (run<T, Bs>(type_name), ...);
+}
+
+int main(int argc, char *argv[]) {
+    std::printf("%-8s %4s %10s %10s %10s %10s\n",
+                "type", "B", "linear", "binary", "simd", "default");
+
+    sweep<int32_t, 2, 4, 8, 16, 32, 64>("int32");
+    sweep<uint64_t, 2, 4, 8, 16, 32, 64>("uint64");
+    sweep<double, 2, 4, 8, 16, 32, 64>("double");
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+/* ns/op of N random inserts followed by N removes, for integer and string
+ * keys over a range of B. Inserts and removes shift up to 2B-1 keys (and
+ * edges) per node they touch, so the larger B and the more expensive a key
+ * is to copy, the more of their time goes into shifting. Each figure is the
+ * best of ROUNDS runs. */
+
+static constexpr size_t N = 200'000;
+static constexpr size_t ROUNDS = 3;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename T, size_t B>
+static void measure(const char* name, const std::vector<T>& keys) {
+    double insert_ns = 1e9, remove_ns = 1e9;
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        BTree<T, B> tree;
+
+        insert_ns = std::min(insert_ns, ns_per_op(keys.size(), [&] {
+            for (auto& k : keys)
+                tree.insert(k);
+        }));
+
+        remove_ns = std::min(remove_ns, ns_per_op(keys.size(), [&] {
+            for (auto& k : keys)
+                tree.remove(k);
+        }));
+    }
+
+    std::printf("%-8s %5zu %12.1f %12.1f\n", name, B, insert_ns, remove_ns);
+}
+
+int main() {
+    std::mt19937_64 g(42);
+
+    std::vector<uint64_t> ints(N);
+    for (auto& k : ints)
+        k = g();
+
+    /* Long enough to live on the heap */
+    std::vector<std::string> strings(N);
+    for (size_t i = 0; i < N; i++)
+        strings[i] = "key-" + std::to_string(ints[i]) + std::string(16, 'x');
+
+    std::printf("%-8s %5s %12s %12s\n", "key", "B", "insert ns", "remove ns");
+
+    measure<uint64_t, 6>("uint64", ints);
+    measure<uint64_t, 32>("uint64", ints);
+    measure<uint64_t, 128>("uint64", ints);
+    measure<std::string, 6>("string", strings);
+    measure<std::string, 32>("string", strings);
+    measure<std::string, 128>("string", strings);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* A tree of N random keys is cut at a random key and put back together,
+ * ROUNDS times: with split_at and join, and by rebuilding both halves from
+ * an in-order walk with bulk_load, as one would without them. */
+
+static constexpr size_t ROUNDS = 20;
+static constexpr size_t B = 6;
+
+template<typename F>
+static double us_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / ops;
+}
+
+static void measure(size_t n) {
+    std::mt19937_64 g(42);
+    std::vector<uint64_t> keys(n);
+    for (auto& k : keys)
+        k = g();
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint64_t> cuts(ROUNDS);
+    for (auto& c : cuts)
+        c = keys[g() % n];
+
+    BTree<uint64_t, B> tree;
+    tree.bulk_load(keys.begin(), keys.end());
+
+    double split_us = 0, join_us = 0;
+    for (auto cut : cuts) {
+        BTree<uint64_t, B> right;
+        split_us += us_per_op(ROUNDS, [&] { tree.split_at(cut, right); });
+        join_us += us_per_op(ROUNDS, [&] { tree.join(right); });
+    }
+
+    double rebuild_us = us_per_op(ROUNDS, [&] {
+        for (auto cut : cuts) {
+            std::vector<uint64_t> lo, hi;
+            for (auto k : tree)
+                (k < cut ? lo : hi).push_back(k);
+
+            BTree<uint64_t, B> left, right;
+            left.bulk_load(lo.begin(), lo.end());
+            right.bulk_load(hi.begin(), hi.end());
+
+            std::vector<uint64_t> all;
+            for (auto k : left)
+                all.push_back(k);
+            for (auto k : right)
+                all.push_back(k);
+
+            BTree<uint64_t, B> joined;
+            joined.bulk_load(all.begin(), all.end());
+        }
+    });
+
+    std::printf("%10zu %12.2f %12.2f %14.1f\n", n, split_us, join_us, rebuild_us);
+}
+
+int main() {
+    std::printf("%10s %12s %12s %14s\n", "keys", "split us", "join us", "rebuild us");
+
+    for (size_t n : { 10'000, 100'000, 1'000'000 })
+        measure(n);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "btree.hpp"
+
+/* What counting costs: ns/op of N random inserts, lookups and removes in a
+ * BTree with and without stats, and the counters of the run. */
+
+static constexpr size_t N = 1'000'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<typename Traits>
+static void measure(const char* name, const std::vector<uint64_t>& keys,
+                    const std::vector<uint64_t>& probes) {
+    BTree<uint64_t, 16, Traits> tree;
+
+    double insert_ns = ns_per_op(keys.size(), [&] {
+        for (auto k : keys)
+            tree.insert(k);
+    });
+
+    size_t found = 0;
+    double lookup_ns = ns_per_op(probes.size(), [&] {
+        for (auto k : probes)
+            found += tree.contains(k);
+    });
+
+    double remove_ns = ns_per_op(keys.size(), [&] {
+        for (auto k : probes)
+            tree.remove(k);
+    });
+
+    if (found != probes.size())
+        std::fprintf(stderr, "%s: %zu unexpected misses\n", name, probes.size() - found);
+
+    std::printf("%-10s %10.1f %10.1f %10.1f\n", name, insert_ns, lookup_ns, remove_ns);
+
+    if constexpr (Traits::stats)
+        tree.stats().for_each([](const char* counter, uint64_t value) {
+            std::printf("  %-16s %12llu\n", counter, (unsigned long long)value);
+        });
+}
+
+int main() {
+    std::mt19937_64 g(42);
+    std::vector<uint64_t> keys(N);
+    for (auto& k : keys)
+        k = g();
+
+    std::vector<uint64_t> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), g);
+
+    std::printf("%-10s %10s %10s %10s\n", "tree", "insert ns", "lookup ns", "remove ns");
+
+    measure<BTreeTraits>("plain", keys, probes);
+    measure<BTreeStatsTraits>("stats", keys, probes);
+
+    return 0;
+}
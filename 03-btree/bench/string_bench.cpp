@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+#include "string_btree.hpp"
+
+/* URL-like keys in BTree<std::string> and in the prefix-compressed
+ * StringBTree: ns/key of N random inserts, N lookups of present keys and N
+ * removes, and the bytes of nodes and key buffers per key. */
+
+static constexpr size_t N = 500'000;
+
+template<typename F>
+static double ns_per_op(size_t ops, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+template<size_t B>
+static size_t memory_bytes(const BTree<std::string, B>& tree) {
+    size_t bytes = 0;
+
+    const_cast<BTree<std::string, B>&>(tree).for_all_nodes(
+        [&bytes](const BTreeNode<std::string, B>& node) {
+            bytes += node.type == NodeType::LEAF ? sizeof(BTreeLeafNode<std::string, B>)
+                                                 : sizeof(BTreeInternalNode<std::string, B>);
+            for (size_t i = 0; i < node.n; i++)
+                if (node.keys[i].capacity() > std::string().capacity())
+                    bytes += node.keys[i].capacity() + 1;
+        });
+
+    return bytes;
+}
+
+template<size_t B>
+static size_t memory_bytes(const StringBTree<B>& tree) {
+    return tree.memory_bytes();
+}
+
+template<typename Tree>
+static void measure(const char* name, const std::vector<std::string>& keys,
+                    const std::vector<std::string>& probes) {
+    Tree tree;
+
+    double insert_ns = ns_per_op(keys.size(), [&] {
+        for (auto& k : keys)
+            tree.insert(k);
+    });
+
+    size_t misses = 0;
+    double lookup_ns = ns_per_op(probes.size(), [&] {
+        for (auto& k : probes)
+            misses += !tree.contains(k);
+    });
+
+    size_t bytes = memory_bytes(tree);
+
+    double remove_ns = ns_per_op(keys.size(), [&] {
+        for (auto& k : keys)
+            tree.remove(k);
+    });
+
+    if (misses)
+        std::fprintf(stderr, "%s: %zu unexpected misses\n", name, misses);
+
+    std::printf("%-22s %10.1f %10.1f %10.1f %10.1f\n", name, insert_ns, lookup_ns, remove_ns,
+                double(bytes) / keys.size());
+}
+
+int main() {
+    static const char* hosts[] = {
+        "https://www.example.com/", "https://static.example.com/assets/",
+        "https://api.example.org/v2/", "https://blog.example.net/posts/",
+    };
+
+    std::mt19937_64 g(42);
+    std::vector<std::string> keys(N);
+    for (auto& k : keys)
+        k = std::string(hosts[g() % 4]) + "section-" + std::to_string(g() % 100)
+            + "/item/" + std::to_string(g());
+
+    std::vector<std::string> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), g);
+
+    std::printf("%-22s %10s %10s %10s %10s\n", "tree", "insert ns", "lookup ns", "remove ns",
+                "bytes/key");
+
+    measure<BTree<std::string, 4>>("BTree<string, 4>", keys, probes);
+    measure<BTree<std::string, 16>>("BTree<string, 16>", keys, probes);
+    measure<StringBTree<8>>("StringBTree<8>", keys, probes);
+    measure<StringBTree<16>>("StringBTree<16>", keys, probes);
+    measure<StringBTree<32>>("StringBTree<32>", keys, probes);
+
+    return 0;
+}
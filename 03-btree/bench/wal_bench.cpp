@@ -0,0 +1,91 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "btree_wal.hpp"
+
+/* Insert throughput of DurableBTree for several group commit settings,
+ * against a plain BTree, and the time it takes to reopen the tree from a
+ * checkpoint plus a log tail.
+ *
+ * The directory lives under the first argument, or the system temp
+ * directory. */
+
+static constexpr size_t N = 200'000;
+static constexpr size_t B = 16;
+
+namespace fs = std::filesystem;
+
+template<typename F>
+static double seconds(F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void measure(const fs::path& dir, const std::vector<uint64_t>& keys,
+                    size_t group_size, size_t sync_every) {
+    fs::remove_all(dir);
+
+    double s;
+    {
+        DurableBTree<uint64_t, B> tree(dir, WalOptions{group_size, sync_every, 0});
+        s = seconds([&] {
+            for (auto k : keys)
+                tree.insert(k);
+            tree.commit();
+        });
+    }
+
+    std::printf("%10zu %10zu %14.3f\n", group_size, sync_every, keys.size() / s / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    fs::path base = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path();
+    fs::path dir = base / ("wal_bench." + std::to_string(getpid()));
+
+    std::vector<uint64_t> keys(N);
+    std::mt19937_64 g(42);
+    for (auto& k : keys)
+        k = g();
+
+    {
+        BTree<uint64_t, B> tree;
+        double s = seconds([&] {
+            for (auto k : keys)
+                tree.insert(k);
+        });
+        std::printf("in-memory BTree: %.3f Mop/s\n\n", keys.size() / s / 1e6);
+    }
+
+    std::printf("%10s %10s %14s\n", "group", "sync every", "insert Mop/s");
+    for (size_t group : {1, 16, 256, 4096})
+        for (size_t sync_every : {1, 16, 0})
+            measure(dir, keys, group, sync_every);
+
+    /* Recovery: checkpoint after half of the keys, log the other half */
+    fs::remove_all(dir);
+    {
+        DurableBTree<uint64_t, B> tree(dir, WalOptions{4096, 0, 0});
+        for (size_t i = 0; i < keys.size(); i++) {
+            tree.insert(keys[i]);
+            if (i == keys.size() / 2)
+                tree.checkpoint();
+        }
+    }
+
+    double s = seconds([&] { DurableBTree<uint64_t, B> tree(dir); });
+    std::printf("\nreopen (checkpoint of %zu keys + log of %zu): %.1f ms\n",
+                keys.size() / 2 + 1, keys.size() / 2 - 1, s * 1e3);
+
+    fs::remove_all(dir);
+    return 0;
+}
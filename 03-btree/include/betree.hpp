@@ -0,0 +1,538 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "btree.hpp"
+
+/**
+ * Write-optimised Bε-tree variant of the B-tree engine.
+ *
+ * The shape is that of the B+ tree: keys live in the leaves, and internal
+ * nodes hold separators, with keys equal to a separator on its right. On top
+ * of that, every internal node has a buffer of up to BUF pending messages
+ * (insert or erase of a key), sorted by key, with at most one message per
+ * key: a newer message for the same key replaces the older one.
+ *
+ * insert and remove only add a message to the root buffer. When a buffer is
+ * full, it is flushed: the messages bound for the child that has the most of
+ * them move down in one batch, into its buffer or, for a leaf, into its keys.
+ * A leaf is thus written once per batch instead of once per key.
+ *
+ * Messages move down, so a message higher in the tree is newer than one
+ * below it, and a lookup stops at the first message for its key it sees on
+ * the way down.
+ *
+ * Splits are those of the B+ tree, applied before stepping into a full node;
+ * splitting an internal node splits its buffer along the separator. Deletion
+ * is lazy: a leaf is only removed once it is empty, and nodes are never
+ * merged.
+ *
+ * Like the B+ tree, this is a set. Since inserts and removes are blind
+ * writes, they do not report whether the key was present.
+ */
+
+template<typename T, size_t B = 8, size_t BUF = 16 * B>
+struct BeTreeNode;
+
+template<typename T, size_t B = 8, size_t BUF = 16 * B>
+struct BeTreeLeafNode;
+
+template<typename T, size_t B = 8, size_t BUF = 16 * B>
+struct BeTreeInternalNode;
+
+template<typename T, size_t B = 8, size_t BUF = 16 * B>
+struct BeTree {
+    /* Leaf writes: one per batch of messages applied to a leaf (or per key
+       while the root is a leaf). Flushes: buffers flushed. */
+    struct Stats {
+        size_t leaf_writes = 0;
+        size_t flushes = 0;
+    };
+
+    BeTreeNode<T, B, BUF>* root = nullptr;
+    Stats stats;
+
+    BeTree() = default;
+    BeTree(const BeTree&) = delete;
+    BeTree& operator=(const BeTree&) = delete;
+    ~BeTree() { if (root) BeTreeNode<T, B, BUF>::destroy(root); }
+
+    void insert(const T&);
+    void remove(const T&);
+    bool contains(const T&) const;
+
+    /* Keys in order, with the pending messages applied */
+    void for_all(std::function<void(const T&)>) const;
+    void for_all_nodes(std::function<void(const BeTreeNode<T, B, BUF>&)>) const;
+    const std::optional<size_t> depth() const;
+
+private:
+    using Node = BeTreeNode<T, B, BUF>;
+    using InternalNode = BeTreeInternalNode<T, B, BUF>;
+
+    void put(const T&, bool erase);
+    void grow();
+    void flush(InternalNode&);
+    bool apply(Node& leaf, const T&, bool erase);
+    static std::vector<T> collect(const Node*);
+};
+
+template<typename T, size_t B, size_t BUF>
+struct BeTreeNode {
+    NodeType type;
+    size_t n;
+    std::array<T, 2 * B - 1> keys;
+
+    size_t get_index(const T& t) const;
+    size_t child_index(const T& t) const;
+
+    BeTreeNode*& edge(size_t i);
+    BeTreeNode* edge(size_t i) const;
+    BeTreeInternalNode<T, B, BUF>& internal();
+    const BeTreeInternalNode<T, B, BUF>& internal() const;
+
+    static BeTreeNode* make(NodeType);
+    static void free_node(BeTreeNode*);
+    static void destroy(BeTreeNode*);
+
+    static void split_child(BeTreeNode&, size_t);
+
+protected:
+    BeTreeNode(NodeType type) : type(type), n(0) {}
+};
+
+template<typename T, size_t B, size_t BUF>
+struct BeTreeLeafNode : BeTreeNode<T, B, BUF> {
+    BeTreeLeafNode() : BeTreeNode<T, B, BUF>(NodeType::LEAF) {}
+};
+
+template<typename T, size_t B, size_t BUF>
+struct BeTreeInternalNode : BeTreeNode<T, B, BUF> {
+    std::array<BeTreeNode<T, B, BUF>*, 2 * B> edges;
+
+    /* The buffer: messages[0..pending) sorted, erases[i] tells whether
+       messages[i] erases the key or inserts it. */
+    size_t pending = 0;
+    std::array<T, BUF> messages;
+    std::array<bool, BUF> erases;
+
+    BeTreeInternalNode() : BeTreeNode<T, B, BUF>(NodeType::INTERNAL) {}
+
+    size_t message_index(const T& t) const;
+    void add_message(const T& t, bool erase);
+    void remove_messages(size_t from, size_t to);
+};
+
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::insert(const T& t) {
+    put(t, false);
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::remove(const T& t) {
+    put(t, true);
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::put(const T& t, bool erase) {
+    if (!root) {
+        if (erase)
+            return;
+        root = Node::make(NodeType::LEAF);
+    }
+
+    while (true) {
+        if (root->type == NodeType::LEAF) {
+            if (root->n < 2 * B - 1) {
+                stats.leaf_writes += apply(*root, t, erase);
+                return;
+            }
+            grow();
+        }
+
+        InternalNode& top = root->internal();
+        if (top.pending < BUF) {
+            top.add_message(t, erase);
+            return;
+        }
+
+        /* Make room in the root buffer. A flush needs a root that can take
+           one more child, and always moves at least one message down. */
+        if (root->n == 2 * B - 1) {
+            grow();
+            continue;
+        }
+
+        flush(top);
+
+        /* Once the leaves have emptied down to a single child, and nothing
+           is left to pass down to it, the root is of no use */
+        if (top.n == 0 && top.pending == 0) {
+            root = top.edge(0);
+            Node::free_node(&top);
+        }
+    }
+}
+
+/* Put a new root above the full one and split the old root */
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::grow() {
+    Node* new_root = Node::make(NodeType::INTERNAL);
+    new_root->edge(0) = root;
+    Node::split_child(*new_root, 0);
+    root = new_root;
+}
+
+/**
+ * Move the messages bound for the child that has the most of them into
+ * that child. Assume `node` is not full.
+ *
+ * A full child is split first; a child whose buffer is full is flushed
+ * first. When `node` itself fills up with the children of those splits, the
+ * flush stops early and the rest of the batch stays here: the parent splits
+ * `node` before flushing it again.
+ */
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::flush(InternalNode& node) {
+    stats.flushes++;
+
+    /* Messages are sorted, so the ones for one child are contiguous */
+    size_t first = 0, last = 0;
+    for (size_t i = 0; i < node.pending; ) {
+        size_t c = node.child_index(node.messages[i]);
+        size_t j = (c == node.n) ? node.pending : node.message_index(node.keys[c]);
+
+        if (j - i > last - first) {
+            first = i;
+            last = j;
+        }
+        i = j;
+    }
+
+    const Node* touched = nullptr;
+    size_t i = first;
+
+    while (i < last) {
+        const T& t = node.messages[i];
+        size_t c = node.child_index(t);
+        Node* child = node.edge(c);
+
+        if (child->n == 2 * B - 1) {
+            if (node.n == 2 * B - 1)
+                break;
+
+            Node::split_child(node, c);
+            continue;
+        }
+
+        if (child->type == NodeType::LEAF) {
+            if (apply(*child, t, node.erases[i]) && child != touched) {
+                stats.leaf_writes++;
+                touched = child;
+            }
+
+            /* An empty leaf goes away, and its range joins a neighbour */
+            if (child->n == 0 && node.n > 0) {
+                if (c > 0) {
+                    for (size_t j = c; j < node.n; j++)
+                        node.keys[j - 1] = node.keys[j];
+                } else {
+                    for (size_t j = 1; j < node.n; j++)
+                        node.keys[j - 1] = node.keys[j];
+                }
+
+                for (size_t j = c + 1; j <= node.n; j++)
+                    node.edge(j - 1) = node.edge(j);
+
+                node.n--;
+                Node::free_node(child);
+                touched = nullptr;
+            }
+        } else {
+            InternalNode& inner = child->internal();
+
+            if (inner.pending == BUF) {
+                flush(inner);
+                continue;
+            }
+
+            inner.add_message(t, node.erases[i]);
+        }
+
+        i++;
+    }
+
+    node.remove_messages(first, i);
+}
+
+/* Apply one message to a leaf that is not full. Return whether it changed. */
+template<typename T, size_t B, size_t BUF>
+bool BeTree<T, B, BUF>::apply(Node& leaf, const T& t, bool erase) {
+    size_t idx = leaf.get_index(t);
+    bool present = idx < leaf.n && leaf.keys[idx] == t;
+
+    if (erase == !present)
+        return false;
+
+    if (erase) {
+        for (size_t j = idx; j + 1 < leaf.n; j++)
+            leaf.keys[j] = leaf.keys[j + 1];
+        leaf.n--;
+    } else {
+        for (size_t j = leaf.n; j > idx; j--)
+            leaf.keys[j] = leaf.keys[j - 1];
+        leaf.keys[idx] = t;
+        leaf.n++;
+    }
+
+    return true;
+}
+
+template<typename T, size_t B, size_t BUF>
+bool BeTree<T, B, BUF>::contains(const T& t) const {
+    const Node* node = root;
+    if (!node)
+        return false;
+
+    while (node->type == NodeType::INTERNAL) {
+        const InternalNode& inner = node->internal();
+        size_t idx = inner.message_index(t);
+
+        if (idx < inner.pending && inner.messages[idx] == t)
+            return !inner.erases[idx];
+
+        node = node->edge(node->child_index(t));
+    }
+
+    size_t idx = node->get_index(t);
+
+    return idx < node->n && node->keys[idx] == t;
+}
+
+/* The keys below `node`, merged with the messages on the way */
+template<typename T, size_t B, size_t BUF>
+std::vector<T> BeTree<T, B, BUF>::collect(const Node* node) {
+    if (node->type == NodeType::LEAF)
+        return std::vector<T>(node->keys.begin(), node->keys.begin() + node->n);
+
+    std::vector<T> below;
+    for (size_t i = 0; i <= node->n; i++) {
+        auto keys = collect(node->edge(i));
+        below.insert(below.end(), keys.begin(), keys.end());
+    }
+
+    const InternalNode& inner = node->internal();
+    std::vector<T> keys;
+    size_t i = 0, j = 0;
+
+    while (i < below.size() || j < inner.pending) {
+        if (j == inner.pending || (i < below.size() && below[i] < inner.messages[j])) {
+            keys.push_back(below[i++]);
+            continue;
+        }
+
+        if (i < below.size() && below[i] == inner.messages[j])
+            i++;
+        if (!inner.erases[j])
+            keys.push_back(inner.messages[j]);
+        j++;
+    }
+
+    return keys;
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::for_all(std::function<void(const T&)> func) const {
+    if (!root)
+        return;
+
+    for (const auto& t : collect(root))
+        func(t);
+}
+
+/* This isn't necessarily the in-order traversal */
+template<typename T, size_t B, size_t BUF>
+void BeTree<T, B, BUF>::for_all_nodes(
+    std::function<void(const BeTreeNode<T, B, BUF>&)> func) const {
+    if (!root)
+        return;
+
+    std::function<void(const Node*)> visit = [&](const Node* node) {
+        func(*node);
+        if (node->type == NodeType::INTERNAL)
+            for (size_t i = 0; i <= node->n; i++)
+                visit(node->edge(i));
+    };
+
+    visit(root);
+}
+
+template<typename T, size_t B, size_t BUF>
+const std::optional<size_t> BeTree<T, B, BUF>::depth() const {
+    if (!root)
+        return std::nullopt;
+
+    size_t d = 0;
+    for (auto node = root; node->type == NodeType::INTERNAL; node = node->edge(0))
+        d++;
+
+    return d;
+}
+
+/* Number of keys smaller than t; see BTreeNode::get_index. */
+template<typename T, size_t B, size_t BUF>
+size_t BeTreeNode<T, B, BUF>::get_index(const T& t) const {
+    return btree_search_policy_t<T, B>::index(keys.data(), n, t);
+}
+
+/* The edge to follow for t: keys equal to a separator live on its right. */
+template<typename T, size_t B, size_t BUF>
+size_t BeTreeNode<T, B, BUF>::child_index(const T& t) const {
+    size_t idx = get_index(t);
+
+    return (idx < n && keys[idx] == t) ? idx + 1 : idx;
+}
+
+template<typename T, size_t B, size_t BUF>
+BeTreeNode<T, B, BUF>*& BeTreeNode<T, B, BUF>::edge(size_t i) {
+    return internal().edges[i];
+}
+
+template<typename T, size_t B, size_t BUF>
+BeTreeNode<T, B, BUF>* BeTreeNode<T, B, BUF>::edge(size_t i) const {
+    return internal().edges[i];
+}
+
+template<typename T, size_t B, size_t BUF>
+BeTreeInternalNode<T, B, BUF>& BeTreeNode<T, B, BUF>::internal() {
+    return *static_cast<BeTreeInternalNode<T, B, BUF>*>(this);
+}
+
+template<typename T, size_t B, size_t BUF>
+const BeTreeInternalNode<T, B, BUF>& BeTreeNode<T, B, BUF>::internal() const {
+    return *static_cast<const BeTreeInternalNode<T, B, BUF>*>(this);
+}
+
+template<typename T, size_t B, size_t BUF>
+BeTreeNode<T, B, BUF>* BeTreeNode<T, B, BUF>::make(NodeType type) {
+    if (type == NodeType::INTERNAL)
+        return new BeTreeInternalNode<T, B, BUF>();
+
+    return new BeTreeLeafNode<T, B, BUF>();
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTreeNode<T, B, BUF>::free_node(BeTreeNode<T, B, BUF>* node) {
+    if (node->type == NodeType::INTERNAL)
+        delete &node->internal();
+    else
+        delete static_cast<BeTreeLeafNode<T, B, BUF>*>(node);
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTreeNode<T, B, BUF>::destroy(BeTreeNode<T, B, BUF>* node) {
+    if (node->type == NodeType::INTERNAL) {
+        for (size_t i = 0; i < node->n + 1; i++)
+            destroy(node->edge(i));
+    }
+
+    free_node(node);
+}
+
+/**
+ * Split the full child parent.edge(idx), whose parent is not full.
+ *
+ * Keys and separators are split as in the B+ tree. The buffer of an internal
+ * child is split along the separator that moves up, so that every message
+ * stays above the subtree its key routes to.
+ */
+template<typename T, size_t B, size_t BUF>
+void BeTreeNode<T, B, BUF>::split_child(BeTreeNode<T, B, BUF>& parent, size_t idx) {
+    BeTreeNode<T, B, BUF>* y = parent.edge(idx);
+    BeTreeNode<T, B, BUF>* z = make(y->type);
+    T separator;
+
+    if (y->type == NodeType::LEAF) {
+        for (size_t j = 0; j < B; j++)
+            z->keys[j] = y->keys[j + B - 1];
+
+        z->n = B;
+        y->n = B - 1;
+        separator = z->keys[0];
+    } else {
+        for (size_t j = 0; j < B - 1; j++)
+            z->keys[j] = y->keys[j + B];
+
+        for (size_t j = 0; j < B; j++)
+            z->edge(j) = y->edge(j + B);
+
+        z->n = B - 1;
+        y->n = B - 1;
+        separator = y->keys[B - 1];
+
+        auto& from = y->internal();
+        auto& to = z->internal();
+        size_t k = from.message_index(separator);
+
+        for (size_t j = k; j < from.pending; j++) {
+            to.messages[j - k] = from.messages[j];
+            to.erases[j - k] = from.erases[j];
+        }
+
+        to.pending = from.pending - k;
+        from.pending = k;
+    }
+
+    for (size_t j = parent.n + 1; j > idx + 1; j--)
+        parent.edge(j) = parent.edge(j - 1);
+
+    for (size_t j = parent.n; j > idx; j--)
+        parent.keys[j] = parent.keys[j - 1];
+
+    parent.edge(idx + 1) = z;
+    parent.keys[idx] = separator;
+    parent.n++;
+}
+
+/* Number of messages with a smaller key. The buffer holds up to BUF keys,
+   so use the search a node of that capacity would use. */
+template<typename T, size_t B, size_t BUF>
+size_t BeTreeInternalNode<T, B, BUF>::message_index(const T& t) const {
+    return btree_search_policy_t<T, (BUF + 1) / 2>::index(messages.data(), pending, t);
+}
+
+/* Assume the buffer is not full */
+template<typename T, size_t B, size_t BUF>
+void BeTreeInternalNode<T, B, BUF>::add_message(const T& t, bool erase) {
+    size_t idx = message_index(t);
+
+    if (idx < pending && messages[idx] == t) {
+        erases[idx] = erase;
+        return;
+    }
+
+    for (size_t j = pending; j > idx; j--) {
+        messages[j] = messages[j - 1];
+        erases[j] = erases[j - 1];
+    }
+
+    messages[idx] = t;
+    erases[idx] = erase;
+    pending++;
+}
+
+template<typename T, size_t B, size_t BUF>
+void BeTreeInternalNode<T, B, BUF>::remove_messages(size_t from, size_t to) {
+    size_t gap = to - from;
+
+    for (size_t j = to; j < pending; j++) {
+        messages[j - gap] = messages[j];
+        erases[j - gap] = erases[j];
+    }
+
+    pending -= gap;
+}
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+#include "btree.hpp"
+
+/**
+ * B+ tree variant of the B-tree engine.
+ *
+ * All keys live in the leaves and every leaf links to its right sibling.
+ * Internal nodes only hold separators: for the separator keys[i], every key
+ * below edge(i) is smaller than it and every key below edge(i+1) is greater
+ * or equal. A separator may outlive the key it was copied from; it still
+ * routes correctly.
+ *
+ * The node layouts follow BTreeNode: a shared header that is never allocated
+ * on its own, plus a leaf layout (with `next`) and an internal layout (with
+ * the edges). Occupancy is the same as in the B-tree: every node but the
+ * root holds between B-1 and 2B-1 keys.
+ *
+ * Unlike BTree, this is a set: inserting a key that is already present
+ * fails.
+ */
+
+template<typename T, size_t B = 6>
+struct BPlusTreeNode;
+
+template<typename T, size_t B = 6>
+struct BPlusTreeLeafNode;
+
+template<typename T, size_t B = 6>
+struct BPlusTreeInternalNode;
+
+template<typename T, size_t B = 6>
+struct BPlusTree {
+    class cursor;
+    class range_view;
+
+    BPlusTreeNode<T, B>* root = nullptr;
+
+    BPlusTree() = default;
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+    ~BPlusTree() { if (root) BPlusTreeNode<T, B>::destroy(root); }
+
+    bool insert(const T&);
+    bool remove(const T&);
+    bool contains(const T&) const;
+
+    cursor begin() const;
+    cursor end() const;
+
+    /* Keys in [lo, hi), in order. One descent to `lo`, then a walk along the
+       leaf chain. */
+    range_view range(const T& lo, const T& hi) const;
+
+    void for_all_nodes(std::function<void(const BPlusTreeNode<T, B>&)>) const;
+    const std::optional<size_t> depth() const;
+};
+
+template<typename T, size_t B>
+struct BPlusTreeNode {
+    NodeType type;
+    size_t n;
+    std::array<T, 2 * B - 1> keys;
+
+    size_t get_index(const T& t) const;
+    size_t child_index(const T& t) const;
+
+    BPlusTreeNode*& edge(size_t i);
+    BPlusTreeNode* edge(size_t i) const;
+    BPlusTreeLeafNode<T, B>& leaf();
+    const BPlusTreeLeafNode<T, B>& leaf() const;
+
+    static BPlusTreeNode* make(NodeType);
+    static void free_node(BPlusTreeNode*);
+    static void destroy(BPlusTreeNode*);
+
+    static void split_child(BPlusTreeNode&, size_t);
+    static void borrow_from_left(BPlusTreeNode&, size_t);
+    static void borrow_from_right(BPlusTreeNode&, size_t);
+    static void merge_children(BPlusTreeNode&, size_t);
+
+    static const BPlusTreeLeafNode<T, B>* find_leaf(const BPlusTreeNode*, const T&);
+    static const BPlusTreeLeafNode<T, B>* leftmost_leaf(const BPlusTreeNode*);
+
+protected:
+    BPlusTreeNode(NodeType type) : type(type), n(0) {}
+};
+
+template<typename T, size_t B>
+struct BPlusTreeLeafNode : BPlusTreeNode<T, B> {
+    BPlusTreeLeafNode* next = nullptr;
+
+    BPlusTreeLeafNode() : BPlusTreeNode<T, B>(NodeType::LEAF) {}
+};
+
+template<typename T, size_t B>
+struct BPlusTreeInternalNode : BPlusTreeNode<T, B> {
+    std::array<BPlusTreeNode<T, B>*, 2 * B> edges;
+
+    BPlusTreeInternalNode() : BPlusTreeNode<T, B>(NodeType::INTERNAL) {}
+};
+
+/**
+ * Forward cursor over the leaf chain. It is a (leaf, index) pair, and the
+ * past-the-end position is (nullptr, 0). A bounded cursor becomes the
+ * past-the-end cursor as soon as it reaches a key >= its upper bound.
+ */
+template<typename T, size_t B>
+class BPlusTree<T, B>::cursor {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    cursor() = default;
+
+    reference operator*() const { return leaf->keys[idx]; }
+    pointer operator->() const { return &leaf->keys[idx]; }
+
+    cursor& operator++() {
+        if (++idx == leaf->n) {
+            leaf = leaf->next;
+            idx = 0;
+        }
+        check_bound();
+        return *this;
+    }
+
+    cursor operator++(int) {
+        cursor prev = *this;
+        ++*this;
+        return prev;
+    }
+
+    bool operator==(const cursor& o) const { return leaf == o.leaf && idx == o.idx; }
+    bool operator!=(const cursor& o) const { return !(*this == o); }
+
+private:
+    friend struct BPlusTree<T, B>;
+
+    cursor(const BPlusTreeLeafNode<T, B>* leaf, size_t idx, std::optional<T> hi)
+        : leaf(leaf), idx(idx), hi(std::move(hi)) {
+        /* A position one past the last key of a leaf is the first key of the
+           next leaf. Leaves are never empty unless the root is. */
+        if (this->leaf && this->idx == this->leaf->n) {
+            this->leaf = this->leaf->next;
+            this->idx = 0;
+        }
+        check_bound();
+    }
+
+    void check_bound() {
+        if (leaf && hi && !(leaf->keys[idx] < *hi)) {
+            leaf = nullptr;
+            idx = 0;
+        }
+    }
+
+    const BPlusTreeLeafNode<T, B>* leaf = nullptr;
+    size_t idx = 0;
+    std::optional<T> hi;
+};
+
+template<typename T, size_t B>
+class BPlusTree<T, B>::range_view {
+public:
+    cursor begin() const { return first; }
+    cursor end() const { return cursor{}; }
+    bool empty() const { return first == cursor{}; }
+
+private:
+    friend struct BPlusTree<T, B>;
+
+    range_view(cursor first) : first(std::move(first)) {}
+
+    cursor first;
+};
+
+template<typename T, size_t B>
+bool BPlusTree<T, B>::insert(const T& t) {
+    using Node = BPlusTreeNode<T, B>;
+
+    if (!root) {
+        root = Node::make(NodeType::LEAF);
+        root->keys[0] = t;
+        root->n = 1;
+        return true;
+    }
+
+    /* Same preemptive splitting as BTree::insert: never descend into a full
+       node, so a split never has to propagate upwards. */
+    if (root->n >= 2 * B - 1) {
+        Node* new_root = Node::make(NodeType::INTERNAL);
+        new_root->edge(0) = root;
+        Node::split_child(*new_root, 0);
+        root = new_root;
+    }
+
+    Node* node = root;
+    while (node->type == NodeType::INTERNAL) {
+        size_t idx = node->child_index(t);
+        if (node->edge(idx)->n == 2 * B - 1) {
+            Node::split_child(*node, idx);
+            idx = node->child_index(t);
+        }
+        node = node->edge(idx);
+    }
+
+    size_t idx = node->get_index(t);
+    if (idx < node->n && node->keys[idx] == t)
+        return false;
+
+    for (size_t j = node->n; j > idx; j--)
+        node->keys[j] = node->keys[j - 1];
+    node->keys[idx] = t;
+    node->n++;
+
+    return true;
+}
+
+template<typename T, size_t B>
+bool BPlusTree<T, B>::remove(const T& t) {
+    using Node = BPlusTreeNode<T, B>;
+
+    if (!root)
+        return false;
+
+    /* Make sure every child we step into holds at least B keys, so that it
+       can lose one without underflowing. */
+    Node* node = root;
+    while (node->type == NodeType::INTERNAL) {
+        size_t idx = node->child_index(t);
+
+        if (node->edge(idx)->n < B) {
+            if (idx != 0 && node->edge(idx - 1)->n >= B) {
+                Node::borrow_from_left(*node, idx);
+            } else if (idx != node->n && node->edge(idx + 1)->n >= B) {
+                Node::borrow_from_right(*node, idx);
+            } else {
+                if (idx == node->n) idx--;
+                Node::merge_children(*node, idx);
+            }
+
+            /* Merging the last two children of the root shrinks the tree */
+            if (node == root && root->n == 0) {
+                root = node->edge(0);
+                Node::free_node(node);
+                node = root;
+                continue;
+            }
+
+            idx = node->child_index(t);
+        }
+
+        node = node->edge(idx);
+    }
+
+    size_t idx = node->get_index(t);
+    if (idx == node->n || !(node->keys[idx] == t))
+        return false;
+
+    for (size_t j = idx; j + 1 < node->n; j++)
+        node->keys[j] = node->keys[j + 1];
+    node->n--;
+
+    return true;
+}
+
+template<typename T, size_t B>
+bool BPlusTree<T, B>::contains(const T& t) const {
+    if (!root)
+        return false;
+
+    auto leaf = BPlusTreeNode<T, B>::find_leaf(root, t);
+    size_t idx = leaf->get_index(t);
+
+    return idx < leaf->n && leaf->keys[idx] == t;
+}
+
+template<typename T, size_t B>
+typename BPlusTree<T, B>::cursor BPlusTree<T, B>::begin() const {
+    if (!root)
+        return cursor{};
+
+    return cursor(BPlusTreeNode<T, B>::leftmost_leaf(root), 0, std::nullopt);
+}
+
+template<typename T, size_t B>
+typename BPlusTree<T, B>::cursor BPlusTree<T, B>::end() const {
+    return cursor{};
+}
+
+template<typename T, size_t B>
+typename BPlusTree<T, B>::range_view
+BPlusTree<T, B>::range(const T& lo, const T& hi) const {
+    if (!root)
+        return range_view(cursor{});
+
+    auto leaf = BPlusTreeNode<T, B>::find_leaf(root, lo);
+
+    return range_view(cursor(leaf, leaf->get_index(lo), hi));
+}
+
+/* This isn't necessarily the in-order traversal */
+template<typename T, size_t B>
+void BPlusTree<T, B>::for_all_nodes(
+    std::function<void(const BPlusTreeNode<T, B>&)> func) const {
+    if (!root)
+        return;
+
+    std::function<void(const BPlusTreeNode<T, B>*)> visit =
+        [&](const BPlusTreeNode<T, B>* node) {
+            func(*node);
+            if (node->type == NodeType::INTERNAL)
+                for (size_t i = 0; i <= node->n; i++)
+                    visit(node->edge(i));
+        };
+
+    visit(root);
+}
+
+template<typename T, size_t B>
+const std::optional<size_t> BPlusTree<T, B>::depth() const {
+    if (!root)
+        return std::nullopt;
+
+    size_t d = 0;
+    for (auto node = root; node->type == NodeType::INTERNAL; node = node->edge(0))
+        d++;
+
+    return d;
+}
+
+/* Number of keys smaller than t; see BTreeNode::get_index. */
+template<typename T, size_t B>
+size_t BPlusTreeNode<T, B>::get_index(const T& t) const {
+    return btree_search_policy_t<T, B>::index(keys.data(), n, t);
+}
+
+/* The edge to follow for t: keys equal to a separator live on its right. */
+template<typename T, size_t B>
+size_t BPlusTreeNode<T, B>::child_index(const T& t) const {
+    size_t idx = get_index(t);
+
+    return (idx < n && keys[idx] == t) ? idx + 1 : idx;
+}
+
+template<typename T, size_t B>
+BPlusTreeNode<T, B>*& BPlusTreeNode<T, B>::edge(size_t i) {
+    return static_cast<BPlusTreeInternalNode<T, B>*>(this)->edges[i];
+}
+
+template<typename T, size_t B>
+BPlusTreeNode<T, B>* BPlusTreeNode<T, B>::edge(size_t i) const {
+    return static_cast<const BPlusTreeInternalNode<T, B>*>(this)->edges[i];
+}
+
+template<typename T, size_t B>
+BPlusTreeLeafNode<T, B>& BPlusTreeNode<T, B>::leaf() {
+    return *static_cast<BPlusTreeLeafNode<T, B>*>(this);
+}
+
+template<typename T, size_t B>
+const BPlusTreeLeafNode<T, B>& BPlusTreeNode<T, B>::leaf() const {
+    return *static_cast<const BPlusTreeLeafNode<T, B>*>(this);
+}
+
+template<typename T, size_t B>
+BPlusTreeNode<T, B>* BPlusTreeNode<T, B>::make(NodeType type) {
+    if (type == NodeType::INTERNAL)
+        return new BPlusTreeInternalNode<T, B>();
+
+    return new BPlusTreeLeafNode<T, B>();
+}
+
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::free_node(BPlusTreeNode<T, B>* node) {
+    if (node->type == NodeType::INTERNAL)
+        delete static_cast<BPlusTreeInternalNode<T, B>*>(node);
+    else
+        delete static_cast<BPlusTreeLeafNode<T, B>*>(node);
+}
+
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::destroy(BPlusTreeNode<T, B>* node) {
+    if (node->type == NodeType::INTERNAL) {
+        for (size_t i = 0; i < node->n + 1; i++)
+            destroy(node->edge(i));
+    }
+
+    free_node(node);
+}
+
+/**
+ * Split the full child parent.edge(idx), whose parent is not full.
+ *
+ * A leaf keeps its lower B-1 keys, the new right leaf gets the upper B keys
+ * and a copy of the first of them becomes the separator. An internal node is
+ * split exactly like in the B-tree: the middle key moves up.
+ */
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::split_child(BPlusTreeNode<T, B>& parent, size_t idx) {
+    BPlusTreeNode<T, B>* y = parent.edge(idx);
+    BPlusTreeNode<T, B>* z = make(y->type);
+    T separator;
+
+    if (y->type == NodeType::LEAF) {
+        for (size_t j = 0; j < B; j++)
+            z->keys[j] = y->keys[j + B - 1];
+
+        z->n = B;
+        separator = z->keys[0];
+
+        z->leaf().next = y->leaf().next;
+        y->leaf().next = &z->leaf();
+    } else {
+        for (size_t j = 0; j < B - 1; j++)
+            z->keys[j] = y->keys[j + B];
+
+        for (size_t j = 0; j < B; j++)
+            z->edge(j) = y->edge(j + B);
+
+        z->n = B - 1;
+        separator = y->keys[B - 1];
+    }
+
+    y->n = B - 1;
+
+    for (size_t j = parent.n + 1; j > idx + 1; j--)
+        parent.edge(j) = parent.edge(j - 1);
+
+    for (size_t j = parent.n; j > idx; j--)
+        parent.keys[j] = parent.keys[j - 1];
+
+    parent.edge(idx + 1) = z;
+    parent.keys[idx] = separator;
+    parent.n++;
+}
+
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::borrow_from_left(BPlusTreeNode<T, B>& node, size_t e) {
+    BPlusTreeNode<T, B>* child = node.edge(e);
+    BPlusTreeNode<T, B>* sibling = node.edge(e - 1);
+
+    for (size_t i = child->n; i > 0; i--)
+        child->keys[i] = child->keys[i - 1];
+
+    if (child->type == NodeType::LEAF) {
+        /* Move the largest key of the sibling; it is the new lower bound */
+        child->keys[0] = sibling->keys[sibling->n - 1];
+        node.keys[e - 1] = child->keys[0];
+    } else {
+        /* Rotate through the parent, as in the B-tree */
+        for (size_t i = child->n + 1; i > 0; i--)
+            child->edge(i) = child->edge(i - 1);
+
+        child->keys[0] = node.keys[e - 1];
+        child->edge(0) = sibling->edge(sibling->n);
+        node.keys[e - 1] = sibling->keys[sibling->n - 1];
+    }
+
+    child->n++;
+    sibling->n--;
+}
+
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::borrow_from_right(BPlusTreeNode<T, B>& node, size_t e) {
+    BPlusTreeNode<T, B>* child = node.edge(e);
+    BPlusTreeNode<T, B>* sibling = node.edge(e + 1);
+
+    if (child->type == NodeType::LEAF) {
+        child->keys[child->n] = sibling->keys[0];
+        node.keys[e] = sibling->keys[1];
+    } else {
+        child->keys[child->n] = node.keys[e];
+        child->edge(child->n + 1) = sibling->edge(0);
+        node.keys[e] = sibling->keys[0];
+
+        for (size_t i = 0; i < sibling->n; i++)
+            sibling->edge(i) = sibling->edge(i + 1);
+    }
+
+    for (size_t i = 0; i + 1 < sibling->n; i++)
+        sibling->keys[i] = sibling->keys[i + 1];
+
+    child->n++;
+    sibling->n--;
+}
+
+/* Merge node.edge(idx + 1) into node.edge(idx). Both hold B-1 keys. Leaves
+   simply concatenate and drop the separator; internal nodes pull it down. */
+template<typename T, size_t B>
+void BPlusTreeNode<T, B>::merge_children(BPlusTreeNode<T, B>& node, size_t idx) {
+    BPlusTreeNode<T, B>* child = node.edge(idx);
+    BPlusTreeNode<T, B>* sibling = node.edge(idx + 1);
+
+    if (child->type == NodeType::LEAF) {
+        for (size_t i = 0; i < sibling->n; i++)
+            child->keys[child->n + i] = sibling->keys[i];
+
+        child->n += sibling->n;
+        child->leaf().next = sibling->leaf().next;
+    } else {
+        child->keys[child->n] = node.keys[idx];
+
+        for (size_t i = 0; i < sibling->n; i++)
+            child->keys[child->n + 1 + i] = sibling->keys[i];
+
+        for (size_t i = 0; i <= sibling->n; i++)
+            child->edge(child->n + 1 + i) = sibling->edge(i);
+
+        child->n += sibling->n + 1;
+    }
+
+    for (size_t i = idx + 1; i < node.n; i++)
+        node.keys[i - 1] = node.keys[i];
+
+    for (size_t i = idx + 2; i <= node.n; i++)
+        node.edge(i - 1) = node.edge(i);
+
+    node.n--;
+
+    free_node(sibling);
+}
+
+template<typename T, size_t B>
+const BPlusTreeLeafNode<T, B>*
+BPlusTreeNode<T, B>::find_leaf(const BPlusTreeNode<T, B>* node, const T& t) {
+    while (node->type == NodeType::INTERNAL)
+        node = node->edge(node->child_index(t));
+
+    return &node->leaf();
+}
+
+template<typename T, size_t B>
+const BPlusTreeLeafNode<T, B>*
+BPlusTreeNode<T, B>::leftmost_leaf(const BPlusTreeNode<T, B>* node) {
+    while (node->type == NodeType::INTERNAL)
+        node = node->edge(0);
+
+    return &node->leaf();
+}
@@ -1,5 +1,9 @@
+#pragma once
+
 #include <cstddef>
+#include <cstdint>
 #include <array>
+#include <atomic>
 #include <iostream>
 #include <optional>
 #include <iterator>
@@ -8,37 +12,273 @@
 #include <string>
 #include <sstream>
 #include <functional>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "btree_filter.hpp"
+#include "btree_mapped.hpp"
+#include "btree_search.hpp"
+#include "btree_stats.hpp"
+#include "slab_pool.hpp"
 
 enum class NodeType { LEAF, INTERNAL };
 
-template<typename T, size_t B = 6>
+/**
+ * Compile-time options of a BTree, given as its third template argument. To
+ * turn an option on, derive from BTreeTraits and override it.
+ *
+ *  - counted: internal nodes also store, for every edge, the number of keys
+ *    below it. This costs a size_t per edge and some bookkeeping in every
+ *    split, merge and borrow, and enables `rank`, `select` and
+ *    `count_range`.
+ *  - cow: nodes are reference counted and copied on write, so that
+ *    `snapshot` can hand out an immutable version of the tree in O(1). See
+ *    BTree::snapshot.
+ *  - filtered: a Bloom filter of the keys (BlockedBloomFilter) sits in
+ *    front of the tree, and `contains`, `find` and `remove` return early
+ *    for nearly every absent key, without descending. Every insert adds to
+ *    it; removes are only counted, and the filter is rebuilt from the keys,
+ *    in O(n), once half of what went in has gone or it is over capacity.
+ *    It takes 2 to 4 bytes per key. Not available together with cow.
+ *  - stats: the tree counts node visits, key comparisons, splits, merges,
+ *    borrows, root height changes and node allocations (BTreeStats), for
+ *    `stats` and `reset_stats`. Without it, nothing is counted or stored.
+ *  - relaxed: `remove` takes the key out of the tree without merging or
+ *    borrowing. Nodes may run down to `relaxed_min` keys (with 0, leaves
+ *    down to empty) before they are repaired; `rebalance` brings the whole
+ *    tree back to at least B - 1 keys a node, as split_at, join and
+ *    erase_range do first when there were relaxed removes since.
+ */
+struct BTreeTraits {
+    static constexpr bool counted = false;
+    static constexpr bool cow = false;
+    static constexpr bool filtered = false;
+    static constexpr bool stats = false;
+    static constexpr bool relaxed = false;
+    static constexpr size_t relaxed_min = 0;
+};
+
+struct BTreeCountedTraits : BTreeTraits {
+    static constexpr bool counted = true;
+};
+
+struct BTreeCowTraits : BTreeTraits {
+    static constexpr bool cow = true;
+};
+
+struct BTreeFilteredTraits : BTreeTraits {
+    static constexpr bool filtered = true;
+};
+
+struct BTreeStatsTraits : BTreeTraits {
+    static constexpr bool stats = true;
+};
+
+struct BTreeRelaxedTraits : BTreeTraits {
+    static constexpr bool relaxed = true;
+};
+
+/**
+ * A B for which the 2B - 1 keys of a node take up about `bytes` bytes, but
+ * at least 2; internal nodes hold 2B edges on top of that. Pass 4096 for a
+ * node per page. The default of 8 cache lines is where bench/fanout_bench
+ * has inserts, lookups and removes of 4- and 8-byte keys at their fastest.
+ *
+ * Keys that are not trivially copyable, like std::string, mostly live
+ * outside the node, and every comparison chases a pointer, so the size of
+ * the node says little. The sweep has them doing best with small nodes.
+ */
+template<typename T>
+constexpr size_t btree_fanout(size_t bytes = 512) {
+    if (!std::is_trivially_copyable_v<T>)
+        return 4;
+
+    return std::max<size_t>(2, (bytes / sizeof(T) + 1) / 2);
+}
+
+template<typename T, size_t B = 6, typename Traits = BTreeTraits>
 struct BTreeNode;
 
-template<typename T, size_t B = 6>
+template<typename T, size_t B = 6, typename Traits = BTreeTraits>
+struct BTreeInternalNode;
+
+template<typename T, size_t B = 6, typename Traits = BTreeTraits>
+class BTreeNodePool;
+
+namespace btree_detail {
+
+/* A member of BTree that its traits leave out */
+struct Absent {};
+
+} // namespace btree_detail
+
+template<typename T, size_t B = 6, typename Traits = BTreeTraits>
 struct BTree {
-    BTreeNode<T, B>* root = nullptr;
+    class iterator;
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    static_assert(!(Traits::cow && Traits::filtered),
+                  "a copy-on-write tree cannot have a filter");
+    static_assert(Traits::relaxed_min <= B - 1,
+                  "relaxed_min is at most the B - 1 keys of a balanced node");
 
-    ~BTree() { if (root) delete root; }
+    BTreeNode<T, B, Traits>* root = nullptr;
+    BTreeNodePool<T, B, Traits> pool;
+
+    /* Filtered trees only (see BTreeTraits) */
+    std::conditional_t<Traits::filtered, BlockedBloomFilter, btree_detail::NoFilter> filter;
+
+    /* Relaxed trees only: removes since the last rebalance */
+    std::conditional_t<Traits::relaxed, size_t, btree_detail::Absent> unbalanced{};
+
+    ~BTree();
 
     bool insert(const T&);
     bool remove(const T&);
+    bool contains(const T&) const;
+
+    /* The key equal to t, inserting t if there is none. The pointer stays
+       valid until the next insert or remove. */
+    std::pair<T*, bool> find_or_insert(const T&);
+
+    /* Copy-on-write trees only: the tree as it is now, unaffected by later
+       writes. */
+    std::shared_ptr<const BTree> snapshot() const;
+
+    template<typename RandomIt>
+    void bulk_load(RandomIt begin, RandomIt end, double fill_factor = 1.0,
+                   size_t threads = 1);
+
+    /* Insert, or remove one occurrence of, every key of the sorted range
+       [first, last), descending into each node once for the whole batch.
+       remove_batch returns the number of keys removed. */
+    template<typename RandomIt>
+    void insert_batch(RandomIt first, RandomIt last);
+    template<typename RandomIt>
+    size_t remove_batch(RandomIt first, RandomIt last);
+
+    /* Move the keys not less than `key` to `right`, dropping whatever it
+       held. O(B log n): the nodes off the search path change trees as
+       whole subtrees. */
+    void split_at(const T& key, BTree& right);
+
+    /* Append the keys of `right`, none of which may be less than a key of
+       this tree, leaving it empty. O(B log n). */
+    void join(BTree& right);
+
+    /* Remove every key in [lo, hi) and return how many there were. Whole
+       subtrees inside the range go at once: O(B log n) plus one visit per
+       node released. */
+    size_t erase_range(const T& lo, const T& hi);
+
+    /* Relaxed trees only: merge and even out nodes until all but the root
+       hold at least B - 1 keys again. O(n). */
+    void rebalance();
+
+    /* Write the keys to `path` as an image that open_mapped serves lookups
+       and scans from without loading it, in the layout of MappedBTree.
+       Keys must be trivially copyable. */
+    void save(const std::string& path) const;
+    static MappedBTree<T, B> open_mapped(const std::string& path);
+
+    /* In-order iteration. Iterators are invalidated by insert and remove. */
+    iterator begin() const;
+    iterator end() const;
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+    iterator lower_bound(const T&) const;
+    iterator upper_bound(const T&) const;
+    iterator find(const T&) const;
 
     void for_all(std::function<void(T&)>);
-    void for_all_nodes(std::function<void(const BTreeNode<T,B>&)>);
+    void for_all_nodes(std::function<void(const BTreeNode<T, B, Traits>&)>);
 
     const std::optional<T> find_rightmost_key() const;
     const std::optional<T> find_leftmost_key() const;
     const std::optional<size_t> depth() const;
 
+    /* Order statistics; only for counted trees (see BTreeTraits). `rank` is
+       the number of keys less than t, `select` the k-th smallest key
+       counting from 0, and `count_range` the number of keys in [lo, hi).
+       Each is O(B log n). */
+    size_t size() const;
+    size_t rank(const T&) const;
+    std::optional<T> select(size_t k) const;
+    size_t count_range(const T& lo, const T& hi) const;
+
     std::string format(void) const;
+
+    /* Stats trees only: the counters since the tree was made or last reset,
+       and, from reset_stats, the same after which they start over from 0 */
+    const BTreeStats& stats() const;
+    BTreeStats reset_stats();
+
+    /* Filtered trees only: build the filter again from the keys. The
+       mutators do this on their own when it goes stale. */
+    void rebuild_filter();
+
+    /* Filter bookkeeping of the mutators; no-ops without a filter */
+    void filter_add(const T&);
+    void filter_removed(size_t);
+
+    /* Stats trees: count the levels the root gained or lost since it was
+       `before` high, for the operations that change it by more than one */
+    size_t height() const;
+    void count_height(size_t before);
+};
+
+namespace btree_detail {
+
+/* The number of parents and trees holding a node of a copy-on-write tree */
+template<bool Shared>
+struct RefCount {};
+
+template<>
+struct RefCount<true> {
+    mutable std::atomic<size_t> refs{1};
 };
 
-template<typename T, size_t B>
-struct BTreeNode {
+/* Move `count` elements from `src` to `dst`; the two ranges may overlap.
+   Trivially copyable elements (and edges) go in one memmove, anything else
+   is moved element by element in the direction that does not overwrite
+   elements still to be moved. */
+template<typename T>
+inline void shift(T* src, size_t count, T* dst) {
+    if (count == 0 || src == dst)
+        return;
+
+    if constexpr (std::is_trivially_copyable_v<T>)
+        std::memmove(static_cast<void*>(dst), src, count * sizeof(T));
+    else if (std::less<T*>()(dst, src))
+        std::move(src, src + count, dst);
+    else
+        std::move_backward(src, src + count, dst + count);
+}
+
+} // namespace btree_detail
+
+/**
+ * Leaves never use edges, and they are the vast majority of nodes, so the two
+ * kinds of node have different layouts:
+ *
+ *  - BTreeNode is the header shared by both (type, n and keys). On its own it
+ *    is the layout of a leaf, and every algorithm works on BTreeNode pointers.
+ *  - BTreeInternalNode appends the edges. `edge(i)` reaches them from a
+ *    BTreeNode whose type is INTERNAL; calling it on a leaf is undefined.
+ *
+ * `type` is fixed at allocation time, so nodes are allocated and released
+ * through a BTreeNodePool, which knows about both layouts.
+ */
+template<typename T, size_t B, typename Traits>
+struct BTreeNode : btree_detail::RefCount<Traits::cow> {
     NodeType type;
     size_t n;
     std::array<T, 2 * B - 1> keys;
-    std::array<BTreeNode *, 2 * B> edges;
 
     BTreeNode();
     BTreeNode(const T& t);
@@ -47,408 +287,2116 @@ struct BTreeNode {
     template<typename InputIt>
     BTreeNode(InputIt begin, InputIt end);
 
-    ~BTreeNode();
+    BTreeNode*& edge(size_t i);
+    BTreeNode* edge(size_t i) const;
+
+    /* Counted trees only: the number of keys below edge(i), and below (and
+       in) this node. */
+    size_t& count(size_t i);
+    size_t count(size_t i) const;
+    size_t subtree_size() const;
+
+    bool insert(const T& t, BTreeNodePool<T, B, Traits>&);
+    size_t get_index(const T& t) const;
+
+    /* get_index, counted in the stats of the pool */
+    size_t get_index(const T& t, const BTreeNodePool<T, B, Traits>&) const;
+
+    void for_all(std::function<void(T&)> func);
+
+    bool remove(const T& t, BTreeNodePool<T, B, Traits>&);
+
+    /* The subtree part of BTree::insert_batch and BTree::remove_batch */
+    template<typename RandomIt>
+    void insert_batch(RandomIt, RandomIt, BTreeNodePool<T, B, Traits>&,
+                      std::vector<std::pair<T, BTreeNode*>>& grown);
+    template<typename RandomIt>
+    size_t remove_batch(RandomIt, RandomIt, BTreeNodePool<T, B, Traits>&);
+
+    size_t depth(void);
+    std::string format_subtree(size_t) const;
+    std::string format_level(size_t) const;
+    std::string format_node(void) const;
+    std::vector<BTreeNode<T, B, Traits>*> find_nodes_at_level(size_t) const;
+
+    void for_all_nodes(std::function<void(const BTreeNode&)>);
+
+    static std::pair<BTreeNode*, size_t> search(BTreeNode<T, B, Traits>*, const T& t);
+    static std::pair<BTreeNode*, size_t> lookup(BTreeNode<T, B, Traits>*, const T& t,
+                                                const BTreeNodePool<T, B, Traits>&);
+    static void split_child(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+    static bool try_borrow_from_sibling(BTreeNode<T, B, Traits>&, size_t,
+                                        BTreeNodePool<T, B, Traits>&);
+    static bool borrow_from_right(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+    static bool borrow_from_left(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+
+    /* NOTE: If the root node has only one key, it will be empty after
+      merging the children. Take care of updating the root. I guess this is
+      the only way a B-tree may shrink its height. */
+    static bool merge_children(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+
+    /* Helper of BTree::remove: edge e, one key short, borrows or merges */
+    static void fix_child(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+
+    static T& find_rightmost_key(BTreeNode<T, B, Traits>&);
+    static T& find_leftmost_key(BTreeNode<T, B, Traits>&);
+
+    /* Helpers of the batch operations */
+    static void distribute(BTreeNode<T, B, Traits>&, const std::vector<T>&,
+                           const std::vector<BTreeNode*>&, BTreeNodePool<T, B, Traits>&,
+                           std::vector<std::pair<T, BTreeNode*>>& grown);
+    static std::optional<T> pop_rightmost_key(BTreeNode<T, B, Traits>&,
+                                              BTreeNodePool<T, B, Traits>&, bool repair = true);
+    static void drop_edge(BTreeNode<T, B, Traits>&, size_t, BTreeNodePool<T, B, Traits>&);
+    static void repair_children(BTreeNode<T, B, Traits>&, BTreeNodePool<T, B, Traits>&);
+
+    /* Helper of BTree::rebalance: repair_children all the way down */
+    static void rebalance(BTreeNode<T, B, Traits>&, BTreeNodePool<T, B, Traits>&);
+
+    /* Helpers of split_at, join and erase_range */
+    static std::pair<BTreeNode*, BTreeNode*> split(BTreeNode*, const T&,
+                                                   BTreeNodePool<T, B, Traits>&,
+                                                   BTreeNodePool<T, B, Traits>&);
+    static std::pair<BTreeNode*, size_t> join(BTreeNode*, size_t, T, BTreeNode*, size_t,
+                                              BTreeNodePool<T, B, Traits>&);
+};
+
+namespace btree_detail {
+
+/* The per-edge key counts of an internal node of a counted tree */
+template<size_t B, bool Counted>
+struct EdgeCounts {};
+
+template<size_t B>
+struct EdgeCounts<B, true> {
+    std::array<size_t, 2 * B> counts;
+};
+
+} // namespace btree_detail
+
+template<typename T, size_t B, typename Traits>
+struct BTreeInternalNode : BTreeNode<T, B, Traits>,
+                           btree_detail::EdgeCounts<B, Traits::counted> {
+    std::array<BTreeNode<T, B, Traits>*, 2 * B> edges;
+
+    BTreeInternalNode();
+};
+
+template<typename T, size_t B = 6, typename Traits = BTreeTraits>
+using BTreeLeafNode = BTreeNode<T, B, Traits>;
+
+/**
+ * The node allocator owned by every BTree: one SlabPool per node layout.
+ *
+ * Splits and merges get and return nodes through here instead of going to
+ * malloc, and nodes allocated in a row sit next to each other. When the
+ * tree goes away, the slabs are released wholesale.
+ *
+ * BTree::split_at and BTree::join hand whole subtrees from one tree to
+ * another. The receiving pool then adopts the slabs of the giving one, and
+ * slabs are only released once no pool holds them any more. Each pool
+ * still allocates from slabs of its own, so trees that share slabs can be
+ * used from different threads.
+ */
+template<typename T, size_t B, typename Traits>
+class BTreeNodePool : public btree_detail::PoolStats<Traits::stats> {
+public:
+    BTreeNode<T, B, Traits>* make(NodeType);
+    void free_node(BTreeNode<T, B, Traits>*);
+    void destroy(BTreeNode<T, B, Traits>*);
+
+    /* Copy-on-write trees: a node only the writer holds, copying `node` if
+       a snapshot shares it. Does nothing for other trees. */
+    BTreeNode<T, B, Traits>* own(BTreeNode<T, B, Traits>*);
+    void own_edges(BTreeNode<T, B, Traits>&, size_t from, size_t to);
+
+    /* Nodes allocated by `other` are about to become part of this tree:
+       keep its slabs alive for as long as this pool. */
+    void adopt(const BTreeNodePool& other);
+
+    size_t num_slabs() const {
+        return slabs->leaves.num_slabs() + slabs->internals.num_slabs();
+    }
+
+    /* Add to a counter of `stats`, which trees with stats (see BTreeTraits)
+       keep here as every node operation has the pool at hand. Lookups count
+       too, so the counters are mutable. Nothing without stats. */
+    void count(uint64_t BTreeStats::* counter, uint64_t by = 1) const {
+        if constexpr (Traits::stats)
+            this->stats.*counter += by;
+    }
+
+private:
+    struct Slabs {
+        SlabPool<sizeof(BTreeLeafNode<T, B, Traits>), alignof(BTreeLeafNode<T, B, Traits>)> leaves;
+        SlabPool<sizeof(BTreeInternalNode<T, B, Traits>), alignof(BTreeInternalNode<T, B, Traits>)> internals;
+    };
+
+    /* Where this pool allocates and frees. A freed node goes to this free
+       list even if it was allocated by another pool, whose slabs are then
+       among the adopted ones and live at least as long. */
+    std::shared_ptr<Slabs> slabs = std::make_shared<Slabs>();
+    std::vector<std::shared_ptr<Slabs>> adopted;
+};
+
+/**
+ * Bidirectional iterator over the keys in order.
+ *
+ * The position is a path from the root: a stack of (node, index) pairs. The
+ * index of the top pair is the key the iterator is at; in every pair below
+ * it, the index is the edge that was followed. The past-the-end position is
+ * the empty stack. The stack lives inside the iterator, so it has to be as
+ * deep as the deepest tree can get.
+ *
+ * Moving within a leaf, which is what most steps do, only touches the top
+ * of the stack.
+ */
+template<typename T, size_t B, typename Traits>
+class BTree<T, B, Traits>::iterator {
+    using Node = BTreeNode<T, B, Traits>;
+
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    iterator() = default;
+
+    reference operator*() const { return top().node->keys[top().idx]; }
+    pointer operator->() const { return &**this; }
+
+    iterator& operator++();
+    iterator& operator--();
+
+    iterator operator++(int) {
+        iterator prev = *this;
+        ++*this;
+        return prev;
+    }
+
+    iterator operator--(int) {
+        iterator prev = *this;
+        --*this;
+        return prev;
+    }
+
+    bool operator==(const iterator& o) const {
+        if (depth == 0 || o.depth == 0)
+            return depth == o.depth;
+
+        return top().node == o.top().node && top().idx == o.top().idx;
+    }
+
+    bool operator!=(const iterator& o) const { return !(*this == o); }
+
+private:
+    friend struct BTree<T, B, Traits>;
+
+    /* A tree of depth d has at least 2 * B^(d-1) leaves, so no tree that
+       fits in memory has more levels than this. */
+    static constexpr size_t max_depth = [] {
+        size_t d = 2;
+        for (uint64_t leaves = 2; leaves <= UINT64_MAX / B; leaves *= B)
+            d++;
+        return d;
+    }();
+
+    struct Frame {
+        const Node* node;
+        size_t idx;
+    };
+
+    explicit iterator(const Node* root) : root(root) {}
+
+    Frame& top() { return path[depth - 1]; }
+    const Frame& top() const { return path[depth - 1]; }
+    void push(const Node* node, size_t idx) { path[depth++] = Frame{node, idx}; }
+
+    void descend_leftmost(const Node*);
+    void descend_rightmost(const Node*);
+    void settle();
+
+    const Node* root = nullptr;
+    std::array<Frame, max_depth> path;
+    size_t depth = 0;
+};
+
+/* Push the path to the smallest key below `node` */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::iterator::descend_leftmost(const Node* node) {
+    while (node->type == NodeType::INTERNAL) {
+        push(node, 0);
+        node = node->edge(0);
+    }
+    push(node, 0);
+
+    /* Relaxed trees: the leaf, and the nodes above it, may be empty */
+    if constexpr (Traits::relaxed)
+        settle();
+}
+
+/* Push the path to the largest key below `node` */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::iterator::descend_rightmost(const Node* node) {
+    while (node->type == NodeType::INTERNAL) {
+        push(node, node->n);
+        node = node->edge(node->n);
+    }
+
+    if constexpr (Traits::relaxed) {
+        /* Climb out of an empty leaf to the first key on the left */
+        if (node->n == 0) {
+            while (depth > 0 && top().idx == 0)
+                depth--;
+            if (depth > 0)
+                top().idx--;
+            return;
+        }
+    }
+
+    push(node, node->n - 1);
+}
+
+/* The path ends one past the last key of a leaf: climb to the first
+   ancestor that still has a key on the right, or to the end. */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::iterator::settle() {
+    while (depth > 0 && top().idx == top().node->n)
+        depth--;
+}
+
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator& BTree<T, B, Traits>::iterator::operator++() {
+    Frame& f = top();
+
+    if (f.node->type == NodeType::LEAF) {
+        f.idx++;
+        settle();
+        return *this;
+    }
+
+    /* Continue with the smallest key of the right subtree */
+    f.idx++;
+    descend_leftmost(f.node->edge(f.idx));
+
+    return *this;
+}
+
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator& BTree<T, B, Traits>::iterator::operator--() {
+    if (depth == 0) {
+        descend_rightmost(root);
+        return *this;
+    }
+
+    Frame& f = top();
+
+    if (f.node->type == NodeType::INTERNAL) {
+        /* Continue with the largest key of the left subtree */
+        descend_rightmost(f.node->edge(f.idx));
+        return *this;
+    }
+
+    if (f.idx > 0) {
+        f.idx--;
+        return *this;
+    }
+
+    /* Climb to the first ancestor we reached through a right edge */
+    do {
+        depth--;
+    } while (top().idx == 0);
+
+    top().idx--;
+
+    return *this;
+}
+
+/* The pool hands its slabs back in one go, so the nodes only have to be
+   visited when the keys have destructors of their own. */
+template<typename T, size_t B, typename Traits>
+BTree<T, B, Traits>::~BTree() {
+    if constexpr (Traits::cow || !std::is_trivially_destructible_v<T>) {
+        if (root)
+            pool.destroy(root);
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTree<T, B, Traits>::insert(const T& t) {
+    if (!root) {
+        root = pool.make(NodeType::LEAF);
+        pool.count(&BTreeStats::root_grows);
+        root->keys[0] = t;
+        root->n = 1;
+        filter_add(t);
+        return true;
+    }
+
+    root = pool.own(root);
+
+    /* Make sure the root node is not full. Create an empty tree which has
+       the original root as a child. Then split the original root. */
+    if (root->n >= 2 * B - 1) {
+        BTreeNode<T, B, Traits>* new_root = pool.make(NodeType::INTERNAL);
+        new_root->edge(0) = root;
+        BTreeNode<T, B, Traits>::split_child(*new_root, 0, pool);
+        root = new_root;
+        pool.count(&BTreeStats::root_grows);
+    }
+
+    bool inserted = root->insert(t, pool);
+    if (inserted)
+        filter_add(t);
+
+    return inserted;
+}
+
+/**
+ * One descent that either stops at a key equal to t or inserts t at the
+ * leaf. Full nodes are split on the way down exactly like in `insert`; a
+ * split may bring an equal key up into the current node, so it is looked
+ * at again before moving on.
+ */
+template<typename T, size_t B, typename Traits>
+std::pair<T*, bool> BTree<T, B, Traits>::find_or_insert(const T& t) {
+    if (!root) {
+        root = pool.make(NodeType::LEAF);
+        pool.count(&BTreeStats::root_grows);
+        root->keys[0] = t;
+        root->n = 1;
+        filter_add(t);
+        return { &root->keys[0], true };
+    }
+
+    root = pool.own(root);
+
+    if (root->n >= 2 * B - 1) {
+        BTreeNode<T, B, Traits>* new_root = pool.make(NodeType::INTERNAL);
+        new_root->edge(0) = root;
+        BTreeNode<T, B, Traits>::split_child(*new_root, 0, pool);
+        root = new_root;
+        pool.count(&BTreeStats::root_grows);
+    }
+
+    /* In a counted tree, the edges taken only gain a key once we know t is
+       new. Depth is at most 64 levels, even at the smallest B. */
+    [[maybe_unused]] std::array<size_t*, 64> counts;
+    size_t depth = 0;
+
+    BTreeNode<T, B, Traits>* node = root;
+    while (true) {
+        size_t idx = node->get_index(t, pool);
+
+        if (idx < node->n && node->keys[idx] == t)
+            return { &node->keys[idx], false };
+
+        if (node->type == NodeType::LEAF) {
+            btree_detail::shift(node->keys.data() + idx, node->n - idx, node->keys.data() + idx + 1);
+            node->keys[idx] = t;
+            node->n++;
+
+            if constexpr (Traits::counted)
+                for (size_t i = 0; i < depth; i++)
+                    (*counts[i])++;
+
+            /* A rebuild of the filter leaves the nodes alone */
+            filter_add(t);
+            return { &node->keys[idx], true };
+        }
+
+        pool.own_edges(*node, idx, idx);
+
+        if (node->edge(idx)->n == 2 * B - 1) {
+            BTreeNode<T, B, Traits>::split_child(*node, idx, pool);
+            continue;
+        }
+
+        if constexpr (Traits::counted)
+            counts[depth++] = &node->count(idx);
+
+        node = node->edge(idx);
+    }
+}
+
+namespace btree_detail {
+
+/* Into how many nodes `items` things should be grouped so that a node gets
+   close to `target` of them, but never fewer than `lo` or more than `hi`.
+   A single group is always allowed: that one becomes the root. */
+inline size_t bulk_groups(size_t items, size_t target, size_t lo, size_t hi) {
+    size_t want = (items + target - 1) / target;
+    size_t at_least = (items + hi - 1) / hi;
+    size_t at_most = items / lo;
+
+    return std::max<size_t>(1, std::min(std::max(want, at_least), at_most));
+}
+
+} // namespace btree_detail
+
+/**
+ * Replace the contents of the tree with the keys in [begin, end), bottom-up.
+ *
+ * Assume the input is sorted. The keys are cut into leaves left to right,
+ * each followed by one key that becomes a separator on the level above; the
+ * levels above are then built the same way from the separators, one pass
+ * per level. Every node gets about `fill_factor` * (2B-1) keys, but the
+ * counts are evened out so that no node other than the root ends up with
+ * fewer than B-1 keys. The whole build is O(n).
+ *
+ * With `threads` > 1, the leaves (which hold almost every key) are filled
+ * by that many threads, each working on a disjoint run of leaves.
+ */
+template<typename T, size_t B, typename Traits>
+template<typename RandomIt>
+void BTree<T, B, Traits>::bulk_load(RandomIt begin, RandomIt end, double fill_factor,
+                            size_t threads) {
+    using Node = BTreeNode<T, B, Traits>;
+
+    [[maybe_unused]] size_t before = Traits::stats ? height() : 0;
+
+    if (root) {
+        pool.destroy(root);
+        root = nullptr;
+    }
+
+    size_t N = std::distance(begin, end);
+
+    if constexpr (Traits::filtered) {
+        filter = BlockedBloomFilter(2 * N);
+        for (auto it = begin; it != end; ++it)
+            filter.add(btree_detail::filter_hash(*it));
+    }
+
+    if (N == 0) {
+        count_height(before);
+        return;
+    }
+
+    size_t target = static_cast<size_t>(fill_factor * (2 * B - 1) + 0.5);
+    target = std::clamp(target, B - 1, 2 * B - 1);
+
+    /* A leaf with k keys consumes k + 1 input keys: its own and the
+       separator after it (the last leaf has no separator). */
+    size_t m = btree_detail::bulk_groups(N + 1, target + 1, B, 2 * B);
+    size_t q = (N - (m - 1)) / m;
+    size_t r = (N - (m - 1)) % m;
+
+    std::vector<Node*> level(m);
+    std::vector<T> separators(m - 1);
+
+    for (auto& leaf : level)
+        leaf = pool.make(NodeType::LEAF);
+
+    auto fill_leaves = [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; i++) {
+            size_t offset = i * (q + 1) + std::min(i, r);
+            size_t cnt = q + (i < r);
+
+            std::copy(begin + offset, begin + offset + cnt, level[i]->keys.begin());
+            level[i]->n = cnt;
+
+            if (i + 1 < m)
+                separators[i] = begin[offset + cnt];
+        }
+    };
+
+    threads = std::clamp<size_t>(threads, 1, m);
+    if (threads == 1) {
+        fill_leaves(0, m);
+    } else {
+        std::vector<std::thread> workers;
+        size_t chunk = (m + threads - 1) / threads;
+
+        for (size_t from = 0; from < m; from += chunk)
+            workers.emplace_back(fill_leaves, from, std::min(m, from + chunk));
+
+        for (auto& w : workers)
+            w.join();
+    }
+
+    /* Group the nodes of one level under parents until one node is left. A
+       parent with k children takes the k-1 separators between them, and the
+       separator after its last child moves up once more. */
+    while (level.size() > 1) {
+        size_t c = level.size();
+        size_t p = btree_detail::bulk_groups(c, target + 1, B, 2 * B);
+        size_t cq = c / p;
+        size_t cr = c % p;
+
+        std::vector<Node*> parents(p);
+        std::vector<T> up(p - 1);
+
+        for (size_t j = 0, a = 0; j < p; j++) {
+            size_t k = cq + (j < cr);
+            Node* node = pool.make(NodeType::INTERNAL);
+
+            for (size_t i = 0; i < k; i++)
+                node->edge(i) = level[a + i];
+
+            if constexpr (Traits::counted)
+                for (size_t i = 0; i < k; i++)
+                    node->count(i) = level[a + i]->subtree_size();
+
+            for (size_t i = 0; i + 1 < k; i++)
+                node->keys[i] = std::move(separators[a + i]);
+
+            node->n = k - 1;
+
+            if (j + 1 < p)
+                up[j] = std::move(separators[a + k - 1]);
+
+            parents[j] = node;
+            a += k;
+        }
+
+        level = std::move(parents);
+        separators = std::move(up);
+    }
+
+    root = level[0];
+    count_height(before);
+}
+
+/* By default, use in-order traversal */
+/**
+ * Each internal node cuts its part of the batch by its separators and hands
+ * every piece to the child it belongs to, so a node is visited once however
+ * many keys go below it.
+ *
+ * Nodes are not split on the way down. Instead, a node that ends up with
+ * too many keys is spread over as many nodes as it needs, and the new ones
+ * are handed to the parent, which takes them in (and spreads itself in
+ * turn) once all of its children are done. What is still left at the root
+ * goes into new roots.
+ */
+template<typename T, size_t B, typename Traits>
+template<typename RandomIt>
+void BTree<T, B, Traits>::insert_batch(RandomIt first, RandomIt last) {
+    using Node = BTreeNode<T, B, Traits>;
+
+    if (first == last)
+        return;
+
+    if (!root) {
+        root = pool.make(NodeType::LEAF);
+        pool.count(&BTreeStats::root_grows);
+    }
+
+    root = pool.own(root);
+
+    std::vector<std::pair<T, Node*>> grown;
+    root->insert_batch(first, last, pool, grown);
+
+    while (!grown.empty()) {
+        std::vector<T> keys;
+        std::vector<Node*> edges{root};
+
+        for (auto& [sep, node] : grown) {
+            keys.push_back(sep);
+            edges.push_back(node);
+        }
+
+        grown.clear();
+        root = pool.make(NodeType::INTERNAL);
+        pool.count(&BTreeStats::root_grows);
+        Node::distribute(*root, keys, edges, pool, grown);
+    }
+
+    if constexpr (Traits::filtered) {
+        for (auto it = first; it != last; ++it)
+            filter.add(btree_detail::filter_hash(*it));
+        if (filter.stale())
+            rebuild_filter();
+    }
+}
+
+/**
+ * Works the other way round from `remove`: the whole batch is removed
+ * first, leaving nodes with too few keys (even none) behind, and every
+ * internal node then merges or evens out its children before returning to
+ * its parent. A key that is a separator is swapped for the largest key
+ * below it, like in `remove`.
+ *
+ * The shared pass removes one occurrence of each distinct key; when a key
+ * is repeated in the batch, the further copies go through `remove`.
+ */
+template<typename T, size_t B, typename Traits>
+template<typename RandomIt>
+size_t BTree<T, B, Traits>::remove_batch(RandomIt first, RandomIt last) {
+    if (!root || first == last)
+        return 0;
+
+    root = pool.own(root);
+    size_t removed = root->remove_batch(first, last, pool);
+
+    while (root->n == 0 && root->type == NodeType::INTERNAL) {
+        auto prev_root = root;
+        root = root->edge(0);
+        pool.free_node(prev_root);
+        pool.count(&BTreeStats::root_shrinks);
+    }
+
+    /* The repeats below go through remove, which counts its own */
+    filter_removed(removed);
+
+    for (auto it = first; it + 1 < last; ++it) {
+        if (*(it + 1) == *it && contains(*it)) {
+            remove(*it);
+            removed++;
+        }
+    }
+
+    return removed;
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::split_at(const T& key, BTree& right) {
+    if constexpr (Traits::relaxed)
+        if (unbalanced)
+            rebalance();
+
+    [[maybe_unused]] size_t before = Traits::stats ? height() : 0;
+    [[maybe_unused]] size_t right_before = Traits::stats ? right.height() : 0;
+
+    if (right.root)
+        right.pool.destroy(right.root);
+    right.root = nullptr;
+
+    /* Both halves keep the filter of the whole, which answers for either
+       as well as it did before */
+    if constexpr (Traits::filtered)
+        right.filter = filter;
+
+    if (!root || root->n == 0) {
+        right.count_height(right_before);
+        return;
+    }
+
+    right.pool.adopt(pool);
+    std::tie(root, right.root) = BTreeNode<T, B, Traits>::split(root, key, pool, right.pool);
+
+    count_height(before);
+    right.count_height(right_before);
+}
+
+/**
+ * Cut the tree at `lo` and at `hi` as split_at does, release the part in
+ * between whole, and join the outer parts back around the smallest key of
+ * the upper one. Only the nodes on the two boundary paths are split, and
+ * then rebalanced by the joins; O(B log n) plus a visit of every node
+ * released.
+ */
+template<typename T, size_t B, typename Traits>
+size_t BTree<T, B, Traits>::erase_range(const T& lo, const T& hi) {
+    using Node = BTreeNode<T, B, Traits>;
+
+    if (!root || root->n == 0 || !(lo < hi))
+        return 0;
+
+    if constexpr (Traits::relaxed)
+        if (unbalanced)
+            rebalance();
+
+    [[maybe_unused]] size_t before = Traits::stats ? height() : 0;
+
+    auto [left, rest] = Node::split(root, lo, pool, pool);
+    Node* middle = nullptr;
+    Node* right = nullptr;
+    root = nullptr;
+
+    if (rest)
+        std::tie(middle, right) = Node::split(rest, hi, pool, pool);
+
+    size_t erased = 0;
+    if (middle) {
+        if constexpr (Traits::counted)
+            erased = middle->subtree_size();
+        else
+            middle->for_all_nodes([&erased](const Node& node) { erased += node.n; });
+
+        pool.destroy(middle);
+    }
+
+    if (!left || !right) {
+        root = left ? left : right;
+    } else {
+        T sep = Node::find_leftmost_key(*right);
+        right->remove(sep, pool);
+
+        if (right->n == 0) {
+            Node* empty = right;
+            right = right->type == NodeType::INTERNAL ? right->edge(0) : nullptr;
+            pool.free_node(empty);
+        }
+
+        root = Node::join(left, left->depth(), std::move(sep), right,
+                          right ? right->depth() : 0, pool).first;
+    }
+
+    count_height(before);
+    filter_removed(erased);
+    return erased;
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::rebalance() {
+    static_assert(Traits::relaxed, "rebalance() needs a relaxed tree");
+
+    [[maybe_unused]] size_t before = Traits::stats ? height() : 0;
+
+    if (root) {
+        root = pool.own(root);
+        BTreeNode<T, B, Traits>::rebalance(*root, pool);
+
+        while (root->n == 0 && root->type == NodeType::INTERNAL) {
+            auto prev_root = root;
+            root = root->edge(0);
+            pool.free_node(prev_root);
+        }
+    }
+
+    count_height(before);
+    unbalanced = 0;
+}
+
+/* The smallest key of `right` becomes the separator between the two */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::join(BTree& right) {
+    using Node = BTreeNode<T, B, Traits>;
+
+    if (!right.root || right.root->n == 0)
+        return;
+
+    if constexpr (Traits::relaxed) {
+        if (unbalanced)
+            rebalance();
+        if (right.unbalanced)
+            right.rebalance();
+    }
+
+    pool.adopt(right.pool);
+
+    if constexpr (Traits::filtered)
+        filter.merge(right.filter);
+
+    [[maybe_unused]] size_t before = Traits::stats ? height() : 0;
+    [[maybe_unused]] size_t right_before = Traits::stats ? right.height() : 0;
+
+    if (!root || root->n == 0) {
+        if (root)
+            pool.destroy(root);
+        root = right.root;
+        right.root = nullptr;
+    } else {
+        /* The eager remove, which keeps right a B-tree even if it is relaxed */
+        T sep = *right.find_leftmost_key();
+        Node* other = right.pool.own(right.root);
+        right.root = nullptr;
+        other->remove(sep, right.pool);
+
+        if (other->n == 0) {
+            Node* empty = other;
+            other = other->type == NodeType::INTERNAL ? other->edge(0) : nullptr;
+            right.pool.free_node(empty);
+        }
+
+        root = Node::join(root, root->depth(), std::move(sep), other,
+                          other ? other->depth() : 0, pool).first;
+    }
+
+    count_height(before);
+    right.count_height(right_before);
+
+    /* Only now that the keys of right are in, may the merged filter be
+       rebuilt from them */
+    if constexpr (Traits::filtered) {
+        right.filter = BlockedBloomFilter();
+        if (filter.stale())
+            rebuild_filter();
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::for_all(std::function<void(T&)> func) {
+    if (root)
+        root->for_all(func);
+}
+
+/* This isn't necessarily the in-order traversal */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::for_all_nodes(std::function<void(const BTreeNode<T, B, Traits>&)> func) {
+    if (root)
+        root->for_all_nodes(func);
+}
+
+template<typename T, size_t B, typename Traits>
+const std::optional<T> BTree<T, B, Traits>::find_rightmost_key() const {
+    if (!root)
+        return std::nullopt;
+
+    if constexpr (Traits::relaxed)
+        return begin() == end() ? std::nullopt : std::optional<T>(*rbegin());
+
+    return BTreeNode<T, B, Traits>::find_rightmost_key(*root);
+}
+
+template<typename T, size_t B, typename Traits>
+const std::optional<T> BTree<T, B, Traits>::find_leftmost_key() const {
+    if (!root)
+        return std::nullopt;
+
+    if constexpr (Traits::relaxed)
+        return begin() == end() ? std::nullopt : std::optional<T>(*begin());
+
+    return BTreeNode<T, B, Traits>::find_leftmost_key(*root);
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTree<T, B, Traits>::contains(const T& t) const {
+    if constexpr (Traits::filtered)
+        if (!filter.may_contain(btree_detail::filter_hash(t)))
+            return false;
+
+    if (!root)
+        return false;
+
+    return BTreeNode<T, B, Traits>::lookup(root, t, pool).first != nullptr;
+}
+
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator BTree<T, B, Traits>::begin() const {
+    iterator it(root);
+
+    /* Only the root can be empty */
+    if (root && root->n > 0)
+        it.descend_leftmost(root);
+
+    return it;
+}
+
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator BTree<T, B, Traits>::end() const {
+    return iterator(root);
+}
+
+/* The first key that is not less than t */
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator BTree<T, B, Traits>::lower_bound(const T& t) const {
+    iterator it(root);
+    if (!root || root->n == 0)
+        return it;
+
+    for (const BTreeNode<T, B, Traits>* node = root; ; node = node->edge(it.top().idx)) {
+        it.push(node, node->get_index(t, pool));
+        if (node->type == NodeType::LEAF)
+            break;
+    }
+
+    it.settle();
+    return it;
+}
+
+/* The first key that is greater than t */
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator BTree<T, B, Traits>::upper_bound(const T& t) const {
+    iterator it(root);
+    if (!root || root->n == 0)
+        return it;
+
+    for (const BTreeNode<T, B, Traits>* node = root; ; node = node->edge(it.top().idx)) {
+        size_t idx = node->get_index(t, pool);
+        while (idx < node->n && !(t < node->keys[idx]))
+            idx++;
+
+        it.push(node, idx);
+        if (node->type == NodeType::LEAF)
+            break;
+    }
+
+    it.settle();
+    return it;
+}
+
+template<typename T, size_t B, typename Traits>
+typename BTree<T, B, Traits>::iterator BTree<T, B, Traits>::find(const T& t) const {
+    if constexpr (Traits::filtered)
+        if (!filter.may_contain(btree_detail::filter_hash(t)))
+            return end();
+
+    iterator it = lower_bound(t);
+
+    return (it != end() && *it == t) ? it : end();
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::save(const std::string& path) const {
+    MappedBTree<T, B>::write(path, begin(), end());
+}
+
+template<typename T, size_t B, typename Traits>
+MappedBTree<T, B> BTree<T, B, Traits>::open_mapped(const std::string& path) {
+    return MappedBTree<T, B>(path);
+}
+
+/**
+ * The snapshot is a tree of its own that shares the current root. Taking it
+ * costs one reference; from then on, the writer copies whatever it is about
+ * to modify (see BTreeNodePool::own). Nodes that only old versions still
+ * hold are released along with the last snapshot holding them.
+ *
+ * Taking a snapshot must not race with writes to this tree. Snapshots
+ * themselves can be read and dropped from any thread.
+ */
+template<typename T, size_t B, typename Traits>
+std::shared_ptr<const BTree<T, B, Traits>> BTree<T, B, Traits>::snapshot() const {
+    static_assert(Traits::cow, "snapshot() needs a copy-on-write tree");
+
+    auto version = std::make_shared<BTree>();
+
+    if (root) {
+        root->refs.fetch_add(1, std::memory_order_relaxed);
+        version->root = root;
+    }
+
+    return version;
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTree<T, B, Traits>::size() const {
+    static_assert(Traits::counted, "size() needs a counted tree");
+
+    return root ? root->subtree_size() : 0;
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTree<T, B, Traits>::rank(const T& t) const {
+    static_assert(Traits::counted, "rank() needs a counted tree");
+
+    if (!root)
+        return 0;
+
+    /* Everything left of the path to where t would be is smaller */
+    size_t r = 0;
+    for (const BTreeNode<T, B, Traits>* node = root; ; ) {
+        size_t idx = node->get_index(t, pool);
+        r += idx;
+
+        if (node->type == NodeType::LEAF)
+            return r;
+
+        for (size_t i = 0; i < idx; i++)
+            r += node->count(i);
+
+        node = node->edge(idx);
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+std::optional<T> BTree<T, B, Traits>::select(size_t k) const {
+    static_assert(Traits::counted, "select() needs a counted tree");
+
+    if (k >= size())
+        return std::nullopt;
+
+    const BTreeNode<T, B, Traits>* node = root;
+    while (node->type == NodeType::INTERNAL) {
+        size_t i = 0;
+        for (; k >= node->count(i); i++) {
+            k -= node->count(i);
+            if (k == 0)
+                return node->keys[i];
+            k--;
+        }
+
+        node = node->edge(i);
+    }
+
+    return node->keys[k];
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTree<T, B, Traits>::count_range(const T& lo, const T& hi) const {
+    if (!(lo < hi))
+        return 0;
+
+    return rank(hi) - rank(lo);
+}
+
+template<typename T, size_t B, typename Traits>
+const BTreeStats& BTree<T, B, Traits>::stats() const {
+    static_assert(Traits::stats, "stats() needs a tree with stats");
+
+    return pool.stats;
+}
+
+template<typename T, size_t B, typename Traits>
+BTreeStats BTree<T, B, Traits>::reset_stats() {
+    static_assert(Traits::stats, "reset_stats() needs a tree with stats");
+
+    BTreeStats interval = pool.stats;
+    pool.stats = BTreeStats();
+
+    return interval;
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTree<T, B, Traits>::height() const {
+    return root ? root->depth() + 1 : 0;
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::count_height(size_t before) {
+    if constexpr (Traits::stats) {
+        size_t after = height();
+        if (after > before)
+            pool.count(&BTreeStats::root_grows, after - before);
+        else
+            pool.count(&BTreeStats::root_shrinks, before - after);
+    }
+}
+
+/* Sized for twice the keys there are, so that it takes as many inserts
+   again before the next rebuild */
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::rebuild_filter() {
+    static_assert(Traits::filtered, "rebuild_filter() needs a filtered tree");
+
+    filter = BlockedBloomFilter(2 * std::distance(begin(), end()));
+    for (const T& k : *this)
+        filter.add(btree_detail::filter_hash(k));
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::filter_add(const T& t) {
+    if constexpr (Traits::filtered) {
+        filter.add(btree_detail::filter_hash(t));
+        if (filter.stale())
+            rebuild_filter();
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+void BTree<T, B, Traits>::filter_removed(size_t count) {
+    if constexpr (Traits::filtered) {
+        filter.removed += count;
+        if (filter.stale())
+            rebuild_filter();
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+const std::optional<size_t> BTree<T, B, Traits>::depth() const {
+    if (!root)
+        return std::nullopt;
+
+    return root->depth();
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::insert(const T& t, BTreeNodePool<T, B, Traits>& pool) {
+    size_t idx = get_index(t, pool);
+    if (type == NodeType::INTERNAL) {
+        pool.own_edges(*this, idx, idx);
+        if (edge(idx)->n == 2*B - 1) {
+            split_child(*this, idx, pool);
+            idx = get_index(t, pool);
+        }
+        if constexpr (Traits::counted)
+            count(idx)++;
+        return edge(idx)->insert(t, pool);
+    } else {
+        btree_detail::shift(keys.data() + idx, n - idx, keys.data() + idx + 1);
+        keys[idx] = t;
+        n++;
+        return true;
+    }
+}
+
+/**
+ * Find the desired position of t in current node.
+ *
+ * For example, if `n` looks like the following:
+ *
+ * [ 3 | 9 | 13 | 27 ]
+ *
+ * Then,
+ *     n.get_index(2) = 0
+ *     n.get_index(5) = 1
+ *     n.get_index(10) = 2
+ *     n.get_index(19) = 3
+ *     n.get_index(31) = 4
+ *
+ * The scan itself is delegated to the policy picked by btree_search_policy
+ * (see btree_search.hpp).
+ */
+template<typename T, size_t B, typename Traits>
+size_t BTreeNode<T, B, Traits>::get_index(const T& t) const {
+    return btree_search_policy_t<T, B>::index(keys.data(), n, t);
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTreeNode<T, B, Traits>::get_index(const T& t,
+                                          const BTreeNodePool<T, B, Traits>& pool) const {
+    size_t idx = get_index(t);
+
+    if constexpr (Traits::stats) {
+        pool.count(&BTreeStats::nodes_visited);
+        pool.count(&BTreeStats::keys_compared,
+                   btree_search_policy_t<T, B>::template compared<T>(n, idx));
+    }
+
+    return idx;
+}
+
+// NOTE: `for_all` and `for_all_nodes` are used internally for testing.
+// I'd not recommend using them in your functions...
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::for_all(std::function<void(T&)> func) {
+    if (type == NodeType::LEAF) {
+        for (auto j = 0; j < n; j++)
+            func(keys[j]);
+    } else {
+        if (n < 1)
+            return;
+
+        for (auto j = 0; j < n; j++) {
+            edge(j)->for_all(func);
+            func(keys[j]);
+        }
+
+        /* The rightest edge */
+        edge(n)->for_all(func);
+    }
+}
+
+/* This isn't necessarily the in-order traversal */
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::for_all_nodes(std::function<void(const BTreeNode<T, B, Traits>&)> func) {
+    if (type == NodeType::LEAF) {
+        func(*this);
+    } else {
+        if (n < 1)
+            return;
+
+        func(*this);
+
+        for (auto j = 0; j < n + 1; j++) {
+            edge(j)->for_all_nodes(func);
+        }
+    }
+}
+
+/* Assume this is called only when the child parent->edges[idx] is full, and
+   the parent is not full. */
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::split_child(BTreeNode<T, B, Traits>& parent, size_t idx,
+                                  BTreeNodePool<T, B, Traits>& pool) {
+    pool.count(&BTreeStats::splits);
+
+    BTreeNode<T, B, Traits>* y = parent.edge(idx);
+    BTreeNode<T, B, Traits>* z = pool.make(y->type);
+
+    btree_detail::shift(y->keys.data() + B, B - 1, z->keys.data());
+
+    if (y->type == NodeType::INTERNAL)
+        btree_detail::shift(&y->edge(0) + B, B, &z->edge(0));
+
+    btree_detail::shift(&parent.edge(0) + idx + 1, parent.n - idx, &parent.edge(0) + idx + 2);
+    btree_detail::shift(parent.keys.data() + idx, parent.n - idx, parent.keys.data() + idx + 1);
+
+    parent.edge(idx + 1) = z;
+    parent.keys[idx] = std::move(y->keys[B - 1]);
+    parent.n = parent.n + 1;
+
+    z->n = B - 1;
+    y->n = B - 1;
+
+    if constexpr (Traits::counted) {
+        if (y->type == NodeType::INTERNAL) {
+            btree_detail::shift(&y->count(0) + B, B, &z->count(0));
+        }
+
+        btree_detail::shift(&parent.count(0) + idx + 1, parent.n - idx - 1, &parent.count(0) + idx + 2);
+
+        parent.count(idx) = y->subtree_size();
+        parent.count(idx + 1) = z->subtree_size();
+    }
+}
+
+/**
+ * One read-only descent to t; a miss ends there, without a write, and
+ * returns false. On a hit, a second descent takes over the path (in a
+ * copy-on-write tree) and fixes the edge counts, and the key goes: out of
+ * its leaf, or, from an internal node, in exchange for the largest key
+ * under its left edge.
+ *
+ * Only then are the nodes on the path fixed, bottom-up. A node left with
+ * B - 2 keys borrows one from a sibling or merges with it, which may leave
+ * its parent short in turn. Relaxed trees instead let nodes run down to
+ * relaxed_min keys, and have the parent of one with fewer repair it.
+ * Without a minimum, a subtree left without keys may still lose its edge,
+ * as in remove_batch. The root goes once it has no key.
+ */
+template<typename T, size_t B, typename Traits>
+bool BTree<T, B, Traits>::remove(const T& t) {
+    using Node = BTreeNode<T, B, Traits>;
+
+    if (!root)
+        return false;
+
+    if constexpr (Traits::filtered)
+        if (!filter.may_contain(btree_detail::filter_hash(t)))
+            return false;
+
+    /* The edges taken, and the nodes they lead to. Depth is at most 64
+       levels, and so is the path down to a predecessor. */
+    std::array<size_t, 64> edges;
+    std::array<Node*, 64> path;
+    size_t depth = 0;
+    size_t idx;
+
+    for (const Node* node = root; ; node = node->edge(idx)) {
+        idx = node->get_index(t, pool);
+
+        if (idx < node->n && node->keys[idx] == t)
+            break;
+        if (node->type == NodeType::LEAF)
+            return false;
+
+        edges[depth++] = idx;
+    }
+
+    root = pool.own(root);
+    path[0] = root;
+
+    for (size_t j = 0; j < depth; j++) {
+        pool.own_edges(*path[j], edges[j], edges[j]);
+        if constexpr (Traits::counted)
+            path[j]->count(edges[j])--;
+        path[j + 1] = path[j]->edge(edges[j]);
+    }
+
+    Node* node = path[depth++];
+
+    if (node->type == NodeType::LEAF) {
+        btree_detail::shift(node->keys.data() + idx + 1, node->n - idx - 1,
+                            node->keys.data() + idx);
+        node->n--;
+    } else if constexpr (Traits::relaxed && Traits::relaxed_min == 0) {
+        pool.own_edges(*node, idx, idx);
+
+        if (auto pred = Node::pop_rightmost_key(*node->edge(idx), pool, false)) {
+            node->keys[idx] = std::move(*pred);
+            if constexpr (Traits::counted)
+                node->count(idx)--;
+        } else {
+            Node::drop_edge(*node, idx, pool);
+        }
+    } else {
+        /* Every node holds a key, so the predecessor ends the rightmost leaf */
+        Node* below = node;
+        for (size_t e = idx; ; e = below->n) {
+            pool.own_edges(*below, e, e);
+            if constexpr (Traits::counted)
+                below->count(e)--;
+
+            below = below->edge(e);
+            edges[depth - 1] = e;
+            path[depth++] = below;
+            if (below->type == NodeType::LEAF)
+                break;
+        }
+
+        node->keys[idx] = std::move(below->keys[--below->n]);
+    }
+
+    if constexpr (!Traits::relaxed) {
+        for (size_t j = depth - 1; j > 0 && path[j]->n < B - 1; j--)
+            Node::fix_child(*path[j - 1], edges[j - 1], pool);
+    } else if constexpr (Traits::relaxed_min > 0) {
+        for (size_t j = depth - 1; j > 0; j--)
+            if (path[j]->n < Traits::relaxed_min)
+                Node::repair_children(*path[j - 1], pool);
+    }
+
+    while (root->n == 0 && root->type == NodeType::INTERNAL) {
+        auto prev_root = root;
+        root = root->edge(0);
+        pool.free_node(prev_root);
+        pool.count(&BTreeStats::root_shrinks);
+    }
+
+    if constexpr (Traits::relaxed)
+        unbalanced++;
+
+    filter_removed(1);
+    return true;
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::remove(const T& t, BTreeNodePool<T, B, Traits>& pool) {
+
+    size_t idx = get_index(t, pool);
+
+    if (idx < n && keys[idx] == t) {
+        if (type == NodeType::LEAF) {
+            btree_detail::shift(keys.data() + idx + 1, n - idx - 1, keys.data() + idx);
+            n--;
+            return true;
+        } else {
+            if (edge(idx)->n >= B) {
+                pool.own_edges(*this, idx, idx);
+                T pred_key = find_rightmost_key(*edge(idx));
+                keys[idx] = pred_key;
+                edge(idx)->remove(pred_key, pool);
+            } else if (edge(idx + 1)->n >= B) {
+                pool.own_edges(*this, idx + 1, idx + 1);
+                T succ_key = find_leftmost_key(*edge(idx + 1));
+                keys[idx] = succ_key;
+                edge(idx + 1)->remove(succ_key, pool);
+                idx++;
+            } else {
+                pool.own_edges(*this, idx, idx + 1);
+                merge_children(*this, idx, pool);
+                edge(idx)->remove(t, pool);
+            }
+
+            /* The key that went away was below edge(idx) */
+            if constexpr (Traits::counted)
+                count(idx)--;
+
+            return true;
+        }
+    } else {
+        if (type == NodeType::LEAF) {
+            return false;
+        }
+
+        if (edge(idx)->n < B) {
+            if (idx != 0 && edge(idx-1)->n >= B) {
+                pool.own_edges(*this, idx - 1, idx);
+                borrow_from_left(*this, idx, pool);
+            } else if (idx != n && edge(idx+1)->n >= B) {
+                pool.own_edges(*this, idx, idx + 1);
+                borrow_from_right(*this, idx, pool);
+            } else {
+                if (idx == n) idx--;
+                pool.own_edges(*this, idx, idx + 1);
+                merge_children(*this, idx, pool);
+            }
+        }
+
+        idx = get_index(t, pool);
+        pool.own_edges(*this, idx, idx);
+        bool removed = edge(idx)->remove(t, pool);
+
+        if constexpr (Traits::counted)
+            count(idx) -= removed;
+
+        return removed;
+    }
+}
+
+/**
+ * Try to borrow a key from sibling.
+ *
+ * @e: The index of the edge that are trying to borrow a key
+ * @return true if borrowing succeed, false otherwise
+ */
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::try_borrow_from_sibling(BTreeNode<T, B, Traits>&node, size_t e,
+                                                      BTreeNodePool<T, B, Traits>& pool) {
+    if (e != node.n && node.edge(e + 1)->n >= B) {
+        borrow_from_right(node, e, pool);
+        return true;
+    } else if (e != 0 && node.edge(e - 1)->n >= B) {
+        borrow_from_left(node, e, pool);
+        return true;
+    } else return false;
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::borrow_from_right(BTreeNode<T, B, Traits>& node, size_t e,
+                                                BTreeNodePool<T, B, Traits>& pool) {
+    pool.count(&BTreeStats::borrows_right);
+
+    BTreeNode<T, B, Traits>* child = node.edge(e);
+    BTreeNode<T, B, Traits>* sibling = node.edge(e + 1);
+
+    child->keys[child->n] = std::move(node.keys[e]);
+
+    if (child->type == NodeType::INTERNAL){
+        child->edge(child->n + 1) = sibling->edge(0);
+    }
+
+    node.keys[e] = std::move(sibling->keys[0]);
+    btree_detail::shift(sibling->keys.data() + 1, sibling->n - 1, sibling->keys.data());
+
+    if (sibling->type == NodeType::INTERNAL)
+        btree_detail::shift(&sibling->edge(0) + 1, sibling->n, &sibling->edge(0));
+
+    child->n += 1;
+    sibling->n -= 1;
+
+    if constexpr (Traits::counted) {
+        size_t moved = 1;
+
+        if (child->type == NodeType::INTERNAL) {
+            moved += sibling->count(0);
+            child->count(child->n) = sibling->count(0);
+            btree_detail::shift(&sibling->count(0) + 1, sibling->n + 1, &sibling->count(0));
+        }
+
+        node.count(e) += moved;
+        node.count(e + 1) -= moved;
+    }
+
+    return true;
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::borrow_from_left(BTreeNode<T, B, Traits>& node, size_t e,
+                                               BTreeNodePool<T, B, Traits>& pool) {
+    pool.count(&BTreeStats::borrows_left);
+
+    BTreeNode<T, B, Traits>* child = node.edge(e);
+    BTreeNode<T, B, Traits>* sibling = node.edge(e - 1);
+
+    btree_detail::shift(child->keys.data(), child->n, child->keys.data() + 1);
+
+    if (child->type == NodeType::INTERNAL)
+        btree_detail::shift(&child->edge(0), child->n + 1, &child->edge(0) + 1);
+
+    child->keys[0] = std::move(node.keys[e - 1]);
+    if (child->type == NodeType::INTERNAL)
+        child->edge(0) = sibling->edge(sibling->n);
+
+    node.keys[e - 1] = std::move(sibling->keys[sibling->n - 1]);
+
+    child->n += 1;
+    sibling->n -= 1;
+
+    if constexpr (Traits::counted) {
+        size_t moved = 1;
+
+        if (child->type == NodeType::INTERNAL) {
+            moved += sibling->count(sibling->n + 1);
+
+            btree_detail::shift(&child->count(0), child->n, &child->count(0) + 1);
+            child->count(0) = sibling->count(sibling->n + 1);
+        }
+
+        node.count(e) += moved;
+        node.count(e - 1) -= moved;
+    }
+
+    return true;
+}
+
+template<typename T, size_t B, typename Traits>
+bool BTreeNode<T, B, Traits>::merge_children(BTreeNode<T, B, Traits> & node, size_t idx,
+                                     BTreeNodePool<T, B, Traits>& pool) {
+    pool.count(&BTreeStats::merges);
+
+    BTreeNode<T, B, Traits>* child = node.edge(idx);
+    BTreeNode<T, B, Traits>* sibling = node.edge(idx + 1);
+
+    child->keys[child->n] = std::move(node.keys[idx]);
+    btree_detail::shift(sibling->keys.data(), sibling->n, child->keys.data() + child->n + 1);
+
+    if (child->type == NodeType::INTERNAL)
+        btree_detail::shift(&sibling->edge(0), sibling->n + 1, &child->edge(0) + child->n + 1);
+
+    child->n += (sibling->n + 1);
 
-    bool insert(const T& t);
-    size_t get_index(const T& t);
+    btree_detail::shift(node.keys.data() + idx + 1, node.n - idx - 1, node.keys.data() + idx);
+    btree_detail::shift(&node.edge(0) + idx + 2, node.n - idx - 1, &node.edge(0) + idx + 1);
 
-    void for_all(std::function<void(T&)> func);
+    node.n -= 1;
 
-    bool remove(const T& t);
+    if constexpr (Traits::counted) {
+        if (child->type == NodeType::INTERNAL) {
+            size_t base = child->n - sibling->n;
+            btree_detail::shift(&sibling->count(0), sibling->n + 1, &child->count(0) + base);
+        }
 
-    size_t depth(void);
-    std::string format_subtree(size_t) const;
-    std::string format_level(size_t) const;
-    std::string format_node(void) const;
-    std::vector<BTreeNode<T, B>*> find_nodes_at_level(size_t) const;
+        node.count(idx) += 1 + node.count(idx + 1);
+        btree_detail::shift(&node.count(0) + idx + 2, node.n - idx, &node.count(0) + idx + 1);
+    }
 
-    void for_all_nodes(std::function<void(const BTreeNode&)>);
+    /* The edges of the sibling now belong to the child */
+    pool.free_node(sibling);
+    return true;
+}
 
-    static std::pair<BTreeNode*, size_t> search(BTreeNode<T, B>*, const T& t);
-    static void split_child(BTreeNode<T, B>&, size_t);
-    static bool try_borrow_from_sibling(BTreeNode<T, B>&, size_t);
-    static bool borrow_from_right(BTreeNode<T, B>&, size_t);
-    static bool borrow_from_left(BTreeNode<T, B>&, size_t);
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::fix_child(BTreeNode<T, B, Traits>& node, size_t e,
+                                        BTreeNodePool<T, B, Traits>& pool) {
+    if (e != 0 && node.edge(e - 1)->n >= B) {
+        pool.own_edges(node, e - 1, e);
+        borrow_from_left(node, e, pool);
+    } else if (e != node.n && node.edge(e + 1)->n >= B) {
+        pool.own_edges(node, e, e + 1);
+        borrow_from_right(node, e, pool);
+    } else {
+        if (e == node.n)
+            e--;
+        pool.own_edges(node, e, e + 1);
+        merge_children(node, e, pool);
+    }
+}
 
-    /* NOTE: If the root node has only one key, it will be empty after
-      merging the children. Take care of updating the root. I guess this is
-      the only way a B-tree may shrink its height. */
-    static bool merge_children(BTreeNode<T, B>&, size_t);
+template<typename T, size_t B, typename Traits>
+template<typename RandomIt>
+void BTreeNode<T, B, Traits>::insert_batch(RandomIt first, RandomIt last,
+                                           BTreeNodePool<T, B, Traits>& pool,
+                                           std::vector<std::pair<T, BTreeNode*>>& grown) {
+    size_t k = std::distance(first, last);
 
-    static T& find_rightmost_key(BTreeNode<T, B>&);
-    static T& find_leftmost_key(BTreeNode<T, B>&);
-};
+    if (type == NodeType::LEAF) {
+        /* Merge from the back, in place */
+        if (n + k <= 2 * B - 1) {
+            size_t i = n, j = k, w = n + k;
+            while (j > 0) {
+                if (i > 0 && first[j - 1] < keys[i - 1])
+                    keys[--w] = std::move(keys[--i]);
+                else
+                    keys[--w] = first[--j];
+            }
+            n += k;
+            return;
+        }
 
-template<typename T,  size_t B>
-bool BTree<T, B>::insert(const T& t) {
-    if (!root) {
-        root = new BTreeNode<T, B>(t);
-        return true;
+        std::vector<T> merged(n + k);
+        std::merge(keys.begin(), keys.begin() + n, first, last, merged.begin());
+        distribute(*this, merged, {}, pool, grown);
+        return;
     }
 
-    /* Make sure the root node is not full. Create an empty tree which has
-       the original root as a child. Then split the original root. */
-    if (root->n >= 2 * B - 1) {
-        BTreeNode<T, B>* new_root = new BTreeNode<T, B>{};
-        new_root->edges[0] = root;
-        new_root->type = NodeType::INTERNAL;
-        BTreeNode<T, B>::split_child(*new_root, 0);
-        root = new_root;
-    }
-    return root->insert(t);
-}
+    /* The new siblings of the children, with the edges they came from */
+    std::vector<std::pair<size_t, std::pair<T, BTreeNode*>>> spilled;
+    std::vector<std::pair<T, BTreeNode*>> below;
 
-/* By default, use in-order traversal */
-template<typename T, size_t B>
-void BTree<T, B>::for_all(std::function<void(T&)> func) {
-    if (root)
-        root->for_all(func);
-}
+    while (first != last) {
+        size_t i = get_index(*first, pool);
+        RandomIt mid = i < n ? std::upper_bound(first, last, keys[i]) : last;
 
-/* This isn't necessarily the in-order traversal */
-template<typename T, size_t B>
-void BTree<T, B>::for_all_nodes(std::function<void(const BTreeNode<T,B>&)> func) {
-    if (root)
-        root->for_all_nodes(func);
-}
+        pool.own_edges(*this, i, i);
+        edge(i)->insert_batch(first, mid, pool, below);
 
-template<typename T, size_t B>
-const std::optional<T> BTree<T, B>::find_rightmost_key() const {
-    if (!root)
-        return std::nullopt;
+        for (auto& sibling : below)
+            spilled.emplace_back(i, sibling);
+        below.clear();
 
-    return BTreeNode<T, B>::find_rightmost_key(*root);
-}
+        if constexpr (Traits::counted)
+            count(i) += std::distance(first, mid);
 
-template<typename T, size_t B>
-const std::optional<T> BTree<T, B>::find_leftmost_key() const {
-    if (!root)
-        return std::nullopt;
+        first = mid;
+    }
 
-    return BTreeNode<T, B>::find_leftmost_key(*root);
-}
+    if (spilled.empty())
+        return;
 
-template<typename T, size_t B>
-const std::optional<size_t> BTree<T, B>::depth() const {
-    if (!root)
-        return std::nullopt;
+    std::vector<T> all_keys;
+    std::vector<BTreeNode*> all_edges;
+    all_keys.reserve(n + spilled.size());
+    all_edges.reserve(n + spilled.size() + 1);
+    auto next = spilled.begin();
 
-    return root->depth();
-}
+    for (size_t i = 0; i <= n; i++) {
+        all_edges.push_back(edge(i));
 
-template<typename T, size_t B>
-bool BTreeNode<T, B>::insert(const T& t) {
-    size_t idx = get_index(t);
-    if (type == NodeType::INTERNAL) {
-        if (edges[idx]->n == 2*B - 1) {
-            split_child(*this, idx);
-            idx = get_index(t);
-        }
-        return edges[idx]->insert(t);
-    } else {
-        for (int j = static_cast<int>(n) - 1; j >= static_cast<int>(idx); j--) {
-            keys[j + 1] = keys[j];
+        for (; next != spilled.end() && next->first == i; ++next) {
+            all_keys.push_back(next->second.first);
+            all_edges.push_back(next->second.second);
         }
-        keys[idx] = t;
-        n++;
-        return true;
+
+        if (i < n)
+            all_keys.push_back(keys[i]);
     }
+
+    distribute(*this, all_keys, all_edges, pool, grown);
 }
 
 /**
- * Find the desired position of t in current node.
- *
- * For example, if `n` looks like the following:
- *
- * [ 3 | 9 | 13 | 27 ]
- *
- * Then,
- *     n.get_index(2) = 0
- *     n.get_index(5) = 1
- *     n.get_index(10) = 2
- *     n.get_index(19) = 3
- *     n.get_index(31) = 4
+ * Lay `all_keys` (and for internal nodes `all_edges`, one more of them) out
+ * left to right over `node` and as few new nodes of the same type as will
+ * hold them, with one key between every two nodes as their separator. The
+ * nodes get about the same number of keys each, which is at least B - 1 as
+ * soon as there is more than one. The new nodes, with the separators before
+ * them, are appended to `grown`.
  */
-template<typename T, size_t B>
-size_t BTreeNode<T, B>::get_index(const T& t) {
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::distribute(BTreeNode<T, B, Traits>& node,
+                                         const std::vector<T>& all_keys,
+                                         const std::vector<BTreeNode*>& all_edges,
+                                         BTreeNodePool<T, B, Traits>& pool,
+                                         std::vector<std::pair<T, BTreeNode*>>& grown) {
+    /* Group each key with the separator after it, like bulk_load */
+    size_t items = all_keys.size() + 1;
+    size_t m = btree_detail::bulk_groups(items, 2 * B, B, 2 * B);
+
+    size_t a = 0;
+    for (size_t g = 0; g < m; g++) {
+        BTreeNode* target = &node;
+        if (g > 0) {
+            target = pool.make(node.type);
+            grown.emplace_back(all_keys[a - 1], target);
+        }
 
-    size_t idx = 0;
-    while (idx < n && keys[idx] < t) idx++;
+        size_t size = items / m + (g < items % m) - 1;
 
-    return idx;
-}
+        std::copy(all_keys.begin() + a, all_keys.begin() + a + size, target->keys.begin());
+        target->n = size;
 
-// NOTE: `for_all` and `for_all_nodes` are used internally for testing.
-// I'd not recommend using them in your functions...
-template<typename T, size_t B>
-void BTreeNode<T, B>::for_all(std::function<void(T&)> func) {
-    if (type == NodeType::LEAF) {
-        for (auto j = 0; j < n; j++)
-            func(keys[j]);
-    } else {
-        if (n < 1)
-            return;
+        if (node.type == NodeType::INTERNAL) {
+            for (size_t i = 0; i <= size; i++) {
+                target->edge(i) = all_edges[a + i];
 
-        for (auto j = 0; j < n; j++) {
-            edges[j]->for_all(func);
-            func(keys[j]);
+                if constexpr (Traits::counted)
+                    target->count(i) = all_edges[a + i]->subtree_size();
+            }
         }
 
-        /* The rightest edge */
-        edges[n]->for_all(func);
+        a += size + 1;
     }
 }
 
-/* This isn't necessarily the in-order traversal */
-template<typename T, size_t B>
-void BTreeNode<T, B>::for_all_nodes(std::function<void(const BTreeNode<T,B>&)> func) {
+template<typename T, size_t B, typename Traits>
+template<typename RandomIt>
+size_t BTreeNode<T, B, Traits>::remove_batch(RandomIt first, RandomIt last,
+                                             BTreeNodePool<T, B, Traits>& pool) {
+    size_t removed = 0;
+
     if (type == NodeType::LEAF) {
-        func(*this);
-    } else {
-        if (n < 1)
-            return;
+        size_t w = 0;
 
-        func(*this);
+        for (size_t r = 0; r < n; r++) {
+            while (first != last && *first < keys[r])
+                ++first;
 
-        for (auto j = 0; j < n + 1; j++) {
-            edges[j]->for_all_nodes(func);
+            if (first != last && *first == keys[r]) {
+                while (first != last && *first == keys[r])
+                    ++first;
+                removed++;
+                continue;
+            }
+
+            if (w != r)
+                keys[w] = std::move(keys[r]);
+            w++;
         }
+
+        n = w;
+        return removed;
     }
-}
 
-/* Assume this is called only when the child parent->edges[idx] is full, and
-   the parent is not full. */
-template<typename T, size_t B>
-void BTreeNode<T, B>::split_child(BTreeNode<T, B>& parent, size_t idx) {
-    BTreeNode<T, B>* y = parent.edges[idx];
-    BTreeNode<T, B>* z = new BTreeNode<T, B>();
-    z->type = y->type;
+    while (first != last) {
+        size_t i = get_index(*first, pool);
+        RandomIt mid = i < n ? std::upper_bound(first, last, keys[i]) : last;
 
-    for (size_t j = 0; j < B - 1; j++) {
-        z->keys[j] = y->keys[j + B];
-    }
+        /* The copies of keys[i] in the batch stop at the separator */
+        RandomIt hit = i < n ? std::lower_bound(first, mid, keys[i]) : mid;
 
-    if (y->type == NodeType::INTERNAL) {
-        for (size_t j = 0; j < B; j++) {
-            z->edges[j] = y->edges[j + B];
+        size_t r = 0;
+        if (first != hit) {
+            pool.own_edges(*this, i, i);
+            r = edge(i)->remove_batch(first, hit, pool);
         }
-    }
 
-    for (int j = static_cast<int>(parent.n); j >= static_cast<int>(idx + 1); j--) {
-        parent.edges[j + 1] = parent.edges[j];
-    }
+        if constexpr (Traits::counted)
+            count(i) -= r;
+        removed += r;
+        first = mid;
 
-    for (int j = static_cast<int>(parent.n) - 1; j >= static_cast<int>(idx); j--) {
-        parent.keys[j + 1] = parent.keys[j];
-    }
+        if (hit == mid)
+            continue;
 
-    parent.edges[idx + 1] = z;
-    parent.keys[idx] = y->keys[B - 1];
-    parent.n = parent.n + 1;
+        removed++;
+        pool.own_edges(*this, i, i);
 
-    z->n = B - 1;
-    y->n = B - 1;
+        if (auto pred = pop_rightmost_key(*edge(i), pool)) {
+            keys[i] = *pred;
+            if constexpr (Traits::counted)
+                count(i)--;
+            continue;
+        }
+
+        /* Nothing is left below edge(i): drop it along with the separator */
+        drop_edge(*this, i, pool);
+    }
+
+    repair_children(*this, pool);
+    return removed;
 }
 
-template<typename T, size_t B>
-bool BTree<T, B>::remove(const T& t) {
-    if (!root)
-        return false;
+/* Take the largest key out of a subtree that remove_batch, or relaxed
+   removes, may have left with too few keys anywhere, or nullopt if it holds
+   none at all. Relaxed removes leave the nodes on the way as they are. */
+template<typename T, size_t B, typename Traits>
+std::optional<T> BTreeNode<T, B, Traits>::pop_rightmost_key(BTreeNode<T, B, Traits>& node,
+                                                            BTreeNodePool<T, B, Traits>& pool,
+                                                            bool repair) {
+    if (node.type == NodeType::LEAF) {
+        if (node.n == 0)
+            return std::nullopt;
+
+        return node.keys[--node.n];
+    }
 
-    root->remove(t);
+    pool.own_edges(node, node.n, node.n);
 
-    /* After merging, the size of the root may become 0. */
-    if (root->n == 0 && root->type == NodeType::INTERNAL) {
-        auto prev_root = root;
-        root = root->edges[0];
-        prev_root->type = NodeType::LEAF;
-        delete prev_root;
+    std::optional<T> key = pop_rightmost_key(*node.edge(node.n), pool, repair);
+
+    if (key) {
+        if constexpr (Traits::counted)
+            node.count(node.n)--;
+    } else if (node.n > 0) {
+        pool.destroy(node.edge(node.n));
+        key = node.keys[--node.n];
     }
 
-    return true;
+    if (repair)
+        repair_children(node, pool);
+    return key;
 }
 
-template<typename T, size_t B>
-bool BTreeNode<T, B>::remove(const T& t) {
+/* Take out keys[i] and the subtree under edge(i), which holds no key */
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::drop_edge(BTreeNode<T, B, Traits>& node, size_t i,
+                                        BTreeNodePool<T, B, Traits>& pool) {
+    pool.destroy(node.edge(i));
+
+    btree_detail::shift(node.keys.data() + i + 1, node.n - i - 1, node.keys.data() + i);
+    btree_detail::shift(&node.edge(0) + i + 1, node.n - i, &node.edge(0) + i);
+    if constexpr (Traits::counted)
+        btree_detail::shift(&node.count(0) + i + 1, node.n - i, &node.count(0) + i);
+    node.n--;
+}
 
-    size_t idx = get_index(t);
+/* The children are repaired first, so that every merge or evening out at
+   this node works on nodes that are in order below */
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::rebalance(BTreeNode<T, B, Traits>& node,
+                                        BTreeNodePool<T, B, Traits>& pool) {
+    if (node.type == NodeType::LEAF)
+        return;
 
-    if (idx < n && keys[idx] == t) {
-        if (type == NodeType::LEAF) {
-            for (size_t i = idx; i < n - 1; i++)
-                keys[i] = keys[i + 1];
-            n--;
-            return true;
-        } else {
-            if (edges[idx]->n >= B) {
-                T pred_key = find_rightmost_key(*edges[idx]);
-                keys[idx] = pred_key;
-                edges[idx]->remove(pred_key);
-            } else if (edges[idx + 1]->n >= B) {
-                T succ_key = find_leftmost_key(*edges[idx + 1]);
-                keys[idx] = succ_key;
-                edges[idx + 1]->remove(succ_key);
-            } else {
-                merge_children(*this, idx);
-                edges[idx]->remove(t);
-            }
-        }
-    } else {
-        if (type == NodeType::LEAF) {
-            return false;
+    pool.own_edges(node, 0, node.n);
+    for (size_t i = 0; i <= node.n; i++)
+        rebalance(*node.edge(i), pool);
+
+    repair_children(node, pool);
+}
+
+/**
+ * Bring every child of `node` back to at least B - 1 keys, by merging it
+ * with a sibling, or evening the two out if together they hold more than a
+ * node can. A child with no keys left is still one edge, so heights stay
+ * the same; the node that comes out of a merge may then have a child with
+ * too few keys in the middle, so it is repaired in turn. Only a child
+ * without siblings is left as it is, for the parent of `node`.
+ */
+template<typename T, size_t B, typename Traits>
+void BTreeNode<T, B, Traits>::repair_children(BTreeNode<T, B, Traits>& node,
+                                              BTreeNodePool<T, B, Traits>& pool) {
+    if (node.type == NodeType::LEAF)
+        return;
+
+    size_t i = 0;
+    while (node.n > 0 && i <= node.n) {
+        if (node.edge(i)->n >= B - 1) {
+            i++;
+            continue;
         }
 
-        if (edges[idx]->n < B) {
-            if (idx != 0 && edges[idx-1]->n >= B) {
-                borrow_from_left(*this, idx);
-            } else if (idx != n && edges[idx+1]->n >= B) {
-                borrow_from_right(*this, idx);
-            } else {
-                if (idx != n) merge_children(*this, idx);
-                else merge_children(*this, idx - 1);
-            }
+        size_t j = i < node.n ? i : i - 1;
+        pool.own_edges(node, j, j + 1);
+
+        BTreeNode* left = node.edge(j);
+        BTreeNode* right = node.edge(j + 1);
+
+        if (left->n + right->n + 1 <= 2 * B - 1) {
+            merge_children(node, j, pool);
+            repair_children(*left, pool);
+            i = j;
+            continue;
         }
 
-        idx = get_index(t);
-        edges[idx]->remove(t);
+        while (left->n + 1 < right->n)
+            borrow_from_right(node, j, pool);
+        while (right->n + 1 < left->n)
+            borrow_from_left(node, j + 1, pool);
 
-        return true;
+        /* Repairing below may leave either with too few keys again */
+        size_t before = left->n + right->n;
+        repair_children(*left, pool);
+        repair_children(*right, pool);
+        i = left->n + right->n == before ? j + 1 : j;
     }
-    return false;
 }
 
 /**
- * Try to borrow a key from sibling.
+ * The subtree under `root`, which holds at least one key, cut into the keys
+ * less than `key` and the others; either part may be null. The right part
+ * gets its new nodes from `right_pool`.
  *
- * @e: The index of the edge that are trying to borrow a key
- * @return true if borrowing succeed, false otherwise
+ * Walk down to `key` once. Every node on the way splits into the part left
+ * of the edge taken, kept in place, and the part right of it, moved to a
+ * new node; the keys on either side of the edge become separators. A part
+ * with no key left is replaced by its one edge. The parts are then joined
+ * back together bottom-up, each side on its own, with BTreeNode::join. The
+ * pieces a side is made of grow in height going up, so the joins cost
+ * O(B log n) altogether.
  */
-template<typename T, size_t B>
-bool BTreeNode<T, B>::try_borrow_from_sibling(BTreeNode<T, B>&node, size_t e) {
-    if (e != node.n && node.edges[e + 1]->n >= B) {
-        borrow_from_right(node, e);
-        return true;
-    } else if (e != 0 && node.edges[e - 1]->n >= B) {
-        borrow_from_left(node, e);
-        return true;
-    } else return false;
-}
-
-template<typename T, size_t B>
-bool BTreeNode<T, B>::borrow_from_right(BTreeNode<T, B>& node, size_t e) {
+template<typename T, size_t B, typename Traits>
+std::pair<BTreeNode<T, B, Traits>*, BTreeNode<T, B, Traits>*>
+BTreeNode<T, B, Traits>::split(BTreeNode* root, const T& key, BTreeNodePool<T, B, Traits>& pool,
+                               BTreeNodePool<T, B, Traits>& right_pool) {
+    using Node = BTreeNode;
+
+    struct Piece {
+        Node* node;
+        size_t height;
+        T sep;
+    };
+
+    root = pool.own(root);
+
+    std::vector<Piece> lefts, rights;
+    Node* left_leaf = nullptr;
+    Node* right_leaf = nullptr;
+    Node* node = root;
+    size_t h = root->depth();
+
+    for (; node->type == NodeType::INTERNAL; h--) {
+        size_t i = node->get_index(key, pool);
+        pool.own_edges(*node, i, i);
+        Node* child = node->edge(i);
+
+        if (i < node->n) {
+            Node* part = node->edge(node->n);
+            size_t m = node->n - i - 1;
+
+            if (m > 0) {
+                part = pool.make(NodeType::INTERNAL);
+                btree_detail::shift(node->keys.data() + i + 1, m, part->keys.data());
+                std::copy(&node->edge(0) + i + 1, &node->edge(0) + node->n + 1, &part->edge(0));
+                if constexpr (Traits::counted)
+                    std::copy(&node->count(0) + i + 1, &node->count(0) + node->n + 1,
+                              &part->count(0));
+                part->n = m;
+            }
 
-    BTreeNode<T, B>* child = node.edges[e];
-    BTreeNode<T, B>* sibling = node.edges[e + 1];
+            rights.push_back({ part, m > 0 ? h : h - 1, std::move(node->keys[i]) });
+        }
 
-    child->keys[child->n] = node.keys[e];
+        if (i > 1) {
+            T sep = std::move(node->keys[i - 1]);
+            node->n = i - 1;
+            lefts.push_back({ node, h, std::move(sep) });
+        } else {
+            if (i == 1)
+                lefts.push_back({ node->edge(0), h - 1, std::move(node->keys[0]) });
+            pool.free_node(node);
+        }
 
-    if (child->type == NodeType::INTERNAL){
-        child->edges[child->n + 1] = sibling->edges[0];
+        node = child;
     }
 
-    node.keys[e] = sibling->keys[0];
-
-    for (size_t i = 0; i < sibling->n - 1; ++i) {
-        sibling->keys[i] = sibling->keys[i + 1];
-    }
+    size_t i = node->get_index(key, pool);
 
-    if (sibling->type == NodeType::INTERNAL) {
-        for (size_t i = 0; i < sibling->n; ++i) {
-            sibling->edges[i] = sibling->edges[i + 1];
-        }
+    if (i == 0) {
+        right_leaf = node;
+    } else if (i == node->n) {
+        left_leaf = node;
+    } else {
+        right_leaf = pool.make(NodeType::LEAF);
+        btree_detail::shift(node->keys.data() + i, node->n - i, right_leaf->keys.data());
+        right_leaf->n = node->n - i;
+        node->n = i;
+        left_leaf = node;
     }
 
-    child->n += 1;
-    sibling->n -= 1;
-
-    return true;
-}
+    size_t hl = 0, hr = 0;
 
-template<typename T, size_t B>
-bool BTreeNode<T, B>::borrow_from_left(BTreeNode<T, B>& node, size_t e) {
+    for (auto p = lefts.rbegin(); p != lefts.rend(); ++p)
+        std::tie(left_leaf, hl) =
+            join(p->node, p->height, std::move(p->sep), left_leaf, hl, pool);
 
-    BTreeNode<T, B>* child = node.edges[e];
-    BTreeNode<T, B>* sibling = node.edges[e - 1];
+    for (auto p = rights.rbegin(); p != rights.rend(); ++p)
+        std::tie(right_leaf, hr) =
+            join(right_leaf, hr, std::move(p->sep), p->node, p->height, right_pool);
 
-    for (int i = static_cast<int>(child->n) - 1; i >= 0; --i) {
-        child->keys[i + 1] = child->keys[i];
-    }
+    return { left_leaf, right_leaf };
+}
 
-    if (child->type == NodeType::INTERNAL) {
-        for (int i = static_cast<int>(child->n); i >= 0; --i)
-            child->edges[i + 1] = child->edges[i];
+/**
+ * One subtree holding the keys of `left`, then `sep`, then the keys of
+ * `right`, given with their heights. Either may be null. Returns its root
+ * and height.
+ *
+ * Of equal height, the two become the children of a new root, and are
+ * merged if they fit in one node or evened out otherwise. If not, the lower
+ * one is hung off the spine of the taller one, at its own level plus one:
+ * down the right spine for a lower `right`, the left spine for a lower
+ * `left`. Full nodes are split on the way down as in insert, so the node it
+ * lands in has room for it and `sep`. Its root may hold fewer than B - 1
+ * keys; it is then merged with, or topped up from, its new neighbour. With
+ * nothing to hang, `sep` alone goes to the end (or start) of a leaf.
+ *
+ * O(B (|hl - hr| + 1)).
+ */
+template<typename T, size_t B, typename Traits>
+std::pair<BTreeNode<T, B, Traits>*, size_t>
+BTreeNode<T, B, Traits>::join(BTreeNode* left, size_t hl, T sep, BTreeNode* right, size_t hr,
+                              BTreeNodePool<T, B, Traits>& pool) {
+    if (!left && !right) {
+        BTreeNode* leaf = pool.make(NodeType::LEAF);
+        leaf->keys[0] = std::move(sep);
+        leaf->n = 1;
+        return { leaf, 0 };
     }
 
-    child->keys[0] = node.keys[e - 1];
-    if (child->type == NodeType::INTERNAL)
-        child->edges[0] = sibling->edges[sibling->n];
-
-    node.keys[e - 1] = sibling->keys[sibling->n - 1];
+    if (left && right && hl == hr) {
+        BTreeNode* top = pool.make(NodeType::INTERNAL);
+        top->keys[0] = std::move(sep);
+        top->n = 1;
+        top->edge(0) = pool.own(left);
+        top->edge(1) = pool.own(right);
 
-    child->n += 1;
-    sibling->n -= 1;
+        if constexpr (Traits::counted) {
+            top->count(0) = top->edge(0)->subtree_size();
+            top->count(1) = top->edge(1)->subtree_size();
+        }
 
-    return true;
-}
+        if (top->edge(0)->n + top->edge(1)->n + 1 <= 2 * B - 1) {
+            merge_children(*top, 0, pool);
+            BTreeNode* merged = top->edge(0);
+            pool.free_node(top);
+            return { merged, hl };
+        }
 
-template<typename T, size_t B>
-bool BTreeNode<T, B>::merge_children(BTreeNode<T, B> & node, size_t idx) {
-    BTreeNode<T, B>* child = node.edges[idx];
-    BTreeNode<T, B>* sibling = node.edges[idx + 1];
+        while (top->edge(0)->n < B - 1)
+            borrow_from_right(*top, 0, pool);
+        while (top->edge(1)->n < B - 1)
+            borrow_from_left(*top, 1, pool);
 
-    child->keys[child->n] = node.keys[idx];
-    for (auto i = 0; i < sibling->n; ++i) {
-        child->keys[child->n + 1 + i] = sibling->keys[i];
+        return { top, hl + 1 };
     }
 
-    if (child->type == NodeType::INTERNAL) {
-        for (auto i = 0; i <= sibling->n; ++i) {
-            child->edges[child->n + 1 + i] = sibling->edges[i];
-        }
+    /* Walk down the right spine of `left`, or the left one of `right` */
+    bool down_right = left && (!right || hl > hr);
+    BTreeNode* root = pool.own(down_right ? left : right);
+    BTreeNode* low = down_right ? right : left;
+    size_t height = down_right ? hl : hr;
+    size_t target = low ? (down_right ? hr : hl) + 1 : 0;
+
+    if (root->n == 2 * B - 1) {
+        BTreeNode* top = pool.make(NodeType::INTERNAL);
+        top->edge(0) = root;
+        if constexpr (Traits::counted)
+            top->count(0) = root->subtree_size();
+        split_child(*top, 0, pool);
+        root = top;
+        height++;
     }
 
-    child->n += (sibling->n + 1);
+    auto spine = [down_right](const BTreeNode* node) { return down_right ? node->n : 0; };
 
-    for (size_t i = idx + 1; i < node.n; ++i) {
-        node.keys[i - 1] = node.keys[i];
-    }
-    
-    for (size_t i = idx + 2; i <= node.n; ++i) {
-        node.edges[i - 1] = node.edges[i];
-    }
+    std::vector<BTreeNode*> path;
+    BTreeNode* node = root;
 
-    node.n -= 1;
+    for (size_t h = height; h > target; h--) {
+        pool.own_edges(*node, spine(node), spine(node));
+        if (node->edge(spine(node))->n == 2 * B - 1)
+            split_child(*node, spine(node), pool);
 
-    for (size_t i = 0; i <= sibling->n; i++) {
-        sibling->edges[i] = nullptr;
+        path.push_back(node);
+        node = node->edge(spine(node));
     }
 
-    delete sibling;
-    return true;
+    if (!low) {
+        if (down_right) {
+            node->keys[node->n] = std::move(sep);
+        } else {
+            btree_detail::shift(node->keys.data(), node->n, node->keys.data() + 1);
+            node->keys[0] = std::move(sep);
+        }
+        node->n++;
+    } else if (down_right) {
+        size_t e = node->n + 1;
+        node->keys[node->n] = std::move(sep);
+        node->edge(e) = pool.own(low);
+        node->n++;
+
+        if constexpr (Traits::counted)
+            node->count(e) = low->subtree_size();
+
+        if (node->edge(e)->n < B - 1) {
+            pool.own_edges(*node, e - 1, e - 1);
+            if (node->edge(e - 1)->n + node->edge(e)->n + 1 <= 2 * B - 1)
+                merge_children(*node, e - 1, pool);
+            else
+                while (node->edge(e)->n < B - 1)
+                    borrow_from_left(*node, e, pool);
+        }
+    } else {
+        btree_detail::shift(node->keys.data(), node->n, node->keys.data() + 1);
+        btree_detail::shift(&node->edge(0), node->n + 1, &node->edge(0) + 1);
+        node->keys[0] = std::move(sep);
+        node->edge(0) = pool.own(low);
+
+        if constexpr (Traits::counted) {
+            btree_detail::shift(&node->count(0), node->n + 1, &node->count(0) + 1);
+            node->count(0) = node->edge(0)->subtree_size();
+        }
+        node->n++;
+
+        if (node->edge(0)->n < B - 1) {
+            pool.own_edges(*node, 1, 1);
+            if (node->edge(0)->n + node->edge(1)->n + 1 <= 2 * B - 1)
+                merge_children(*node, 0, pool);
+            else
+                while (node->edge(0)->n < B - 1)
+                    borrow_from_right(*node, 0, pool);
+        }
+    }
+
+    /* Everything that came in went below the spine edge of every node on
+       the way */
+    if constexpr (Traits::counted)
+        for (auto a = path.rbegin(); a != path.rend(); ++a)
+            (*a)->count(spine(*a)) = (*a)->edge(spine(*a))->subtree_size();
+
+    return { root, height };
 }
 
-template<typename T, size_t B>
-T& BTreeNode<T, B>::find_rightmost_key(BTreeNode<T, B>& node) {
+template<typename T, size_t B, typename Traits>
+T& BTreeNode<T, B, Traits>::find_rightmost_key(BTreeNode<T, B, Traits>& node) {
     if (node.type == NodeType::LEAF)
         return node.keys[node.n - 1];
 
-    return find_rightmost_key(*node.edges[node.n]);
+    return find_rightmost_key(*node.edge(node.n));
 }
 
-template<typename T, size_t B>
-T& BTreeNode<T, B>::find_leftmost_key(BTreeNode<T, B>& node) {
+template<typename T, size_t B, typename Traits>
+T& BTreeNode<T, B, Traits>::find_leftmost_key(BTreeNode<T, B, Traits>& node) {
     if (node.type == NodeType::LEAF)
         return node.keys[0];
 
-    return find_leftmost_key(*node.edges[0]);
+    return find_leftmost_key(*node.edge(0));
 }
 
 // NOTE: `search` function is originally intended to be used by testing code.
 // Don't modify this function. You can reuse this function 'as-is', or, if
 // you want to do something different, add another function based on this function.
-template<typename T, size_t B>
-std::pair<BTreeNode<T, B>*, size_t>
-BTreeNode<T, B>::search(BTreeNode<T, B>* node, const T& t) {
+template<typename T, size_t B, typename Traits>
+std::pair<BTreeNode<T, B, Traits>*, size_t>
+BTreeNode<T, B, Traits>::search(BTreeNode<T, B, Traits>* node, const T& t) {
     if (node->type == NodeType::LEAF) {
         for (auto i = 0; i < node->keys.size(); i++)
             if (t == node->keys[i])
@@ -463,37 +2411,56 @@ BTreeNode<T, B>::search(BTreeNode<T, B>* node, const T& t) {
             return { node, i };
 
         if (t < node->keys[i]) {
-            return search(node->edges[i], t);
+            return search(node->edge(i), t);
         }
     }
 
-    return search(node->edges[i], t);
+    return search(node->edge(i), t);
 }
 
-template<typename T, size_t B>
-size_t BTreeNode<T, B>::depth(void) {
+/* Same contract as `search`, but every level is probed with `get_index`
+   instead of a key-by-key scan, and stale slots past `n` are never looked at. */
+template<typename T, size_t B, typename Traits>
+std::pair<BTreeNode<T, B, Traits>*, size_t>
+BTreeNode<T, B, Traits>::lookup(BTreeNode<T, B, Traits>* node, const T& t,
+                                const BTreeNodePool<T, B, Traits>& pool) {
+    while (true) {
+        size_t idx = node->get_index(t, pool);
+
+        if (idx < node->n && node->keys[idx] == t)
+            return { node, idx };
+
+        if (node->type == NodeType::LEAF)
+            return { nullptr, -1 };
+
+        node = node->edge(idx);
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTreeNode<T, B, Traits>::depth(void) {
     if (type == NodeType::LEAF)
         return 0;
 
-    return 1 + edges[0]->depth();
+    return 1 + edge(0)->depth();
 }
 
-template<typename T, size_t B>
-std::ostream& operator<<(std::ostream& os, const BTree<T, B>& btree) {
+template<typename T, size_t B, typename Traits>
+std::ostream& operator<<(std::ostream& os, const BTree<T, B, Traits>& btree) {
     os << btree.format();
     return os;
 }
 
-template <typename T, size_t B>
-std::string BTree<T, B>::format(void) const {
+template<typename T, size_t B, typename Traits>
+std::string BTree<T, B, Traits>::format(void) const {
     if (!root)
         return std::string{};
 
     return root->format_subtree(root->depth());
 }
 
-template<typename T, size_t B>
-std::string BTreeNode<T, B>::format_subtree(size_t depth) const {
+template<typename T, size_t B, typename Traits>
+std::string BTreeNode<T, B, Traits>::format_subtree(size_t depth) const {
     std::ostringstream os;
 
     for (auto i = 0; i <= depth; i++)
@@ -502,8 +2469,8 @@ std::string BTreeNode<T, B>::format_subtree(size_t depth) const {
     return os.str();
 }
 
-template<typename T, size_t B>
-std::string BTreeNode<T, B>::format_level(size_t level) const {
+template<typename T, size_t B, typename Traits>
+std::string BTreeNode<T, B, Traits>::format_level(size_t level) const {
     std::ostringstream os;
     auto nodes_at_level = find_nodes_at_level(level);
 
@@ -514,8 +2481,8 @@ std::string BTreeNode<T, B>::format_level(size_t level) const {
 }
 
 
-template<typename T, size_t B>
-std::string BTreeNode<T, B>::format_node(void) const {
+template<typename T, size_t B, typename Traits>
+std::string BTreeNode<T, B, Traits>::format_node(void) const {
     std::ostringstream os;
 
     if (n < 1) {
@@ -532,17 +2499,17 @@ std::string BTreeNode<T, B>::format_node(void) const {
     return os.str();
 }
 
-template<typename T, size_t B>
-std::vector<BTreeNode<T, B>*> BTreeNode<T, B>::find_nodes_at_level(size_t lv) const {
-    std::vector<BTreeNode<T, B>*> nodes;
+template<typename T, size_t B, typename Traits>
+std::vector<BTreeNode<T, B, Traits>*> BTreeNode<T, B, Traits>::find_nodes_at_level(size_t lv) const {
+    std::vector<BTreeNode<T, B, Traits>*> nodes;
 
     if (lv == 0) {
-        nodes.emplace_back(const_cast<BTreeNode<T, B>*>(this));
+        nodes.emplace_back(const_cast<BTreeNode<T, B, Traits>*>(this));
         return nodes;
     } else {
-        std::vector<BTreeNode<T, B>*> tmp;
+        std::vector<BTreeNode<T, B, Traits>*> tmp;
         for (auto i = 0; i < n + 1; i++) {
-            tmp = edges[i]->find_nodes_at_level(lv - 1);
+            tmp = edge(i)->find_nodes_at_level(lv - 1);
             std::copy(tmp.begin(), tmp.end(), std::back_inserter(nodes));
         }
 
@@ -550,34 +2517,177 @@ std::vector<BTreeNode<T, B>*> BTreeNode<T, B>::find_nodes_at_level(size_t lv) co
     }
 }
 
-template<typename T, size_t B>
-BTreeNode<T, B>::BTreeNode() : n(0), type(NodeType::LEAF) {}
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>::BTreeNode() : n(0), type(NodeType::LEAF) {}
 
-template<typename T, size_t B>
-BTreeNode<T, B>::BTreeNode(const T& t) : n(1), type(NodeType::LEAF) {
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>::BTreeNode(const T& t) : n(1), type(NodeType::LEAF) {
     keys[0] = t;
 }
 
 /* Assume the input initializer list is sorted */
-template<typename T, size_t B>
-BTreeNode<T, B>::BTreeNode(std::initializer_list<T> l)
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>::BTreeNode(std::initializer_list<T> l)
     : n(l.size()), type(NodeType::LEAF) {
     std::copy(l.begin(), l.end(), keys.begin());
 }
 
 /* Assume the input iterator is sorted. */
-template<typename T, size_t B>
+template<typename T, size_t B, typename Traits>
 template<typename InputIt>
-BTreeNode<T, B>::BTreeNode(InputIt begin, InputIt end)
+BTreeNode<T, B, Traits>::BTreeNode(InputIt begin, InputIt end)
     : n(end - begin), type(NodeType::LEAF) {
     std::copy(begin, end, keys.begin());
 }
 
-template<typename T, size_t B>
-BTreeNode<T, B>::~BTreeNode() {
-    if (this->type == NodeType::LEAF)
+template<typename T, size_t B, typename Traits>
+BTreeInternalNode<T, B, Traits>::BTreeInternalNode() {
+    this->type = NodeType::INTERNAL;
+}
+
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>*& BTreeNode<T, B, Traits>::edge(size_t i) {
+    return static_cast<BTreeInternalNode<T, B, Traits>*>(this)->edges[i];
+}
+
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>* BTreeNode<T, B, Traits>::edge(size_t i) const {
+    return static_cast<const BTreeInternalNode<T, B, Traits>*>(this)->edges[i];
+}
+
+template<typename T, size_t B, typename Traits>
+size_t& BTreeNode<T, B, Traits>::count(size_t i) {
+    return static_cast<BTreeInternalNode<T, B, Traits>*>(this)->counts[i];
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTreeNode<T, B, Traits>::count(size_t i) const {
+    return static_cast<const BTreeInternalNode<T, B, Traits>*>(this)->counts[i];
+}
+
+template<typename T, size_t B, typename Traits>
+size_t BTreeNode<T, B, Traits>::subtree_size() const {
+    size_t total = n;
+
+    if (type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= n; i++)
+            total += count(i);
+
+    return total;
+}
+
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>* BTreeNodePool<T, B, Traits>::make(NodeType type) {
+    count(&BTreeStats::nodes_allocated);
+
+    /* Nodes of a copy-on-write tree may be released by whichever thread
+       drops the last snapshot holding them, so they skip the slabs. */
+    if constexpr (Traits::cow) {
+        if (type == NodeType::INTERNAL)
+            return new BTreeInternalNode<T, B, Traits>();
+
+        return new BTreeLeafNode<T, B, Traits>();
+    }
+
+    if (type == NodeType::INTERNAL)
+        return ::new (slabs->internals.allocate()) BTreeInternalNode<T, B, Traits>();
+
+    return ::new (slabs->leaves.allocate()) BTreeLeafNode<T, B, Traits>();
+}
+
+/* Release a single node. Its children, if any, are left alone. */
+template<typename T, size_t B, typename Traits>
+void BTreeNodePool<T, B, Traits>::free_node(BTreeNode<T, B, Traits>* node) {
+    count(&BTreeStats::nodes_freed);
+
+    if constexpr (Traits::cow) {
+        if (node->type == NodeType::INTERNAL)
+            delete static_cast<BTreeInternalNode<T, B, Traits>*>(node);
+        else
+            delete node;
         return;
+    }
+
+    if (node->type == NodeType::INTERNAL) {
+        static_cast<BTreeInternalNode<T, B, Traits>*>(node)->~BTreeInternalNode();
+        slabs->internals.deallocate(node);
+    } else {
+        node->~BTreeNode();
+        slabs->leaves.deallocate(node);
+    }
+}
+
+/* Release a node and everything below it. In a copy-on-write tree, this
+   drops one reference, and only the last one releases anything. */
+template<typename T, size_t B, typename Traits>
+void BTreeNodePool<T, B, Traits>::destroy(BTreeNode<T, B, Traits>* node) {
+    if constexpr (Traits::cow) {
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) > 1)
+            return;
+    }
+
+    if (node->type == NodeType::INTERNAL) {
+        for (size_t i = 0; i < node->n + 1; i++)
+            if (node->edge(i)) destroy(node->edge(i));
+    }
+
+    free_node(node);
+}
+
+/**
+ * A node that is shared with a snapshot is never written to. Instead, the
+ * writer swaps it for a private copy, which shares the children of the
+ * original, and drops its reference to the original.
+ *
+ * Writers take nodes over top-down along the path they modify, so a node
+ * held once, below a node the writer owns, is owned by the writer too. A
+ * write thus copies at most the nodes on its path and their siblings it
+ * borrows from or merges with.
+ */
+template<typename T, size_t B, typename Traits>
+BTreeNode<T, B, Traits>* BTreeNodePool<T, B, Traits>::own(BTreeNode<T, B, Traits>* node) {
+    if constexpr (!Traits::cow) {
+        return node;
+    } else {
+        if (node->refs.load(std::memory_order_acquire) == 1)
+            return node;
+
+        BTreeNode<T, B, Traits>* copy = make(node->type);
+        std::copy(node->keys.begin(), node->keys.begin() + node->n, copy->keys.begin());
+        copy->n = node->n;
+
+        if (node->type == NodeType::INTERNAL) {
+            for (size_t i = 0; i <= node->n; i++) {
+                copy->edge(i) = node->edge(i);
+                copy->edge(i)->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if constexpr (Traits::counted)
+                for (size_t i = 0; i <= node->n; i++)
+                    copy->count(i) = node->count(i);
+        }
+
+        destroy(node);
+        return copy;
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+void BTreeNodePool<T, B, Traits>::adopt(const BTreeNodePool& other) {
+    auto keep = [this](const std::shared_ptr<Slabs>& s) {
+        if (s != slabs && std::find(adopted.begin(), adopted.end(), s) == adopted.end())
+            adopted.push_back(s);
+    };
+
+    keep(other.slabs);
+    for (auto& s : other.adopted)
+        keep(s);
+}
 
-    for (auto i = 0; i < n + 1; i++)
-        if (edges[i]) delete edges[i];
+template<typename T, size_t B, typename Traits>
+void BTreeNodePool<T, B, Traits>::own_edges(BTreeNode<T, B, Traits>& node,
+                                            size_t from, size_t to) {
+    if constexpr (Traits::cow)
+        for (size_t i = from; i <= to; i++)
+            node.edge(i) = own(node.edge(i));
 }
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <vector>
+
+/**
+ * Split-block Bloom filter over 64-bit key hashes.
+ *
+ * The filter is an array of 256-bit blocks, each eight 32-bit words. A key
+ * sets one bit in every word of a single block, so a lookup touches one
+ * cache line and tests eight bits in one go (the loops below compile to a
+ * few vector instructions). The high half of the hash picks the block, the
+ * low half the bits. At its capacity the filter holds 16 to 32 bits per
+ * key, for a false positive rate well under 1%.
+ *
+ * Bits are never cleared, so a filter can answer for keys that have since
+ * gone. Its owner counts those in `removed` and rebuilds it from scratch
+ * once `stale` says so.
+ *
+ * The number of blocks is a power of two and the block of a key its hash
+ * modulo that number. A filter can thus take in another one of a different
+ * size: a block of the smaller one covers every block of the larger one at
+ * the same index modulo its size.
+ */
+class BlockedBloomFilter {
+    struct alignas(32) Block {
+        std::array<uint32_t, 8> words{};
+    };
+
+public:
+    static constexpr size_t min_capacity = 1024;
+
+    explicit BlockedBloomFilter(size_t capacity = min_capacity) {
+        capacity = std::max(capacity, min_capacity);
+
+        size_t n = 1;
+        while (n * 256 < capacity * 16)
+            n *= 2;
+
+        blocks.resize(n);
+        keys = n * 16;
+    }
+
+    void add(uint64_t hash) {
+        Block& block = blocks[(hash >> 32) & (blocks.size() - 1)];
+        std::array<uint32_t, 8> m = mask(hash);
+
+        for (size_t i = 0; i < 8; i++)
+            block.words[i] |= m[i];
+
+        added++;
+    }
+
+    bool may_contain(uint64_t hash) const {
+        const Block& block = blocks[(hash >> 32) & (blocks.size() - 1)];
+        std::array<uint32_t, 8> m = mask(hash);
+
+        uint32_t missing = 0;
+        for (size_t i = 0; i < 8; i++)
+            missing |= m[i] & ~block.words[i];
+
+        return missing == 0;
+    }
+
+    /* Take in the keys of `other`, growing to its size if it is larger */
+    void merge(const BlockedBloomFilter& other) {
+        if (other.blocks.size() > blocks.size()) {
+            std::vector<Block> grown(other.blocks.size());
+            for (size_t j = 0; j < grown.size(); j++)
+                grown[j] = blocks[j & (blocks.size() - 1)];
+            blocks.swap(grown);
+            keys = other.keys;
+        }
+
+        for (size_t j = 0; j < blocks.size(); j++)
+            for (size_t i = 0; i < 8; i++)
+                blocks[j].words[i] |= other.blocks[j & (other.blocks.size() - 1)].words[i];
+
+        added += other.added;
+        removed += other.removed;
+    }
+
+    /* Over capacity, or more than half of what went in has gone */
+    bool stale() const { return added > keys || 2 * removed > added; }
+
+    /* The number of keys the filter is sized for */
+    size_t capacity() const { return keys; }
+    size_t memory_bytes() const { return blocks.size() * sizeof(Block); }
+
+    /* Keys added, and keys removed since, as counted by the owner */
+    size_t added = 0;
+    size_t removed = 0;
+
+private:
+    static std::array<uint32_t, 8> mask(uint64_t hash) {
+        static constexpr std::array<uint32_t, 8> salt{
+            0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+            0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u,
+        };
+
+        std::array<uint32_t, 8> m;
+        for (size_t i = 0; i < 8; i++)
+            m[i] = uint32_t(1) << ((uint32_t(hash) * salt[i]) >> 27);
+
+        return m;
+    }
+
+    std::vector<Block> blocks;
+    size_t keys;
+};
+
+namespace btree_detail {
+
+/* std::hash is the identity for integers on common standard libraries, so
+   spread its bits before they pick blocks and bits (splitmix64) */
+template<typename T>
+inline uint64_t filter_hash(const T& t) {
+    uint64_t h = std::hash<T>{}(t);
+
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+
+    return h;
+}
+
+/* The filter member of a BTree that has none */
+struct NoFilter {};
+
+} // namespace btree_detail
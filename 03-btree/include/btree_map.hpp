@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "btree.hpp"
+
+/**
+ * Ordered key/value map on top of the B-tree engine.
+ *
+ * Every key is stored together with its value as one BTreeMapEntry in the
+ * node arrays, and entries compare by key only. Whatever the engine does to
+ * a key (split_child, merge_children, the borrows, the predecessor swap in
+ * remove) therefore moves its value along with it.
+ *
+ * Unlike BTree, keys are unique. find, insert_or_assign, try_emplace and
+ * upsert each take a single root-to-leaf descent.
+ *
+ * Looking a key up builds a probe entry with a default value, so V must be
+ * default constructible (node arrays need that anyway).
+ */
+
+template<typename K, typename V>
+struct BTreeMapEntry {
+    K key;
+    V value;
+
+    bool operator<(const BTreeMapEntry& o) const { return key < o.key; }
+    bool operator==(const BTreeMapEntry& o) const { return key == o.key; }
+};
+
+template<typename K, typename V, size_t B = 6>
+class BTreeMap {
+    using Entry = BTreeMapEntry<K, V>;
+
+public:
+    V* find(const K&);
+    const V* find(const K&) const;
+    bool contains(const K& k) const { return find(k) != nullptr; }
+
+    /* Insert k -> v, or overwrite the value of k. Return whether k is new. */
+    bool insert_or_assign(const K& k, const V& v);
+
+    /* Insert k -> V(args...) unless k is present. The value is only built
+       when it is inserted. */
+    template<typename... Args>
+    std::pair<V*, bool> try_emplace(const K& k, Args&&... args);
+
+    /* Call fn(value) on the value of k, inserting a default-constructed
+       value first if k is missing. Return whether k is new. */
+    template<typename F>
+    bool upsert(const K& k, F&& fn);
+
+    bool erase(const K&);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void for_all(std::function<void(const K&, V&)>);
+    const std::optional<size_t> depth() const { return tree.depth(); }
+
+private:
+    BTree<Entry, B> tree;
+    size_t count = 0;
+};
+
+template<typename K, typename V, size_t B>
+V* BTreeMap<K, V, B>::find(const K& k) {
+    if (!tree.root)
+        return nullptr;
+
+    auto [node, idx] = BTreeNode<Entry, B>::lookup(tree.root, Entry{k, V{}}, tree.pool);
+
+    return node ? &node->keys[idx].value : nullptr;
+}
+
+template<typename K, typename V, size_t B>
+const V* BTreeMap<K, V, B>::find(const K& k) const {
+    return const_cast<BTreeMap*>(this)->find(k);
+}
+
+template<typename K, typename V, size_t B>
+bool BTreeMap<K, V, B>::insert_or_assign(const K& k, const V& v) {
+    auto [entry, inserted] = tree.find_or_insert(Entry{k, v});
+
+    if (inserted)
+        count++;
+    else
+        entry->value = v;
+
+    return inserted;
+}
+
+template<typename K, typename V, size_t B>
+template<typename... Args>
+std::pair<V*, bool> BTreeMap<K, V, B>::try_emplace(const K& k, Args&&... args) {
+    auto [entry, inserted] = tree.find_or_insert(Entry{k, V{}});
+
+    if (inserted) {
+        entry->value = V(std::forward<Args>(args)...);
+        count++;
+    }
+
+    return { &entry->value, inserted };
+}
+
+template<typename K, typename V, size_t B>
+template<typename F>
+bool BTreeMap<K, V, B>::upsert(const K& k, F&& fn) {
+    auto [entry, inserted] = tree.find_or_insert(Entry{k, V{}});
+
+    if (inserted)
+        count++;
+
+    std::forward<F>(fn)(entry->value);
+
+    return inserted;
+}
+
+template<typename K, typename V, size_t B>
+bool BTreeMap<K, V, B>::erase(const K& k) {
+    if (!tree.remove(Entry{k, V{}}))
+        return false;
+
+    count--;
+
+    return true;
+}
+
+template<typename K, typename V, size_t B>
+void BTreeMap<K, V, B>::for_all(std::function<void(const K&, V&)> func) {
+    tree.for_all([&func](Entry& e) { func(e.key, e.value); });
+}
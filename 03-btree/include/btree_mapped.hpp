@@ -0,0 +1,566 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "btree_search.hpp"
+
+/**
+ * A read-only B-tree served straight from a file, as written by BTree::save
+ * and opened by BTree::open_mapped.
+ *
+ * The image is one header page, then the internal nodes, level by level from
+ * the root, then the leaves, left to right; both runs start on a page
+ * boundary. Nodes are full, up to the keys being evened out between the last
+ * few (like bulk_load with a fill factor of 1), and keys are stored as raw
+ * bytes. Edges are node numbers instead of pointers: into the internal nodes,
+ * or into the leaves from the last internal level.
+ *
+ * Opening maps the file read-only and checks the header; nothing is read or
+ * built, so a lookup faults in only the pages on its path, and the mapping is
+ * shared with every process that has the same image open. Saving writes a
+ * new file and renames it over the old one, so open images stay as they are.
+ *
+ * An image is only opened with the key type and B it was saved with, on a
+ * machine of the same byte order; the header records enough to tell.
+ */
+
+namespace btree_detail {
+
+inline void write_all(int fd, const char* p, size_t len) {
+    while (len > 0) {
+        ssize_t w = ::write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "write");
+        }
+        p += w;
+        len -= w;
+    }
+}
+
+inline void sync_fd(int fd) {
+    if (::fsync(fd) < 0)
+        throw std::system_error(errno, std::generic_category(), "fsync");
+}
+
+} // namespace btree_detail
+
+struct MappedBTreeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t key_size;
+    uint32_t fanout;
+    uint32_t internal_size;
+    uint32_t leaf_size;
+
+    /* Levels, 0 for an empty tree; the root is the first internal node, or
+       the only leaf */
+    uint32_t height;
+    uint32_t pad;
+    uint64_t size;
+
+    uint64_t internals;
+    uint64_t leaves;
+    uint64_t internal_offset;
+    uint64_t leaf_offset;
+    uint64_t file_size;
+};
+
+template<typename T, size_t B = 6>
+class MappedBTree {
+    static_assert(std::is_trivially_copyable_v<T>, "keys are stored as raw bytes");
+
+public:
+    static constexpr size_t page_size = 4096;
+    static constexpr uint32_t version = 1;
+
+    struct Leaf {
+        uint32_t n;
+        std::array<T, 2 * B - 1> keys;
+    };
+
+    struct Internal {
+        uint32_t n;
+        std::array<uint32_t, 2 * B> edges;
+        std::array<T, 2 * B - 1> keys;
+    };
+
+    class iterator;
+    using const_iterator = iterator;
+
+    explicit MappedBTree(const std::string& path);
+    MappedBTree(MappedBTree&&) noexcept;
+    MappedBTree& operator=(MappedBTree&&) noexcept;
+    MappedBTree(const MappedBTree&) = delete;
+    MappedBTree& operator=(const MappedBTree&) = delete;
+    ~MappedBTree();
+
+    /* Write the sorted keys [first, last) to `path` as an image. Two passes
+       over the range; only the separators are kept in memory. */
+    template<typename ForwardIt>
+    static void write(const std::string& path, ForwardIt first, ForwardIt last);
+
+    bool contains(const T&) const;
+
+    /* In-order iteration; iterators stay valid as long as the tree */
+    iterator begin() const;
+    iterator end() const;
+
+    iterator lower_bound(const T&) const;
+    iterator find(const T&) const;
+
+    size_t size() const { return count; }
+    size_t height() const { return levels; }
+
+private:
+    using Search = btree_search_policy_t<T, B>;
+
+    static constexpr char MAGIC[8] = {'B', 'T', 'R', 'E', 'E', 'I', 'M', 'G'};
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    /* How m keys fill a level: in as few nodes as hold them, each but the
+       last followed by a separator for the level above, and the rest
+       evened out between them */
+    struct Level {
+        size_t nodes, base, extra;
+
+        explicit Level(size_t m) : nodes(m ? (m + 2 * B) / (2 * B) : 0) {
+            size_t keys = nodes ? m - (nodes - 1) : 0;
+            base = nodes ? keys / nodes : 0;
+            extra = nodes ? keys % nodes : 0;
+        }
+
+        size_t keys(size_t j) const { return base + (j < extra); }
+    };
+
+    static size_t page_align(size_t bytes) { return (bytes + page_size - 1) / page_size * page_size; }
+
+    void check(const MappedBTreeHeader&, size_t file_size, const std::string& path) const;
+
+    const char* base = nullptr;
+    size_t length = 0;
+
+    const Internal* internals = nullptr;
+    const Leaf* leaves = nullptr;
+    size_t levels = 0;
+    size_t count = 0;
+};
+
+template<typename T, size_t B>
+class MappedBTree<T, B>::iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    iterator() = default;
+
+    reference operator*() const {
+        const Frame& f = path[depth - 1];
+        if (depth == tree->levels)
+            return tree->leaves[f.node].keys[f.idx];
+        return tree->internals[f.node].keys[f.idx];
+    }
+
+    pointer operator->() const { return &**this; }
+
+    iterator& operator++();
+
+    iterator operator++(int) {
+        iterator prev = *this;
+        ++*this;
+        return prev;
+    }
+
+    bool operator==(const iterator& o) const {
+        if (depth == 0 || o.depth == 0)
+            return depth == o.depth;
+
+        return depth == o.depth && path[depth - 1].node == o.path[depth - 1].node
+            && path[depth - 1].idx == o.path[depth - 1].idx;
+    }
+
+    bool operator!=(const iterator& o) const { return !(*this == o); }
+
+private:
+    friend class MappedBTree;
+
+    /* Node numbers are 32 bits and every node has at least two edges */
+    static constexpr size_t max_depth = 34;
+
+    /* The node, and the edge taken from it, which is also the key that
+       comes once the subtree under it is done */
+    struct Frame {
+        uint32_t node;
+        uint32_t idx;
+    };
+
+    explicit iterator(const MappedBTree* tree) : tree(tree) {}
+
+    void push(size_t node, size_t idx) { path[depth++] = Frame{uint32_t(node), uint32_t(idx)}; }
+    void descend_leftmost(uint32_t node);
+    void climb();
+
+    const MappedBTree* tree = nullptr;
+    std::array<Frame, max_depth> path;
+    size_t depth = 0;
+};
+
+template<typename T, size_t B>
+MappedBTree<T, B>::MappedBTree(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int e = errno;
+        ::close(fd);
+        throw std::system_error(e, std::generic_category(), "stat " + path);
+    }
+
+    length = st.st_size;
+    if (length < sizeof(MappedBTreeHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + ": truncated image");
+    }
+
+    /* The mapping keeps the file open */
+    void* p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    int e = errno;
+    ::close(fd);
+
+    if (p == MAP_FAILED)
+        throw std::system_error(e, std::generic_category(), "mmap " + path);
+
+    base = static_cast<const char*>(p);
+
+    const auto& header = *reinterpret_cast<const MappedBTreeHeader*>(base);
+    try {
+        check(header, length, path);
+    } catch (...) {
+        ::munmap(p, length);
+        throw;
+    }
+
+    internals = reinterpret_cast<const Internal*>(base + header.internal_offset);
+    leaves = reinterpret_cast<const Leaf*>(base + header.leaf_offset);
+    levels = header.height;
+    count = header.size;
+
+    /* Every lookup goes through the internal nodes; read them in ahead */
+    if (header.internals)
+        ::madvise(p, header.leaf_offset, MADV_WILLNEED);
+}
+
+template<typename T, size_t B>
+MappedBTree<T, B>::MappedBTree(MappedBTree&& o) noexcept
+    : base(std::exchange(o.base, nullptr)), length(std::exchange(o.length, 0)),
+      internals(o.internals), leaves(o.leaves), levels(std::exchange(o.levels, 0)),
+      count(std::exchange(o.count, 0)) {}
+
+template<typename T, size_t B>
+MappedBTree<T, B>& MappedBTree<T, B>::operator=(MappedBTree&& o) noexcept {
+    std::swap(base, o.base);
+    std::swap(length, o.length);
+    std::swap(internals, o.internals);
+    std::swap(leaves, o.leaves);
+    std::swap(levels, o.levels);
+    std::swap(count, o.count);
+
+    return *this;
+}
+
+template<typename T, size_t B>
+MappedBTree<T, B>::~MappedBTree() {
+    if (base)
+        ::munmap(const_cast<char*>(base), length);
+}
+
+template<typename T, size_t B>
+void MappedBTree<T, B>::check(const MappedBTreeHeader& header, size_t file_size,
+                              const std::string& path) const {
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error(path + ": not a BTree image");
+    if (header.version != version || header.byte_order != BYTE_ORDER_MARK)
+        throw std::runtime_error(path + ": image of another version or byte order");
+    if (header.key_size != sizeof(T) || header.fanout != B
+        || header.internal_size != sizeof(Internal) || header.leaf_size != sizeof(Leaf))
+        throw std::runtime_error(path + ": not an image of this key type and B");
+
+    if (header.file_size != file_size
+        || header.internal_offset + header.internals * sizeof(Internal) > header.leaf_offset
+        || header.leaf_offset + header.leaves * sizeof(Leaf) > file_size
+        || header.internal_offset % alignof(Internal) || header.leaf_offset % alignof(Leaf)
+        || (header.height == 0) != (header.leaves == 0))
+        throw std::runtime_error(path + ": corrupt image");
+}
+
+/**
+ * The leaves go first, straight to their place in the file, since how many
+ * nodes every level gets follows from the number of keys alone. The
+ * separators between them make the level above, and so on up to the root;
+ * those are a small fraction of the keys, and are written after, together
+ * with the header. The file is written under a temporary name, synced and
+ * renamed into place.
+ */
+template<typename T, size_t B>
+template<typename ForwardIt>
+void MappedBTree<T, B>::write(const std::string& path, ForwardIt first, ForwardIt last) {
+    size_t n = std::distance(first, last);
+
+    /* The number of nodes on every level, leaves first */
+    std::vector<Level> shape;
+    for (size_t m = n; m > 0 || shape.empty(); m = shape.back().nodes - 1) {
+        shape.push_back(Level(m));
+        if (shape.back().nodes <= 1)
+            break;
+    }
+
+    size_t num_internals = 0;
+    for (size_t l = 1; l < shape.size(); l++)
+        num_internals += shape[l].nodes;
+
+    if (shape[0].nodes > UINT32_MAX || num_internals > UINT32_MAX)
+        throw std::runtime_error(path + ": too many nodes for an image");
+
+    MappedBTreeHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = version;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.key_size = sizeof(T);
+    header.fanout = B;
+    header.internal_size = sizeof(Internal);
+    header.leaf_size = sizeof(Leaf);
+    header.height = n ? shape.size() : 0;
+    header.size = n;
+    header.internals = num_internals;
+    header.leaves = shape[0].nodes;
+    header.internal_offset = page_size;
+    header.leaf_offset = page_align(page_size + num_internals * sizeof(Internal));
+    header.file_size = header.leaf_offset + header.leaves * sizeof(Leaf);
+
+    auto tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + tmp);
+
+    try {
+        std::vector<char> out;
+        out.reserve(1 << 20);
+
+        auto flush = [&] {
+            btree_detail::write_all(fd, out.data(), out.size());
+            out.clear();
+        };
+
+        auto append = [&](const auto& node) {
+            const char* p = reinterpret_cast<const char*>(&node);
+            out.insert(out.end(), p, p + sizeof(node));
+            if (out.size() >= (1 << 20))
+                flush();
+        };
+
+        /* The leaves, and the separators between them */
+        if (::lseek(fd, header.leaf_offset, SEEK_SET) < 0)
+            throw std::system_error(errno, std::generic_category(), "lseek " + tmp);
+
+        std::vector<T> seps;
+        Leaf leaf;
+        std::memset(&leaf, 0, sizeof(leaf));
+
+        for (size_t j = 0; j < header.leaves; j++) {
+            leaf.n = shape[0].keys(j);
+            for (size_t i = 0; i < leaf.n; i++, ++first)
+                leaf.keys[i] = *first;
+            append(leaf);
+
+            if (j + 1 < header.leaves)
+                seps.push_back(*first++);
+        }
+        flush();
+
+        /* The internal levels, bottom-up; each is numbered after the ones
+           above it, and its edges lead into the level below */
+        std::vector<std::vector<Internal>> internal_levels;
+        size_t below = num_internals;
+
+        for (size_t l = 1; l < shape.size(); l++) {
+            std::vector<T> items = std::move(seps);
+            std::vector<Internal> level(shape[l].nodes);
+            size_t first_edge = l == 1 ? 0 : below;
+            below -= shape[l].nodes;
+
+            seps.clear();
+            for (size_t j = 0, item = 0; j < level.size(); j++) {
+                Internal& node = level[j];
+                std::memset(&node, 0, sizeof(node));
+                node.n = shape[l].keys(j);
+
+                for (size_t i = 0; i < node.n; i++)
+                    node.keys[i] = items[item++];
+                for (size_t i = 0; i <= node.n; i++)
+                    node.edges[i] = first_edge++;
+
+                if (j + 1 < level.size())
+                    seps.push_back(items[item++]);
+            }
+
+            internal_levels.push_back(std::move(level));
+        }
+
+        if (::lseek(fd, 0, SEEK_SET) < 0)
+            throw std::system_error(errno, std::generic_category(), "lseek " + tmp);
+
+        out.resize(page_size);
+        std::memcpy(out.data(), &header, sizeof(header));
+        for (auto level = internal_levels.rbegin(); level != internal_levels.rend(); ++level)
+            for (const Internal& node : *level)
+                append(node);
+        flush();
+
+        /* The gap up to the leaves is a hole; make sure the file ends after
+           them even when there are none */
+        if (::ftruncate(fd, header.file_size) < 0)
+            throw std::system_error(errno, std::generic_category(), "ftruncate " + tmp);
+
+        btree_detail::sync_fd(fd);
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    std::filesystem::rename(tmp, path);
+}
+
+template<typename T, size_t B>
+bool MappedBTree<T, B>::contains(const T& t) const {
+    if (levels == 0)
+        return false;
+
+    size_t node = 0;
+    for (size_t level = 1; level < levels; level++) {
+        const Internal& in = internals[node];
+        size_t idx = Search::index(in.keys.data(), in.n, t);
+
+        if (idx < in.n && in.keys[idx] == t)
+            return true;
+        node = in.edges[idx];
+    }
+
+    const Leaf& leaf = leaves[node];
+    size_t idx = Search::index(leaf.keys.data(), leaf.n, t);
+
+    return idx < leaf.n && leaf.keys[idx] == t;
+}
+
+template<typename T, size_t B>
+typename MappedBTree<T, B>::iterator MappedBTree<T, B>::begin() const {
+    iterator it(this);
+    if (levels)
+        it.descend_leftmost(0);
+
+    return it;
+}
+
+template<typename T, size_t B>
+typename MappedBTree<T, B>::iterator MappedBTree<T, B>::end() const {
+    return iterator(this);
+}
+
+/* Always down the edge of the first key not less than t; with duplicates,
+   some of those may be under it */
+template<typename T, size_t B>
+typename MappedBTree<T, B>::iterator MappedBTree<T, B>::lower_bound(const T& t) const {
+    iterator it(this);
+    if (levels == 0)
+        return it;
+
+    size_t node = 0;
+    for (size_t level = 1; level < levels; level++) {
+        const Internal& in = internals[node];
+        size_t idx = Search::index(in.keys.data(), in.n, t);
+
+        it.push(node, idx);
+        node = in.edges[idx];
+    }
+
+    const Leaf& leaf = leaves[node];
+    size_t idx = Search::index(leaf.keys.data(), leaf.n, t);
+    it.push(node, idx);
+
+    if (idx == leaf.n) {
+        it.depth--;
+        it.climb();
+    }
+
+    return it;
+}
+
+template<typename T, size_t B>
+typename MappedBTree<T, B>::iterator MappedBTree<T, B>::find(const T& t) const {
+    auto it = lower_bound(t);
+    if (it != end() && *it == t)
+        return it;
+
+    return end();
+}
+
+template<typename T, size_t B>
+void MappedBTree<T, B>::iterator::descend_leftmost(uint32_t node) {
+    while (depth + 1 < tree->levels) {
+        push(node, 0);
+        node = tree->internals[node].edges[0];
+    }
+
+    push(node, 0);
+}
+
+/* Up to the first node on the path with a key left to visit */
+template<typename T, size_t B>
+void MappedBTree<T, B>::iterator::climb() {
+    while (depth > 0 && path[depth - 1].idx == tree->internals[path[depth - 1].node].n)
+        depth--;
+}
+
+template<typename T, size_t B>
+typename MappedBTree<T, B>::iterator& MappedBTree<T, B>::iterator::operator++() {
+    Frame& f = path[depth - 1];
+
+    if (depth < tree->levels) {
+        f.idx++;
+        descend_leftmost(tree->internals[f.node].edges[f.idx]);
+        return *this;
+    }
+
+    if (++f.idx < tree->leaves[f.node].n)
+        return *this;
+
+    depth--;
+    climb();
+    return *this;
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * In-node search policies.
+ *
+ * Every policy provides `index(keys, n, t)`, which returns the number of keys
+ * in keys[0..n) that are strictly less than `t`. Since the keys of a node are
+ * sorted, this is exactly the value `BTreeNode::get_index` is supposed to
+ * return. `compared<T>(n, idx)` is the number of keys `index` compared `t`
+ * with to get there, for BTreeStats.
+ */
+
+/* The original scan. Cheapest when a node holds only a handful of keys. */
+struct LinearSearch {
+    template<typename T>
+    static size_t index(const T* keys, size_t n, const T& t) {
+        size_t idx = 0;
+        while (idx < n && keys[idx] < t) idx++;
+
+        return idx;
+    }
+
+    template<typename T>
+    static size_t compared(size_t n, size_t idx) {
+        return idx < n ? idx + 1 : n;
+    }
+};
+
+/* Branchless lower bound. The loop runs exactly ceil(log2(n)) times and the
+   comparison result only selects an offset, so there is nothing for the
+   branch predictor to miss. */
+struct BinarySearch {
+    template<typename T>
+    static size_t index(const T* keys, size_t n, const T& t) {
+        if (n == 0)
+            return 0;
+
+        const T* base = keys;
+        while (n > 1) {
+            size_t half = n / 2;
+            base = (base[half] < t) ? base + half : base;
+            n -= half;
+        }
+
+        return (base - keys) + (*base < t);
+    }
+
+    template<typename T>
+    static size_t compared(size_t n, size_t) {
+        size_t c = n > 0;
+        for (; n > 1; n -= n / 2)
+            c++;
+
+        return c;
+    }
+};
+
+namespace btree_detail {
+
+template<typename T>
+inline constexpr bool is_simd_key_v =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+    (sizeof(T) == 4 || sizeof(T) == 8 ||
+     (std::is_integral_v<T> && (sizeof(T) == 1 || sizeof(T) == 2)));
+
+#if defined(__SSE2__)
+
+/* Signed integer comparisons are the only ones SSE/AVX offer, so unsigned
+   keys are biased by flipping the sign bit first. */
+template<typename T>
+inline constexpr bool needs_bias_v = std::is_unsigned_v<T>;
+
+template<typename T>
+inline size_t count_less_scalar(const T* keys, size_t from, size_t n, const T& t) {
+    size_t cnt = 0;
+    for (size_t i = from; i < n; i++)
+        cnt += keys[i] < t;
+
+    return cnt;
+}
+
+/* 8- and 16-bit lanes are integers only. movemask_epi8 yields one bit per
+   byte, so a 16-bit lane that compares less counts twice. */
+template<typename T>
+inline size_t count_less_16(const T* keys, size_t n, const T& t) {
+    size_t bits = 0, i = 0;
+    const int16_t bias = needs_bias_v<T> ? INT16_MIN : 0;
+    const int16_t tb = static_cast<int16_t>(t) ^ bias;
+
+#if defined(__AVX2__)
+    const __m256i tv = _mm256_set1_epi16(tb);
+    const __m256i bv = _mm256_set1_epi16(bias);
+    for (; i + 16 <= n; i += 16) {
+        __m256i k = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bv);
+        bits += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi16(tv, k)));
+    }
+#endif
+    const __m128i tv8 = _mm_set1_epi16(tb);
+    const __m128i bv8 = _mm_set1_epi16(bias);
+    for (; i + 8 <= n; i += 8) {
+        __m128i k = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bv8);
+        bits += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi16(tv8, k)));
+    }
+
+    return bits / 2 + count_less_scalar(keys, i, n, t);
+}
+
+template<typename T>
+inline size_t count_less_8(const T* keys, size_t n, const T& t) {
+    size_t cnt = 0, i = 0;
+    const int8_t bias = needs_bias_v<T> ? INT8_MIN : 0;
+    const int8_t tb = static_cast<int8_t>(t) ^ bias;
+
+#if defined(__AVX2__)
+    const __m256i tv = _mm256_set1_epi8(tb);
+    const __m256i bv = _mm256_set1_epi8(bias);
+    for (; i + 32 <= n; i += 32) {
+        __m256i k = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bv);
+        cnt += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi8(tv, k)));
+    }
+#endif
+    const __m128i tv16 = _mm_set1_epi8(tb);
+    const __m128i bv16 = _mm_set1_epi8(bias);
+    for (; i + 16 <= n; i += 16) {
+        __m128i k = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bv16);
+        cnt += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(tv16, k)));
+    }
+
+    return cnt + count_less_scalar(keys, i, n, t);
+}
+
+template<typename T>
+inline size_t count_less_32(const T* keys, size_t n, const T& t) {
+    size_t cnt = 0, i = 0;
+
+    if constexpr (std::is_floating_point_v<T>) {
+#if defined(__AVX2__)
+        const __m256 tv = _mm256_set1_ps(t);
+        for (; i + 8 <= n; i += 8) {
+            __m256 k = _mm256_loadu_ps(keys + i);
+            cnt += __builtin_popcount(
+                _mm256_movemask_ps(_mm256_cmp_ps(k, tv, _CMP_LT_OQ)));
+        }
+#endif
+        const __m128 tv4 = _mm_set1_ps(t);
+        for (; i + 4 <= n; i += 4) {
+            __m128 k = _mm_loadu_ps(keys + i);
+            cnt += __builtin_popcount(_mm_movemask_ps(_mm_cmplt_ps(k, tv4)));
+        }
+    } else {
+        const int32_t bias = needs_bias_v<T> ? INT32_MIN : 0;
+        int32_t tb;
+        std::memcpy(&tb, &t, sizeof(tb));
+        tb ^= bias;
+#if defined(__AVX2__)
+        const __m256i tv = _mm256_set1_epi32(tb);
+        const __m256i bv = _mm256_set1_epi32(bias);
+        for (; i + 8 <= n; i += 8) {
+            __m256i k = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bv);
+            cnt += __builtin_popcount(_mm256_movemask_ps(
+                _mm256_castsi256_ps(_mm256_cmpgt_epi32(tv, k))));
+        }
+#endif
+        const __m128i tv4 = _mm_set1_epi32(tb);
+        const __m128i bv4 = _mm_set1_epi32(bias);
+        for (; i + 4 <= n; i += 4) {
+            __m128i k = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bv4);
+            cnt += __builtin_popcount(
+                _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(tv4, k))));
+        }
+    }
+
+    return cnt + count_less_scalar(keys, i, n, t);
+}
+
+template<typename T>
+inline size_t count_less_64(const T* keys, size_t n, const T& t) {
+    size_t cnt = 0, i = 0;
+
+    if constexpr (std::is_floating_point_v<T>) {
+#if defined(__AVX2__)
+        const __m256d tv = _mm256_set1_pd(t);
+        for (; i + 4 <= n; i += 4) {
+            __m256d k = _mm256_loadu_pd(keys + i);
+            cnt += __builtin_popcount(
+                _mm256_movemask_pd(_mm256_cmp_pd(k, tv, _CMP_LT_OQ)));
+        }
+#endif
+        const __m128d tv2 = _mm_set1_pd(t);
+        for (; i + 2 <= n; i += 2) {
+            __m128d k = _mm_loadu_pd(keys + i);
+            cnt += __builtin_popcount(_mm_movemask_pd(_mm_cmplt_pd(k, tv2)));
+        }
+    } else {
+#if defined(__SSE4_2__)
+        const int64_t bias = needs_bias_v<T> ? INT64_MIN : 0;
+        int64_t tb;
+        std::memcpy(&tb, &t, sizeof(tb));
+        tb ^= bias;
+#if defined(__AVX2__)
+        const __m256i tv = _mm256_set1_epi64x(tb);
+        const __m256i bv = _mm256_set1_epi64x(bias);
+        for (; i + 4 <= n; i += 4) {
+            __m256i k = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bv);
+            cnt += __builtin_popcount(_mm256_movemask_pd(
+                _mm256_castsi256_pd(_mm256_cmpgt_epi64(tv, k))));
+        }
+#endif
+        const __m128i tv2 = _mm_set1_epi64x(tb);
+        const __m128i bv2 = _mm_set1_epi64x(bias);
+        for (; i + 2 <= n; i += 2) {
+            __m128i k = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bv2);
+            cnt += __builtin_popcount(
+                _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(tv2, k))));
+        }
+#endif
+    }
+
+    return cnt + count_less_scalar(keys, i, n, t);
+}
+
+#endif /* __SSE2__ */
+
+} // namespace btree_detail
+
+/* Narrow the range with the branchless halving of BinarySearch until it fits
+   in a cache line, then compare `t` against whole vectors of keys at once
+   and count the lanes where the key is smaller (compare + movemask +
+   popcount). 32/64-bit arithmetic keys and 8/16-bit integers are
+   vectorised; 64-bit integers need SSE4.2. Anything else falls back to the
+   linear scan. */
+struct SimdSearch {
+#if defined(__SSE4_2__)
+    template<typename T>
+    static constexpr bool supports = btree_detail::is_simd_key_v<T>;
+#elif defined(__SSE2__)
+    template<typename T>
+    static constexpr bool supports = btree_detail::is_simd_key_v<T> &&
+        (sizeof(T) < 8 || std::is_floating_point_v<T>);
+#else
+    template<typename T>
+    static constexpr bool supports = false;
+#endif
+
+    template<typename T>
+    static size_t index(const T* keys, size_t n, const T& t) {
+#if defined(__SSE2__)
+        if constexpr (supports<T>) {
+            constexpr size_t window = 32 / sizeof(T);
+
+            const T* base = keys;
+            while (n > window) {
+                size_t half = n / 2;
+                base = (base[half] < t) ? base + half : base;
+                n -= half;
+            }
+
+            if constexpr (sizeof(T) == 1)
+                return (base - keys) + btree_detail::count_less_8(base, n, t);
+            else if constexpr (sizeof(T) == 2)
+                return (base - keys) + btree_detail::count_less_16(base, n, t);
+            else if constexpr (sizeof(T) == 4)
+                return (base - keys) + btree_detail::count_less_32(base, n, t);
+            else
+                return (base - keys) + btree_detail::count_less_64(base, n, t);
+        }
+#endif
+        return LinearSearch::index(keys, n, t);
+    }
+
+    /* A key of the final window counts whether it was compared alone or in
+       a vector with the others */
+    template<typename T>
+    static size_t compared(size_t n, size_t idx) {
+        if constexpr (supports<T>) {
+            constexpr size_t window = 32 / sizeof(T);
+
+            size_t c = 0;
+            for (; n > window; n -= n / 2)
+                c++;
+
+            return c + n;
+        }
+
+        return LinearSearch::compared<T>(n, idx);
+    }
+};
+
+/**
+ * Compile-time choice of the in-node search for BTreeNode<T, B>.
+ *
+ * A node holds up to 2B-1 keys. Following bench/search_bench.cpp:
+ *  - up to 8 keys the plain scan wins, whatever the key type;
+ *  - floating-point keys are cheaper to compare a vector at a time;
+ *  - everything else (integers included) uses the branchless binary search,
+ *    whose cmov chain beat the vector count for integer keys.
+ *
+ * Specialise this template to force a policy for a particular key type.
+ */
+template<typename T, size_t B>
+struct btree_search_policy {
+    static constexpr size_t max_keys = 2 * B - 1;
+
+    using type = std::conditional_t<
+        (max_keys <= 8), LinearSearch,
+        std::conditional_t<SimdSearch::supports<T> && std::is_floating_point_v<T>,
+                           SimdSearch, BinarySearch>>;
+};
+
+template<typename T, size_t B>
+using btree_search_policy_t = typename btree_search_policy<T, B>::type;
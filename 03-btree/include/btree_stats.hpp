@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * What a BTree with stats (see BTreeTraits) has done to its nodes.
+ *
+ * Searches count the nodes they look into and the keys they compare there,
+ * as far as the in-node search policy says it looked (see
+ * btree_search.hpp). Structural changes are counted where they happen, so
+ * that a workload that keeps splitting and merging the same nodes shows up
+ * as such. `root_grows` and `root_shrinks` count levels, not operations.
+ *
+ * The counters only go up. Take the difference of two readings, or call
+ * BTree::reset_stats at the end of every interval, to get rates.
+ */
+struct BTreeStats {
+    uint64_t nodes_visited = 0;
+    uint64_t keys_compared = 0;
+    uint64_t splits = 0;
+    uint64_t merges = 0;
+    uint64_t borrows_left = 0;
+    uint64_t borrows_right = 0;
+    uint64_t root_grows = 0;
+    uint64_t root_shrinks = 0;
+    uint64_t nodes_allocated = 0;
+    uint64_t nodes_freed = 0;
+
+    /* The hook for exporting: calls `f(name, value)` for every counter, in
+       the order above, with the names of the fields. */
+    template<typename F>
+    void for_each(F&& f) const {
+        f("nodes_visited", nodes_visited);
+        f("keys_compared", keys_compared);
+        f("splits", splits);
+        f("merges", merges);
+        f("borrows_left", borrows_left);
+        f("borrows_right", borrows_right);
+        f("root_grows", root_grows);
+        f("root_shrinks", root_shrinks);
+        f("nodes_allocated", nodes_allocated);
+        f("nodes_freed", nodes_freed);
+    }
+
+    BTreeStats& operator+=(const BTreeStats& other) {
+        nodes_visited += other.nodes_visited;
+        keys_compared += other.keys_compared;
+        splits += other.splits;
+        merges += other.merges;
+        borrows_left += other.borrows_left;
+        borrows_right += other.borrows_right;
+        root_grows += other.root_grows;
+        root_shrinks += other.root_shrinks;
+        nodes_allocated += other.nodes_allocated;
+        nodes_freed += other.nodes_freed;
+
+        return *this;
+    }
+};
+
+namespace btree_detail {
+
+/* The counters of a BTreeNodePool, as a base so that a pool without them
+   does not grow */
+template<bool Enabled>
+struct PoolStats {};
+
+template<>
+struct PoolStats<true> {
+    mutable BTreeStats stats;
+};
+
+} // namespace btree_detail
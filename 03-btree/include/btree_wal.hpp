@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "btree.hpp"
+
+/**
+ * Durability for BTree: a write-ahead log of mutations plus checkpoints.
+ *
+ * A DurableBTree lives in a directory holding two files:
+ *
+ *  - `checkpoint`: a snapshot of the keys in order, and the sequence number
+ *    (LSN) of the last logged operation it contains. It is written to a
+ *    temporary file and renamed over the old one, so it is always complete.
+ *  - `wal`: the operations logged since. Operations are appended in groups;
+ *    each group carries the LSN of its first record and a checksum, so a
+ *    group torn by a crash is detected and dropped, along with anything
+ *    after it.
+ *
+ * Opening the directory loads the checkpoint with bulk_load and replays the
+ * groups of the log whose records are newer than it.
+ *
+ * Group commit: operations are buffered and appended with one write once
+ * `group_size` of them are pending, and the log is fsynced once every
+ * `sync_every` appends (0: only on `commit`). `commit` appends
+ * and fsyncs whatever is pending. Only committed operations survive a crash.
+ *
+ * Keys are logged as raw bytes, so they must be trivially copyable.
+ */
+
+struct WalOptions {
+    /* Operations buffered before they are appended to the log */
+    size_t group_size = 256;
+
+    /* Appends between two fsyncs of the log; 0 only fsyncs on commit */
+    size_t sync_every = 1;
+
+    /* Logged operations after which a checkpoint is taken; 0 never does */
+    size_t checkpoint_every = 0;
+};
+
+namespace btree_detail {
+
+/* FNV-1a */
+inline uint32_t checksum(const char* p, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+inline std::vector<char> read_file(const std::filesystem::path& path) {
+    std::vector<char> buf;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return buf;
+        throw std::system_error(errno, std::generic_category(), "open " + path.string());
+    }
+
+    char chunk[1 << 16];
+    while (true) {
+        ssize_t r = ::read(fd, chunk, sizeof(chunk));
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            int e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "read " + path.string());
+        }
+        if (r == 0)
+            break;
+        buf.insert(buf.end(), chunk, chunk + r);
+    }
+
+    ::close(fd);
+    return buf;
+}
+
+} // namespace btree_detail
+
+template<typename T, size_t B = 6>
+class DurableBTree {
+    static_assert(std::is_trivially_copyable_v<T>, "keys are logged as raw bytes");
+
+public:
+    /* Open the tree stored in `dir`, or start an empty one there */
+    explicit DurableBTree(const std::filesystem::path& dir, WalOptions = WalOptions());
+    DurableBTree(const DurableBTree&) = delete;
+    DurableBTree& operator=(const DurableBTree&) = delete;
+    ~DurableBTree();
+
+    bool insert(const T&);
+    bool remove(const T&);
+    bool contains(const T& t) const { return tree.contains(t); }
+
+    void for_all(std::function<void(const T&)> func) {
+        tree.for_all([&func](T& t) { func(t); });
+    }
+
+    /* Append and fsync every pending operation */
+    void commit();
+
+    /* Write a snapshot of the tree and start a new log */
+    void checkpoint();
+
+    /* Read-only access to the in-memory tree */
+    const BTree<T, B>& get() const { return tree; }
+
+    uint64_t lsn() const { return next_lsn - 1; }
+
+private:
+    enum class Op : uint8_t { INSERT = 1, REMOVE = 2 };
+
+    struct GroupHeader {
+        uint64_t first_lsn;
+        uint32_t count;
+        uint32_t checksum;
+    };
+
+    struct CheckpointHeader {
+        char magic[8];
+        uint64_t key_size;
+        uint64_t lsn;
+        uint64_t count;
+        uint32_t checksum;
+        uint32_t pad;
+    };
+
+    static constexpr size_t RECORD = 1 + sizeof(T);
+    static constexpr char MAGIC[8] = {'B', 'T', 'R', 'E', 'E', 'C', 'K', '1'};
+
+    void log(Op, const T&);
+    void append();
+    void load_checkpoint();
+    void replay();
+    void open_log();
+    void sync_dir();
+
+    std::filesystem::path dir;
+    WalOptions options;
+    BTree<T, B> tree;
+
+    int log_fd = -1;
+    std::vector<char> pending;
+    size_t pending_count = 0;
+    uint64_t pending_lsn = 1;
+    size_t appends_since_sync = 0;
+
+    uint64_t next_lsn = 1;
+    uint64_t checkpoint_lsn = 0;
+};
+
+template<typename T, size_t B>
+DurableBTree<T, B>::DurableBTree(const std::filesystem::path& dir, WalOptions options)
+    : dir(dir), options(options) {
+    std::filesystem::create_directories(dir);
+
+    load_checkpoint();
+    replay();
+    open_log();
+}
+
+template<typename T, size_t B>
+DurableBTree<T, B>::~DurableBTree() {
+    try {
+        commit();
+    } catch (...) {
+        /* Nothing sensible to do from a destructor */
+    }
+
+    if (log_fd >= 0)
+        ::close(log_fd);
+}
+
+/* The tree is updated first, so that a checkpoint taken while logging
+   already contains the operation. */
+template<typename T, size_t B>
+bool DurableBTree<T, B>::insert(const T& t) {
+    tree.insert(t);
+    log(Op::INSERT, t);
+    return true;
+}
+
+/* Removing a missing key changes nothing, so it is not logged */
+template<typename T, size_t B>
+bool DurableBTree<T, B>::remove(const T& t) {
+    if (!tree.remove(t))
+        return false;
+
+    log(Op::REMOVE, t);
+    return true;
+}
+
+template<typename T, size_t B>
+void DurableBTree<T, B>::log(Op op, const T& t) {
+    if (pending_count == 0) {
+        pending_lsn = next_lsn;
+        pending.resize(sizeof(GroupHeader));
+    }
+
+    pending.push_back(static_cast<char>(op));
+    const char* bytes = reinterpret_cast<const char*>(&t);
+    pending.insert(pending.end(), bytes, bytes + sizeof(T));
+
+    pending_count++;
+    next_lsn++;
+
+    if (pending_count >= options.group_size)
+        append();
+
+    if (options.checkpoint_every && next_lsn - 1 - checkpoint_lsn >= options.checkpoint_every)
+        checkpoint();
+}
+
+template<typename T, size_t B>
+void DurableBTree<T, B>::append() {
+    if (pending_count == 0)
+        return;
+
+    GroupHeader header;
+    header.first_lsn = pending_lsn;
+    header.count = static_cast<uint32_t>(pending_count);
+    header.checksum = btree_detail::checksum(pending.data() + sizeof(header),
+                                             pending.size() - sizeof(header));
+    std::memcpy(pending.data(), &header, sizeof(header));
+
+    btree_detail::write_all(log_fd, pending.data(), pending.size());
+
+    pending.clear();
+    pending_count = 0;
+
+    if (options.sync_every && ++appends_since_sync >= options.sync_every) {
+        btree_detail::sync_fd(log_fd);
+        appends_since_sync = 0;
+    }
+}
+
+template<typename T, size_t B>
+void DurableBTree<T, B>::commit() {
+    append();
+
+    btree_detail::sync_fd(log_fd);
+    appends_since_sync = 0;
+}
+
+/* The log is only truncated once the new checkpoint is in place; a crash in
+   between leaves records the checkpoint already has, which replay skips by
+   their LSN. */
+template<typename T, size_t B>
+void DurableBTree<T, B>::checkpoint() {
+    append();
+
+    std::vector<T> keys;
+    tree.for_all([&keys](T& t) { keys.push_back(t); });
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.key_size = sizeof(T);
+    header.lsn = next_lsn - 1;
+    header.count = keys.size();
+    header.checksum = btree_detail::checksum(reinterpret_cast<const char*>(keys.data()),
+                                             keys.size() * sizeof(T));
+
+    auto tmp = dir / "checkpoint.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + tmp.string());
+
+    try {
+        btree_detail::write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+        btree_detail::write_all(fd, reinterpret_cast<const char*>(keys.data()),
+                                keys.size() * sizeof(T));
+        btree_detail::sync_fd(fd);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    std::filesystem::rename(tmp, dir / "checkpoint");
+    sync_dir();
+
+    checkpoint_lsn = header.lsn;
+
+    if (::ftruncate(log_fd, 0) < 0)
+        throw std::system_error(errno, std::generic_category(), "ftruncate");
+    btree_detail::sync_fd(log_fd);
+    appends_since_sync = 0;
+}
+
+template<typename T, size_t B>
+void DurableBTree<T, B>::load_checkpoint() {
+    auto buf = btree_detail::read_file(dir / "checkpoint");
+    if (buf.empty())
+        return;
+
+    CheckpointHeader header;
+    if (buf.size() < sizeof(header))
+        throw std::runtime_error(dir.string() + ": truncated checkpoint");
+    std::memcpy(&header, buf.data(), sizeof(header));
+
+    const char* payload = buf.data() + sizeof(header);
+    size_t len = buf.size() - sizeof(header);
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.key_size != sizeof(T))
+        throw std::runtime_error(dir.string() + ": not a checkpoint of this key type");
+    if (len != header.count * sizeof(T) || btree_detail::checksum(payload, len) != header.checksum)
+        throw std::runtime_error(dir.string() + ": corrupt checkpoint");
+
+    std::vector<T> keys(header.count);
+    std::memcpy(keys.data(), payload, len);
+    tree.bulk_load(keys.begin(), keys.end());
+
+    checkpoint_lsn = header.lsn;
+    next_lsn = header.lsn + 1;
+}
+
+/* Replay every complete group; the first torn or corrupt one ends the log */
+template<typename T, size_t B>
+void DurableBTree<T, B>::replay() {
+    auto buf = btree_detail::read_file(dir / "wal");
+    size_t pos = 0;
+
+    while (pos + sizeof(GroupHeader) <= buf.size()) {
+        GroupHeader header;
+        std::memcpy(&header, buf.data() + pos, sizeof(header));
+
+        size_t len = header.count * RECORD;
+        const char* p = buf.data() + pos + sizeof(header);
+
+        if (header.count == 0 || pos + sizeof(header) + len > buf.size() ||
+            btree_detail::checksum(p, len) != header.checksum)
+            break;
+
+        for (uint64_t lsn = header.first_lsn; lsn < header.first_lsn + header.count;
+             lsn++, p += RECORD) {
+            if (lsn <= checkpoint_lsn)
+                continue;
+
+            T t;
+            std::memcpy(&t, p + 1, sizeof(T));
+
+            if (static_cast<Op>(p[0]) == Op::INSERT)
+                tree.insert(t);
+            else
+                tree.remove(t);
+
+            next_lsn = lsn + 1;
+        }
+
+        pos += sizeof(header) + len;
+    }
+
+    /* Drop the torn tail, so that new groups follow the last good one */
+    if (pos < buf.size())
+        std::filesystem::resize_file(dir / "wal", pos);
+}
+
+template<typename T, size_t B>
+void DurableBTree<T, B>::open_log() {
+    auto path = dir / "wal";
+
+    log_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path.string());
+}
+
+/* Make the rename of the checkpoint itself durable */
+template<typename T, size_t B>
+void DurableBTree<T, B>::sync_dir() {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + dir.string());
+
+    int r = ::fsync(fd);
+    int e = errno;
+    ::close(fd);
+
+    if (r < 0)
+        throw std::system_error(e, std::generic_category(), "fsync " + dir.string());
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * A bounded set of in-memory frames caching fixed-size pages of a file.
+ *
+ * Pages are brought in with pread when they are not resident (a page
+ * fault), and pinned while a PageRef to them is alive. When every frame is
+ * taken, the clock hand sweeps over the unpinned frames, giving each
+ * recently used one a second chance, and evicts the first one that was not;
+ * if it is dirty, it is written back with pwrite first.
+ *
+ * The pool never closes the file, and its destructor does not write
+ * anything back: call `flush` first.
+ *
+ * Not thread-safe.
+ */
+class BufferPool {
+public:
+    static constexpr size_t page_size = 4096;
+    using page_id = uint64_t;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t faults = 0;
+        size_t writebacks = 0;
+        size_t evictions = 0;
+    };
+
+    class PageRef;
+
+    BufferPool(int fd, size_t num_frames);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool() { std::free(data); }
+
+    /* Pin the page, reading it from the file if it is not resident */
+    PageRef fetch(page_id);
+
+    /* Pin a page whose old contents do not matter; it starts zeroed and dirty */
+    PageRef create(page_id);
+
+    /* Write every dirty page back */
+    void flush();
+
+    const Stats& stats() const { return counters; }
+    void reset_stats() { counters = Stats{}; }
+
+    size_t num_frames() const { return frames.size(); }
+
+private:
+    struct Frame {
+        page_id id = 0;
+        size_t pins = 0;
+        bool used = false;
+        bool dirty = false;
+        bool referenced = false;
+    };
+
+    size_t pin(page_id, bool load);
+    size_t find_victim();
+    void write_back(size_t frame);
+    char* frame_data(size_t frame) { return data + frame * page_size; }
+
+    int fd;
+    char* data;
+    std::vector<Frame> frames;
+    std::unordered_map<page_id, size_t> table;
+    size_t hand = 0;
+    Stats counters;
+};
+
+/* Move-only pin on a resident page. */
+class BufferPool::PageRef {
+public:
+    PageRef() = default;
+    PageRef(const PageRef&) = delete;
+    PageRef& operator=(const PageRef&) = delete;
+
+    PageRef(PageRef&& o) noexcept
+        : pool(std::exchange(o.pool, nullptr)), frame(o.frame) {}
+
+    PageRef& operator=(PageRef&& o) noexcept {
+        if (this != &o) {
+            release();
+            pool = std::exchange(o.pool, nullptr);
+            frame = o.frame;
+        }
+        return *this;
+    }
+
+    ~PageRef() { release(); }
+
+    page_id id() const { return pool->frames[frame].id; }
+    char* data() const { return pool->frame_data(frame); }
+    void mark_dirty() { pool->frames[frame].dirty = true; }
+
+    template<typename Layout>
+    Layout& as() const { return *reinterpret_cast<Layout*>(data()); }
+
+private:
+    friend class BufferPool;
+
+    PageRef(BufferPool* pool, size_t frame) : pool(pool), frame(frame) {}
+
+    void release() {
+        if (pool)
+            pool->frames[frame].pins--;
+        pool = nullptr;
+    }
+
+    BufferPool* pool = nullptr;
+    size_t frame = 0;
+};
+
+inline BufferPool::BufferPool(int fd, size_t num_frames)
+    : fd(fd), frames(num_frames) {
+    data = static_cast<char*>(std::aligned_alloc(page_size, num_frames * page_size));
+    if (!data)
+        throw std::bad_alloc();
+
+    table.reserve(num_frames);
+}
+
+inline BufferPool::PageRef BufferPool::fetch(page_id id) {
+    return PageRef(this, pin(id, true));
+}
+
+inline BufferPool::PageRef BufferPool::create(page_id id) {
+    size_t f = pin(id, false);
+
+    std::memset(frame_data(f), 0, page_size);
+    frames[f].dirty = true;
+
+    return PageRef(this, f);
+}
+
+inline void BufferPool::flush() {
+    for (size_t f = 0; f < frames.size(); f++)
+        if (frames[f].used && frames[f].dirty)
+            write_back(f);
+}
+
+inline size_t BufferPool::pin(page_id id, bool load) {
+    auto it = table.find(id);
+    if (it != table.end()) {
+        Frame& frame = frames[it->second];
+        frame.pins++;
+        frame.referenced = true;
+        counters.hits++;
+        return it->second;
+    }
+
+    size_t f = find_victim();
+    Frame& frame = frames[f];
+
+    if (frame.used) {
+        if (frame.dirty)
+            write_back(f);
+        table.erase(frame.id);
+        counters.evictions++;
+    }
+
+    if (load) {
+        ssize_t r = pread(fd, frame_data(f), page_size, id * page_size);
+        if (r < 0)
+            throw std::system_error(errno, std::generic_category(), "pread");
+
+        /* Past the end of the file reads as zeroes */
+        std::memset(frame_data(f) + r, 0, page_size - r);
+        counters.faults++;
+    }
+
+    frame = Frame{id, 1, true, false, true};
+    table.emplace(id, f);
+
+    return f;
+}
+
+/* Clock sweep. Two full turns are enough to clear every reference bit. */
+inline size_t BufferPool::find_victim() {
+    for (size_t step = 0; step < 2 * frames.size() + 1; step++) {
+        size_t f = hand;
+        hand = (hand + 1) % frames.size();
+
+        Frame& frame = frames[f];
+        if (!frame.used)
+            return f;
+
+        if (frame.pins > 0)
+            continue;
+
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+
+        return f;
+    }
+
+    throw std::runtime_error("buffer pool: every frame is pinned");
+}
+
+inline void BufferPool::write_back(size_t f) {
+    ssize_t w = pwrite(fd, frame_data(f), page_size, frames[f].id * page_size);
+    if (w != static_cast<ssize_t>(page_size))
+        throw std::system_error(w < 0 ? errno : EIO, std::generic_category(), "pwrite");
+
+    frames[f].dirty = false;
+    counters.writebacks++;
+}
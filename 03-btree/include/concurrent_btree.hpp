@@ -0,0 +1,604 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "btree.hpp"
+
+/**
+ * Concurrent B-tree with optimistic lock coupling (OLC).
+ *
+ * Every node carries a version word: bit 0 marks the node obsolete, bit 1
+ * is the write lock, and the remaining bits count modifications.
+ *
+ *  - Readers never write to shared memory. They remember the version of a
+ *    node, read what they need, and validate the version before trusting
+ *    what they read (and before moving on to the child).
+ *  - Writers descend the same way and only upgrade to a write lock on the
+ *    nodes they are about to change: the leaf for an insert or a remove, the
+ *    parent and the child for split_child, and the parent, the child and
+ *    one sibling for merge_children or a borrow.
+ *
+ * Any failed validation or lock upgrade restarts the operation from the
+ * root. Structural changes follow the engine: full nodes are split and
+ * thin nodes are refilled on the way down, so a modification never has to
+ * walk back up. After a structural change the operation restarts as well.
+ *
+ * Keys live in the leaves only (internal nodes hold separators, as in
+ * BPlusTree), so an insert or a remove that does not restructure touches
+ * exactly one leaf.
+ *
+ * Node memory is type-stable: nodes come from slab pools and a node that is
+ * merged away is recycled as a node of the same kind, with its version word
+ * carrying on from where it was. A reader that still holds a stale pointer
+ * reads harmless data and fails validation. Nodes are released when the
+ * tree is destroyed.
+ *
+ * Optimistic readers race with writers by design, so keys must be trivially
+ * copyable.
+ */
+
+template<typename T, size_t B = 6>
+struct ConcurrentBTreeNode;
+
+template<typename T, size_t B = 6>
+struct ConcurrentBTreeInternalNode;
+
+template<typename T, size_t B = 6>
+class ConcurrentBTree {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "optimistic readers need trivially copyable keys");
+
+    using Node = ConcurrentBTreeNode<T, B>;
+    using Internal = ConcurrentBTreeInternalNode<T, B>;
+
+public:
+    ConcurrentBTree();
+    ConcurrentBTree(const ConcurrentBTree&) = delete;
+    ConcurrentBTree& operator=(const ConcurrentBTree&) = delete;
+
+    bool insert(const T&);
+    bool remove(const T&);
+    bool contains(const T&) const;
+
+    /* These two need the tree to be quiescent */
+    void for_all(std::function<void(const T&)>) const;
+    void for_all_nodes(std::function<void(const ConcurrentBTreeNode<T, B>&)>) const;
+
+    const ConcurrentBTreeNode<T, B>* root_node() const { return root.load(); }
+
+private:
+    std::optional<bool> try_insert(const T&);
+    std::optional<bool> try_remove(const T&);
+    std::optional<bool> try_contains(const T&) const;
+
+    void split_child(Node& parent, size_t idx);
+    void merge_children(Node& parent, size_t idx);
+
+    Node* make(NodeType);
+    void retire(Node*);
+
+    std::atomic<Node*> root;
+
+    /* Allocation is the only thing serialised across writers */
+    std::mutex alloc_lock;
+    SlabPool<sizeof(Node), alignof(Node)> leaves;
+    SlabPool<sizeof(Internal), alignof(Internal)> internals;
+    std::vector<Node*> free_leaves, free_internals;
+};
+
+template<typename T, size_t B>
+struct ConcurrentBTreeNode {
+    static constexpr uint64_t OBSOLETE = 0b01;
+    static constexpr uint64_t LOCKED = 0b10;
+
+    std::atomic<uint64_t> version{0};
+    const NodeType type;
+    size_t n = 0;
+    std::array<T, 2 * B - 1> keys;
+
+    ConcurrentBTreeNode(NodeType type) : type(type) {}
+
+    /* `n` may be read while a writer changes it; never index past capacity */
+    size_t size() const { return std::min(n, 2 * B - 1); }
+    size_t get_index(const T& t) const;
+    size_t child_index(const T& t) const;
+
+    ConcurrentBTreeNode*& edge(size_t i);
+    ConcurrentBTreeNode* edge(size_t i) const;
+
+    bool read_lock(uint64_t& v) const;
+    bool validate(uint64_t v) const;
+    bool upgrade(uint64_t v);
+    void write_lock();
+    void write_unlock();
+    void write_unlock_obsolete();
+
+    static void borrow_from_left(ConcurrentBTreeNode&, size_t);
+    static void borrow_from_right(ConcurrentBTreeNode&, size_t);
+};
+
+template<typename T, size_t B>
+struct ConcurrentBTreeInternalNode : ConcurrentBTreeNode<T, B> {
+    std::array<ConcurrentBTreeNode<T, B>*, 2 * B> edges;
+
+    ConcurrentBTreeInternalNode() : ConcurrentBTreeNode<T, B>(NodeType::INTERNAL) {}
+};
+
+template<typename T, size_t B>
+ConcurrentBTree<T, B>::ConcurrentBTree() {
+    root.store(make(NodeType::LEAF));
+}
+
+template<typename T, size_t B>
+bool ConcurrentBTree<T, B>::insert(const T& t) {
+    while (true)
+        if (auto done = try_insert(t))
+            return *done;
+}
+
+template<typename T, size_t B>
+bool ConcurrentBTree<T, B>::remove(const T& t) {
+    while (true)
+        if (auto done = try_remove(t))
+            return *done;
+}
+
+template<typename T, size_t B>
+bool ConcurrentBTree<T, B>::contains(const T& t) const {
+    while (true)
+        if (auto found = try_contains(t))
+            return *found;
+}
+
+/* Each try_* returns nullopt when it has to restart from the root. */
+template<typename T, size_t B>
+std::optional<bool> ConcurrentBTree<T, B>::try_contains(const T& t) const {
+    Node* node = root.load(std::memory_order_acquire);
+    uint64_t v;
+
+    if (!node->read_lock(v) || node != root.load(std::memory_order_acquire))
+        return std::nullopt;
+
+    while (node->type == NodeType::INTERNAL) {
+        Node* child = node->edge(node->child_index(t));
+        if (!node->validate(v))
+            return std::nullopt;
+
+        Node* parent = node;
+        uint64_t pv = v;
+
+        node = child;
+        if (!node->read_lock(v) || !parent->validate(pv))
+            return std::nullopt;
+    }
+
+    size_t idx = node->get_index(t);
+    bool found = idx < node->size() && node->keys[idx] == t;
+
+    if (!node->validate(v))
+        return std::nullopt;
+
+    return found;
+}
+
+template<typename T, size_t B>
+std::optional<bool> ConcurrentBTree<T, B>::try_insert(const T& t) {
+    Node* node = root.load(std::memory_order_acquire);
+    Node* parent = nullptr;
+    uint64_t v, pv = 0;
+
+    if (!node->read_lock(v) || node != root.load(std::memory_order_acquire))
+        return std::nullopt;
+
+    while (true) {
+        /* Never step into a full node: split it under the parent's lock and
+           start over. The parent cannot be full, or it would have been split
+           on the way down (and its version says nothing changed since). */
+        if (node->size() == 2 * B - 1) {
+            if (parent && !parent->upgrade(pv))
+                return std::nullopt;
+
+            if (!node->upgrade(v)) {
+                if (parent) parent->write_unlock();
+                return std::nullopt;
+            }
+
+            if (!parent && node != root.load(std::memory_order_acquire)) {
+                node->write_unlock();
+                return std::nullopt;
+            }
+
+            if (parent) {
+                split_child(*parent, parent->child_index(t));
+                node->write_unlock();
+                parent->write_unlock();
+            } else {
+                /* The new root is not reachable before it is published */
+                Node* new_root = make(NodeType::INTERNAL);
+                new_root->edge(0) = node;
+                split_child(*new_root, 0);
+                root.store(new_root, std::memory_order_release);
+                node->write_unlock();
+            }
+
+            return std::nullopt;
+        }
+
+        if (node->type == NodeType::LEAF)
+            break;
+
+        Node* child = node->edge(node->child_index(t));
+        if (!node->validate(v))
+            return std::nullopt;
+
+        parent = node;
+        pv = v;
+
+        node = child;
+        if (!node->read_lock(v) || !parent->validate(pv))
+            return std::nullopt;
+    }
+
+    if (!node->upgrade(v))
+        return std::nullopt;
+
+    if (parent && !parent->validate(pv)) {
+        node->write_unlock();
+        return std::nullopt;
+    }
+
+    size_t idx = node->get_index(t);
+    if (idx < node->n && node->keys[idx] == t) {
+        node->write_unlock();
+        return false;
+    }
+
+    for (size_t j = node->n; j > idx; j--)
+        node->keys[j] = node->keys[j - 1];
+    node->keys[idx] = t;
+    node->n++;
+
+    node->write_unlock();
+    return true;
+}
+
+template<typename T, size_t B>
+std::optional<bool> ConcurrentBTree<T, B>::try_remove(const T& t) {
+    Node* node = root.load(std::memory_order_acquire);
+    Node* parent = nullptr;
+    uint64_t v, pv = 0;
+
+    if (!node->read_lock(v) || node != root.load(std::memory_order_acquire))
+        return std::nullopt;
+
+    while (node->type == NodeType::INTERNAL) {
+        size_t idx = node->child_index(t);
+        Node* child = node->edge(idx);
+        uint64_t cv;
+
+        if (!node->validate(v) || !child->read_lock(cv) || !node->validate(v))
+            return std::nullopt;
+
+        /* Never step into a node that cannot lose a key: refill it from a
+           sibling, or merge it with one, under the locks of all three. */
+        if (child->size() < B) {
+            if (!node->upgrade(v))
+                return std::nullopt;
+
+            if (!child->upgrade(cv)) {
+                node->write_unlock();
+                return std::nullopt;
+            }
+
+            size_t s = idx != 0 ? idx - 1 : idx + 1;
+            Node* sibling = node->edge(s);
+
+            /* The parent is locked, so the sibling cannot go away */
+            sibling->write_lock();
+
+            if (sibling->n >= B) {
+                if (s < idx)
+                    Node::borrow_from_left(*node, idx);
+                else
+                    Node::borrow_from_right(*node, idx);
+
+                sibling->write_unlock();
+                child->write_unlock();
+            } else {
+                Node* left = s < idx ? sibling : child;
+                Node* right = s < idx ? child : sibling;
+
+                merge_children(*node, std::min(s, idx));
+                right->write_unlock_obsolete();
+                retire(right);
+                left->write_unlock();
+            }
+
+            if (node->n == 0 && node == root.load(std::memory_order_acquire)) {
+                root.store(node->edge(0), std::memory_order_release);
+                node->write_unlock_obsolete();
+                retire(node);
+            } else {
+                node->write_unlock();
+            }
+
+            return std::nullopt;
+        }
+
+        parent = node;
+        pv = v;
+        node = child;
+        v = cv;
+    }
+
+    if (!node->upgrade(v))
+        return std::nullopt;
+
+    if (parent && !parent->validate(pv)) {
+        node->write_unlock();
+        return std::nullopt;
+    }
+
+    size_t idx = node->get_index(t);
+    if (idx == node->n || !(node->keys[idx] == t)) {
+        node->write_unlock();
+        return false;
+    }
+
+    for (size_t j = idx; j + 1 < node->n; j++)
+        node->keys[j] = node->keys[j + 1];
+    node->n--;
+
+    node->write_unlock();
+    return true;
+}
+
+/* Same as BPlusTreeNode::split_child. Both nodes are write-locked. */
+template<typename T, size_t B>
+void ConcurrentBTree<T, B>::split_child(Node& parent, size_t idx) {
+    Node* y = parent.edge(idx);
+    Node* z = make(y->type);
+    T separator;
+
+    if (y->type == NodeType::LEAF) {
+        for (size_t j = 0; j < B; j++)
+            z->keys[j] = y->keys[j + B - 1];
+
+        z->n = B;
+        separator = z->keys[0];
+    } else {
+        for (size_t j = 0; j < B - 1; j++)
+            z->keys[j] = y->keys[j + B];
+
+        for (size_t j = 0; j < B; j++)
+            z->edge(j) = y->edge(j + B);
+
+        z->n = B - 1;
+        separator = y->keys[B - 1];
+    }
+
+    y->n = B - 1;
+
+    for (size_t j = parent.n + 1; j > idx + 1; j--)
+        parent.edge(j) = parent.edge(j - 1);
+
+    for (size_t j = parent.n; j > idx; j--)
+        parent.keys[j] = parent.keys[j - 1];
+
+    parent.edge(idx + 1) = z;
+    parent.keys[idx] = separator;
+    parent.n++;
+}
+
+/* Same as BPlusTreeNode::merge_children, except that the caller retires the
+   sibling. All three nodes are write-locked. */
+template<typename T, size_t B>
+void ConcurrentBTree<T, B>::merge_children(Node& node, size_t idx) {
+    Node* child = node.edge(idx);
+    Node* sibling = node.edge(idx + 1);
+
+    if (child->type == NodeType::LEAF) {
+        for (size_t i = 0; i < sibling->n; i++)
+            child->keys[child->n + i] = sibling->keys[i];
+
+        child->n += sibling->n;
+    } else {
+        child->keys[child->n] = node.keys[idx];
+
+        for (size_t i = 0; i < sibling->n; i++)
+            child->keys[child->n + 1 + i] = sibling->keys[i];
+
+        for (size_t i = 0; i <= sibling->n; i++)
+            child->edge(child->n + 1 + i) = sibling->edge(i);
+
+        child->n += sibling->n + 1;
+    }
+
+    for (size_t i = idx + 1; i < node.n; i++)
+        node.keys[i - 1] = node.keys[i];
+
+    for (size_t i = idx + 2; i <= node.n; i++)
+        node.edge(i - 1) = node.edge(i);
+
+    node.n--;
+}
+
+/* A recycled node keeps its version word, so no reader can mistake it for
+   the node it used to be: the obsolete bit is dropped by moving on to the
+   next (unlocked) version. */
+template<typename T, size_t B>
+typename ConcurrentBTree<T, B>::Node* ConcurrentBTree<T, B>::make(NodeType type) {
+    std::lock_guard<std::mutex> guard(alloc_lock);
+    auto& free_list = type == NodeType::LEAF ? free_leaves : free_internals;
+
+    if (!free_list.empty()) {
+        Node* node = free_list.back();
+        free_list.pop_back();
+
+        node->n = 0;
+        node->version.store(node->version.load() + (Node::LOCKED | Node::OBSOLETE),
+                            std::memory_order_release);
+        return node;
+    }
+
+    if (type == NodeType::INTERNAL)
+        return ::new (internals.allocate()) Internal();
+
+    return ::new (leaves.allocate()) Node(NodeType::LEAF);
+}
+
+template<typename T, size_t B>
+void ConcurrentBTree<T, B>::retire(Node* node) {
+    std::lock_guard<std::mutex> guard(alloc_lock);
+
+    (node->type == NodeType::LEAF ? free_leaves : free_internals).push_back(node);
+}
+
+template<typename T, size_t B>
+void ConcurrentBTree<T, B>::for_all(std::function<void(const T&)> func) const {
+    for_all_nodes([&func](const Node& node) {
+        if (node.type == NodeType::LEAF)
+            for (size_t i = 0; i < node.n; i++)
+                func(node.keys[i]);
+    });
+}
+
+/* Pre-order, so leaves are visited from left to right */
+template<typename T, size_t B>
+void ConcurrentBTree<T, B>::for_all_nodes(std::function<void(const Node&)> func) const {
+    std::function<void(const Node*)> visit = [&](const Node* node) {
+        func(*node);
+        if (node->type == NodeType::INTERNAL)
+            for (size_t i = 0; i <= node->n; i++)
+                visit(node->edge(i));
+    };
+
+    visit(root.load());
+}
+
+template<typename T, size_t B>
+size_t ConcurrentBTreeNode<T, B>::get_index(const T& t) const {
+    return btree_search_policy_t<T, B>::index(keys.data(), size(), t);
+}
+
+template<typename T, size_t B>
+size_t ConcurrentBTreeNode<T, B>::child_index(const T& t) const {
+    size_t idx = get_index(t);
+
+    return (idx < size() && keys[idx] == t) ? idx + 1 : idx;
+}
+
+template<typename T, size_t B>
+ConcurrentBTreeNode<T, B>*& ConcurrentBTreeNode<T, B>::edge(size_t i) {
+    return static_cast<ConcurrentBTreeInternalNode<T, B>*>(this)->edges[i];
+}
+
+template<typename T, size_t B>
+ConcurrentBTreeNode<T, B>* ConcurrentBTreeNode<T, B>::edge(size_t i) const {
+    return static_cast<const ConcurrentBTreeInternalNode<T, B>*>(this)->edges[i];
+}
+
+/* Wait for a writer to leave, then remember the version. Fails on an
+   obsolete node. */
+template<typename T, size_t B>
+bool ConcurrentBTreeNode<T, B>::read_lock(uint64_t& v) const {
+    for (size_t spins = 0; ; spins++) {
+        v = version.load(std::memory_order_acquire);
+        if (!(v & LOCKED))
+            break;
+
+        if (spins > 64)
+            std::this_thread::yield();
+    }
+
+    return !(v & OBSOLETE);
+}
+
+/* Everything read since `read_lock` returned `v` is consistent. */
+template<typename T, size_t B>
+bool ConcurrentBTreeNode<T, B>::validate(uint64_t v) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return version.load(std::memory_order_relaxed) == v;
+}
+
+template<typename T, size_t B>
+bool ConcurrentBTreeNode<T, B>::upgrade(uint64_t v) {
+    return version.compare_exchange_strong(v, v + LOCKED, std::memory_order_acquire);
+}
+
+template<typename T, size_t B>
+void ConcurrentBTreeNode<T, B>::write_lock() {
+    uint64_t v;
+
+    while (!read_lock(v) || !upgrade(v))
+        ;
+}
+
+template<typename T, size_t B>
+void ConcurrentBTreeNode<T, B>::write_unlock() {
+    version.fetch_add(LOCKED, std::memory_order_release);
+}
+
+template<typename T, size_t B>
+void ConcurrentBTreeNode<T, B>::write_unlock_obsolete() {
+    version.fetch_add(LOCKED | OBSOLETE, std::memory_order_release);
+}
+
+template<typename T, size_t B>
+void ConcurrentBTreeNode<T, B>::borrow_from_left(ConcurrentBTreeNode& node, size_t e) {
+    ConcurrentBTreeNode* child = node.edge(e);
+    ConcurrentBTreeNode* sibling = node.edge(e - 1);
+
+    for (size_t i = child->n; i > 0; i--)
+        child->keys[i] = child->keys[i - 1];
+
+    if (child->type == NodeType::LEAF) {
+        child->keys[0] = sibling->keys[sibling->n - 1];
+        node.keys[e - 1] = child->keys[0];
+    } else {
+        for (size_t i = child->n + 1; i > 0; i--)
+            child->edge(i) = child->edge(i - 1);
+
+        child->keys[0] = node.keys[e - 1];
+        child->edge(0) = sibling->edge(sibling->n);
+        node.keys[e - 1] = sibling->keys[sibling->n - 1];
+    }
+
+    child->n++;
+    sibling->n--;
+}
+
+template<typename T, size_t B>
+void ConcurrentBTreeNode<T, B>::borrow_from_right(ConcurrentBTreeNode& node, size_t e) {
+    ConcurrentBTreeNode* child = node.edge(e);
+    ConcurrentBTreeNode* sibling = node.edge(e + 1);
+
+    if (child->type == NodeType::LEAF) {
+        child->keys[child->n] = sibling->keys[0];
+        node.keys[e] = sibling->keys[1];
+    } else {
+        child->keys[child->n] = node.keys[e];
+        child->edge(child->n + 1) = sibling->edge(0);
+        node.keys[e] = sibling->keys[0];
+
+        for (size_t i = 0; i < sibling->n; i++)
+            sibling->edge(i) = sibling->edge(i + 1);
+    }
+
+    for (size_t i = 0; i + 1 < sibling->n; i++)
+        sibling->keys[i] = sibling->keys[i + 1];
+
+    child->n++;
+    sibling->n--;
+}
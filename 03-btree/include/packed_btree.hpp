@@ -0,0 +1,674 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "btree.hpp"
+
+/**
+ * B+ tree of integer keys with frame-of-reference encoded leaves.
+ *
+ * A BTree<uint64_t> leaf spends a full 8-byte slot on every key. Here a leaf
+ * stores a base value and, for each key, its delta from the base in lanes of
+ * 1, 2, 4 or 8 bytes: the narrowest lane width that holds the largest delta
+ * of the leaf. The lanes fill a fixed buffer of LeafBytes, so the number of
+ * keys a leaf holds depends on how close together they are: 256 keys per
+ * 256-byte leaf when they span less than 256 values, 32 when they are
+ * spread over the whole 64-bit range.
+ *
+ * Lanes are whole machine integers rather than an arbitrary number of bits
+ * so that a leaf is searched without decoding it: `t - base` is compared
+ * against the lanes as they are stored, with SimdSearch.
+ *
+ * All keys live in the leaves. Internal nodes hold plain separators, laid
+ * out as in BPlusTree: every key below edges[i] is smaller than keys[i] and
+ * every key below edges[i + 1] is greater or equal. Internal nodes other
+ * than the root hold between B-1 and 2B-1 keys. A leaf that overflows is
+ * re-encoded into the fewest leaves that fit its keys; a leaf that becomes
+ * empty is dropped, and two neighbouring leaves are merged once their keys
+ * fit comfortably in one.
+ *
+ * Like BPlusTree, this is a set: inserting a key that is already present
+ * fails.
+ */
+
+template<typename T, size_t B = 16, size_t LeafBytes = 256>
+struct PackedBTreeNode {
+    NodeType type;
+    uint32_t n = 0;
+
+protected:
+    explicit PackedBTreeNode(NodeType type) : type(type) {}
+};
+
+template<typename T, size_t B = 16, size_t LeafBytes = 256>
+struct PackedBTreeLeafNode : PackedBTreeNode<T, B, LeafBytes> {
+    using U = std::make_unsigned_t<T>;
+
+    T base{};
+
+    /* Bytes per delta */
+    uint8_t width = 1;
+
+    union {
+        alignas(32) std::array<uint8_t, LeafBytes> d8;
+        std::array<uint16_t, LeafBytes / 2> d16;
+        std::array<uint32_t, LeafBytes / 4> d32;
+        std::array<uint64_t, LeafBytes / 8> d64;
+    };
+
+    PackedBTreeLeafNode() : PackedBTreeNode<T, B, LeafBytes>(NodeType::LEAF) {}
+
+    size_t capacity() const { return LeafBytes / width; }
+
+    /* Call f with the lanes of the current width */
+    template<typename F>
+    decltype(auto) with_deltas(F&& f) const {
+        switch (width) {
+        case 1: return f(d8.data());
+        case 2: return f(d16.data());
+        case 4: return f(d32.data());
+        default: return f(d64.data());
+        }
+    }
+
+    template<typename F>
+    decltype(auto) with_deltas(F&& f) {
+        switch (width) {
+        case 1: return f(d8.data());
+        case 2: return f(d16.data());
+        case 4: return f(d32.data());
+        default: return f(d64.data());
+        }
+    }
+
+    T key(size_t i) const;
+    void decode(T* out) const;
+
+    /* Same contract as BTreeNode::get_index: the first key not less than t */
+    size_t get_index(const T& t) const;
+
+    /* Insert t at i if its delta fits the current lanes */
+    bool insert_in_place(size_t i, const T& t);
+    void erase(size_t i);
+
+    /* Re-encode the leaf to hold keys[0..count), which must fit */
+    void assign(const T* keys, size_t count);
+
+    static uint8_t width_for(U range);
+    static bool fits(const T* keys, size_t count);
+};
+
+template<typename T, size_t B = 16, size_t LeafBytes = 256>
+struct PackedBTreeInternalNode : PackedBTreeNode<T, B, LeafBytes> {
+    std::array<T, 2 * B - 1> keys;
+    std::array<PackedBTreeNode<T, B, LeafBytes>*, 2 * B> edges;
+
+    PackedBTreeInternalNode() : PackedBTreeNode<T, B, LeafBytes>(NodeType::INTERNAL) {}
+
+    /* The edge to descend for t: the number of separators <= t */
+    size_t child_index(const T& t) const {
+        return std::upper_bound(keys.begin(), keys.begin() + this->n, t) - keys.begin();
+    }
+};
+
+template<typename T, size_t B = 16, size_t LeafBytes = 256>
+class PackedBTree {
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>,
+                  "PackedBTree needs integer keys");
+    static_assert(B >= 2, "PackedBTree needs B >= 2");
+    static_assert(LeafBytes >= 16 && LeafBytes % 8 == 0,
+                  "LeafBytes must be a multiple of 8, at least 16");
+
+public:
+    using Node = PackedBTreeNode<T, B, LeafBytes>;
+    using Leaf = PackedBTreeLeafNode<T, B, LeafBytes>;
+    using Internal = PackedBTreeInternalNode<T, B, LeafBytes>;
+
+    PackedBTree() = default;
+    PackedBTree(const PackedBTree&) = delete;
+    PackedBTree& operator=(const PackedBTree&) = delete;
+    ~PackedBTree() { if (root) destroy(root); }
+
+    bool insert(const T&);
+    bool remove(const T&);
+    bool contains(const T&) const;
+
+    size_t size() const { return count; }
+
+    /* In-order */
+    void for_all(std::function<void(const T&)>) const;
+    void for_all_nodes(std::function<void(const Node&)>) const;
+    const std::optional<size_t> depth() const;
+
+    /* The bytes held by the nodes */
+    size_t memory_bytes() const;
+
+    Node* root = nullptr;
+
+private:
+    /* Separators and nodes that an insert below added to the right of the
+       node it went into, for the parent to take in */
+    using Grown = std::vector<std::pair<T, Node*>>;
+
+    size_t count = 0;
+
+    static void destroy(Node*);
+    static bool insert(Node*, const T&, Grown&);
+    static void split_leaf(Leaf&, const T*, size_t, bool, Grown&);
+    static void spread(Internal&, const std::vector<T>&, const std::vector<Node*>&, Grown&);
+    static bool remove(Node*, const T&);
+    static void repair_child(Internal&, size_t);
+    static void drop_edge(Internal&, size_t);
+    static void merge_leaves(Internal&, size_t);
+    static void merge_children(Internal&, size_t);
+    static void borrow_from_left(Internal&, size_t);
+    static void borrow_from_right(Internal&, size_t);
+    static void for_all(const Node*, std::function<void(const T&)>&);
+    static void for_all_nodes(const Node*, std::function<void(const Node&)>&);
+};
+
+namespace btree_detail {
+
+/* SimdSearch where the lane type is supported on this target */
+template<typename D>
+using packed_lane_search =
+    std::conditional_t<SimdSearch::supports<D>, SimdSearch, BinarySearch>;
+
+} // namespace btree_detail
+
+template<typename T, size_t B, size_t LeafBytes>
+T PackedBTreeLeafNode<T, B, LeafBytes>::key(size_t i) const {
+    return with_deltas([&](const auto* d) { return T(U(base) + U(d[i])); });
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTreeLeafNode<T, B, LeafBytes>::decode(T* out) const {
+    with_deltas([&](const auto* d) {
+        for (size_t i = 0; i < this->n; i++)
+            out[i] = T(U(base) + U(d[i]));
+    });
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+size_t PackedBTreeLeafNode<T, B, LeafBytes>::get_index(const T& t) const {
+    if (this->n == 0 || t < base)
+        return 0;
+
+    U delta = U(t) - U(base);
+
+    return with_deltas([&](const auto* d) -> size_t {
+        using D = std::remove_const_t<std::remove_pointer_t<decltype(d)>>;
+
+        /* Beyond every lane */
+        if (delta > std::numeric_limits<D>::max())
+            return this->n;
+
+        return btree_detail::packed_lane_search<D>::index(d, this->n, D(delta));
+    });
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTreeLeafNode<T, B, LeafBytes>::insert_in_place(size_t i, const T& t) {
+    if (this->n == 0 || this->n == capacity() || t < base)
+        return false;
+
+    U delta = U(t) - U(base);
+
+    return with_deltas([&](auto* d) {
+        using D = std::remove_pointer_t<decltype(d)>;
+
+        if (delta > std::numeric_limits<D>::max())
+            return false;
+
+        btree_detail::shift(d + i, this->n - i, d + i + 1);
+        d[i] = D(delta);
+        this->n++;
+        return true;
+    });
+}
+
+/* The base stays: it is still no greater than any key left, and the lanes
+   keep their width until the leaf is next re-encoded. */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTreeLeafNode<T, B, LeafBytes>::erase(size_t i) {
+    with_deltas([&](auto* d) { btree_detail::shift(d + i + 1, this->n - i - 1, d + i); });
+    this->n--;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTreeLeafNode<T, B, LeafBytes>::assign(const T* keys, size_t count) {
+    this->n = count;
+    if (count == 0) {
+        width = 1;
+        return;
+    }
+
+    base = keys[0];
+    width = width_for(U(keys[count - 1]) - U(base));
+
+    with_deltas([&](auto* d) {
+        using D = std::remove_pointer_t<decltype(d)>;
+        for (size_t i = 0; i < count; i++)
+            d[i] = D(U(keys[i]) - U(base));
+    });
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+uint8_t PackedBTreeLeafNode<T, B, LeafBytes>::width_for(U range) {
+    if (range <= std::numeric_limits<uint8_t>::max())
+        return 1;
+    if (range <= std::numeric_limits<uint16_t>::max())
+        return 2;
+    if (range <= std::numeric_limits<uint32_t>::max())
+        return 4;
+    return 8;
+}
+
+/* Whether sorted keys[0..count) fit in one leaf */
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTreeLeafNode<T, B, LeafBytes>::fits(const T* keys, size_t count) {
+    return count == 0 || count * width_for(U(keys[count - 1]) - U(keys[0])) <= LeafBytes;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::destroy(Node* node) {
+    if (node->type == NodeType::LEAF) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+
+    auto* internal = static_cast<Internal*>(node);
+    for (size_t i = 0; i <= internal->n; i++)
+        destroy(internal->edges[i]);
+    delete internal;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTree<T, B, LeafBytes>::insert(const T& t) {
+    if (!root)
+        root = new Leaf();
+
+    Grown grown;
+    if (!insert(root, t, grown))
+        return false;
+
+    count++;
+
+    /* The root split: grow a level until the new root takes everything */
+    while (!grown.empty()) {
+        std::vector<T> keys;
+        std::vector<Node*> edges{ root };
+        for (auto& [k, node] : grown) {
+            keys.push_back(k);
+            edges.push_back(node);
+        }
+
+        auto* top = new Internal();
+        root = top;
+        grown.clear();
+        spread(*top, keys, edges, grown);
+    }
+
+    return true;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTree<T, B, LeafBytes>::insert(Node* node, const T& t, Grown& grown) {
+    if (node->type == NodeType::LEAF) {
+        auto& leaf = static_cast<Leaf&>(*node);
+        size_t i = leaf.get_index(t);
+
+        if (i < leaf.n && leaf.key(i) == t)
+            return false;
+        if (leaf.insert_in_place(i, t))
+            return true;
+
+        /* Below the base, wider than the lanes, or full: re-encode */
+        std::array<T, LeafBytes + 1> keys;
+        leaf.decode(keys.data());
+        btree_detail::shift(keys.data() + i, leaf.n - i, keys.data() + i + 1);
+        keys[i] = t;
+
+        split_leaf(leaf, keys.data(), leaf.n + 1, i == leaf.n, grown);
+        return true;
+    }
+
+    auto& internal = static_cast<Internal&>(*node);
+    size_t i = internal.child_index(t);
+
+    Grown below;
+    if (!insert(internal.edges[i], t, below))
+        return false;
+    if (below.empty())
+        return true;
+
+    std::vector<T> keys(internal.keys.begin(), internal.keys.begin() + internal.n);
+    std::vector<Node*> edges(internal.edges.begin(), internal.edges.begin() + internal.n + 1);
+    for (size_t j = 0; j < below.size(); j++) {
+        keys.insert(keys.begin() + i + j, below[j].first);
+        edges.insert(edges.begin() + i + 1 + j, below[j].second);
+    }
+
+    spread(internal, keys, edges, grown);
+    return true;
+}
+
+/* Encode sorted keys[0..count) into `leaf` and as many new leaves as it
+   takes: the fewest that fit, found greedily, in even pieces when even
+   pieces fit too. When the key that overflowed the leaf went to its end,
+   as with IDs handed out in order, the greedy pieces are kept instead, so
+   the leaves left behind stay full. */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::split_leaf(Leaf& leaf, const T* keys, size_t count,
+                                              bool append, Grown& grown) {
+    if (Leaf::fits(keys, count)) {
+        leaf.assign(keys, count);
+        return;
+    }
+
+    auto longest = [&](size_t from) {
+        size_t lo = 1, hi = std::min(count - from, LeafBytes);
+        while (lo < hi) {
+            size_t mid = (lo + hi + 1) / 2;
+            if (Leaf::fits(keys + from, mid))
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return lo;
+    };
+
+    std::vector<size_t> greedy;
+    for (size_t from = 0; from < count; from += greedy.back())
+        greedy.push_back(longest(from));
+
+    size_t pieces = greedy.size();
+    std::vector<size_t> sizes;
+    for (size_t j = 0, from = 0; j < pieces && !append; j++) {
+        sizes.push_back(count / pieces + (j < count % pieces));
+        if (!Leaf::fits(keys + from, sizes.back())) {
+            sizes = greedy;
+            break;
+        }
+        from += sizes.back();
+    }
+
+    if (append)
+        sizes = greedy;
+
+    leaf.assign(keys, sizes[0]);
+    for (size_t j = 1, from = sizes[0]; j < pieces; from += sizes[j++]) {
+        auto* piece = new Leaf();
+        piece->assign(keys + from, sizes[j]);
+        grown.emplace_back(keys[from], piece);
+    }
+}
+
+/* Lay out keys and edges (one more edge than keys) over `node` and, when
+   they overflow it, over new internal nodes of B to 2B edges each; the key
+   between two of them moves up with the right one. */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::spread(Internal& node, const std::vector<T>& keys,
+                                          const std::vector<Node*>& edges, Grown& grown) {
+    size_t total = edges.size();
+    size_t pieces = (total + 2 * B - 1) / (2 * B);
+
+    for (size_t j = 0, from = 0; j < pieces; j++) {
+        size_t take = total / pieces + (j < total % pieces);
+        Internal* piece = j == 0 ? &node : new Internal();
+
+        piece->n = take - 1;
+        std::copy(edges.begin() + from, edges.begin() + from + take, piece->edges.begin());
+        std::copy(keys.begin() + from, keys.begin() + from + take - 1, piece->keys.begin());
+
+        if (j > 0)
+            grown.emplace_back(keys[from - 1], piece);
+        from += take;
+    }
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTree<T, B, LeafBytes>::remove(const T& t) {
+    if (!root || !remove(root, t))
+        return false;
+
+    count--;
+
+    while (root->type == NodeType::INTERNAL && root->n == 0) {
+        auto* old = static_cast<Internal*>(root);
+        root = old->edges[0];
+        delete old;
+    }
+
+    return true;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTree<T, B, LeafBytes>::remove(Node* node, const T& t) {
+    if (node->type == NodeType::LEAF) {
+        auto& leaf = static_cast<Leaf&>(*node);
+        size_t i = leaf.get_index(t);
+
+        if (i == leaf.n || leaf.key(i) != t)
+            return false;
+
+        leaf.erase(i);
+        return true;
+    }
+
+    auto& internal = static_cast<Internal&>(*node);
+    size_t i = internal.child_index(t);
+
+    if (!remove(internal.edges[i], t))
+        return false;
+
+    repair_child(internal, i);
+    return true;
+}
+
+/* After a remove below edges[i]: drop it if it is an empty leaf, merge it
+   with a neighbouring leaf once both fit in three quarters of a leaf, and
+   keep internal children at B-1 keys or more. */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::repair_child(Internal& node, size_t i) {
+    Node* child = node.edges[i];
+
+    if (child->type == NodeType::LEAF) {
+        auto& leaf = static_cast<Leaf&>(*child);
+
+        if (leaf.n == 0) {
+            drop_edge(node, i);
+            return;
+        }
+
+        auto small = [](const Leaf& a, const Leaf& b) {
+            return 4 * (a.n + b.n) * std::max(a.width, b.width) <= 3 * LeafBytes;
+        };
+
+        if (i > 0 && small(static_cast<Leaf&>(*node.edges[i - 1]), leaf))
+            merge_leaves(node, i - 1);
+        else if (i < node.n && small(leaf, static_cast<Leaf&>(*node.edges[i + 1])))
+            merge_leaves(node, i);
+        return;
+    }
+
+    if (child->n >= B - 1)
+        return;
+
+    if (i > 0 && node.edges[i - 1]->n > B - 1)
+        borrow_from_left(node, i);
+    else if (i < node.n && node.edges[i + 1]->n > B - 1)
+        borrow_from_right(node, i);
+    else if (i > 0)
+        merge_children(node, i - 1);
+    else
+        merge_children(node, i);
+}
+
+/* Remove the empty leaf edges[i] along with a separator next to it */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::drop_edge(Internal& node, size_t i) {
+    delete static_cast<Leaf*>(node.edges[i]);
+
+    size_t k = i > 0 ? i - 1 : 0;
+    btree_detail::shift(node.keys.data() + k + 1, node.n - k - 1, node.keys.data() + k);
+    btree_detail::shift(node.edges.data() + i + 1, node.n - i, node.edges.data() + i);
+    node.n--;
+}
+
+/* Re-encode leaves edges[i] and edges[i+1] into edges[i], if their keys fit
+   one leaf; they may not once their lanes are widened to span both. */
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::merge_leaves(Internal& node, size_t i) {
+    auto& left = static_cast<Leaf&>(*node.edges[i]);
+    auto& right = static_cast<Leaf&>(*node.edges[i + 1]);
+
+    std::array<T, LeafBytes> keys;
+    left.decode(keys.data());
+    right.decode(keys.data() + left.n);
+
+    size_t total = left.n + right.n;
+    if (!Leaf::fits(keys.data(), total))
+        return;
+
+    left.assign(keys.data(), total);
+    right.n = 0;
+    drop_edge(node, i + 1);
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::merge_children(Internal& node, size_t i) {
+    auto& left = static_cast<Internal&>(*node.edges[i]);
+    auto* right = static_cast<Internal*>(node.edges[i + 1]);
+
+    left.keys[left.n] = node.keys[i];
+    std::copy(right->keys.begin(), right->keys.begin() + right->n,
+              left.keys.begin() + left.n + 1);
+    std::copy(right->edges.begin(), right->edges.begin() + right->n + 1,
+              left.edges.begin() + left.n + 1);
+    left.n += right->n + 1;
+    delete right;
+
+    btree_detail::shift(node.keys.data() + i + 1, node.n - i - 1, node.keys.data() + i);
+    btree_detail::shift(node.edges.data() + i + 2, node.n - i - 1, node.edges.data() + i + 1);
+    node.n--;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::borrow_from_left(Internal& node, size_t i) {
+    auto& child = static_cast<Internal&>(*node.edges[i]);
+    auto& sibling = static_cast<Internal&>(*node.edges[i - 1]);
+
+    btree_detail::shift(child.keys.data(), child.n, child.keys.data() + 1);
+    btree_detail::shift(child.edges.data(), child.n + 1, child.edges.data() + 1);
+    child.keys[0] = node.keys[i - 1];
+    child.edges[0] = sibling.edges[sibling.n];
+    child.n++;
+
+    node.keys[i - 1] = sibling.keys[sibling.n - 1];
+    sibling.n--;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::borrow_from_right(Internal& node, size_t i) {
+    auto& child = static_cast<Internal&>(*node.edges[i]);
+    auto& sibling = static_cast<Internal&>(*node.edges[i + 1]);
+
+    child.keys[child.n] = node.keys[i];
+    child.edges[child.n + 1] = sibling.edges[0];
+    child.n++;
+
+    node.keys[i] = sibling.keys[0];
+    btree_detail::shift(sibling.keys.data() + 1, sibling.n - 1, sibling.keys.data());
+    btree_detail::shift(sibling.edges.data() + 1, sibling.n, sibling.edges.data());
+    sibling.n--;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+bool PackedBTree<T, B, LeafBytes>::contains(const T& t) const {
+    if (!root)
+        return false;
+
+    const Node* node = root;
+    while (node->type == NodeType::INTERNAL) {
+        auto* internal = static_cast<const Internal*>(node);
+        node = internal->edges[internal->child_index(t)];
+    }
+
+    auto* leaf = static_cast<const Leaf*>(node);
+    size_t i = leaf->get_index(t);
+    return i < leaf->n && leaf->key(i) == t;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::for_all(std::function<void(const T&)> f) const {
+    if (root)
+        for_all(root, f);
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::for_all(const Node* node, std::function<void(const T&)>& f) {
+    if (node->type == NodeType::LEAF) {
+        auto* leaf = static_cast<const Leaf*>(node);
+        std::array<T, LeafBytes> keys;
+        leaf->decode(keys.data());
+        for (size_t i = 0; i < leaf->n; i++)
+            f(keys[i]);
+        return;
+    }
+
+    auto* internal = static_cast<const Internal*>(node);
+    for (size_t i = 0; i <= internal->n; i++)
+        for_all(internal->edges[i], f);
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::for_all_nodes(std::function<void(const Node&)> f) const {
+    if (root)
+        for_all_nodes(root, f);
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+void PackedBTree<T, B, LeafBytes>::for_all_nodes(const Node* node,
+                                                 std::function<void(const Node&)>& f) {
+    f(*node);
+
+    if (node->type == NodeType::INTERNAL) {
+        auto* internal = static_cast<const Internal*>(node);
+        for (size_t i = 0; i <= internal->n; i++)
+            for_all_nodes(internal->edges[i], f);
+    }
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+const std::optional<size_t> PackedBTree<T, B, LeafBytes>::depth() const {
+    if (!root)
+        return std::nullopt;
+
+    size_t d = 0;
+    for (const Node* node = root; node->type == NodeType::INTERNAL;
+         node = static_cast<const Internal*>(node)->edges[0])
+        d++;
+
+    return d;
+}
+
+template<typename T, size_t B, size_t LeafBytes>
+size_t PackedBTree<T, B, LeafBytes>::memory_bytes() const {
+    size_t bytes = 0;
+
+    for_all_nodes([&bytes](const Node& node) {
+        bytes += node.type == NodeType::LEAF ? sizeof(Leaf) : sizeof(Internal);
+    });
+
+    return bytes;
+}
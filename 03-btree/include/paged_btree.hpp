@@ -0,0 +1,549 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "btree.hpp"
+#include "buffer_pool.hpp"
+
+/**
+ * Disk-resident B-tree.
+ *
+ * Every node is one page of a file, edges are page ids instead of pointers,
+ * and nodes are only ever reached through pinned BufferPool pages, so the
+ * tree can be far larger than the memory given to the pool. Page 0 holds
+ * the metadata (root, number of pages, head of the free page list); page
+ * id 0 doubles as the null edge.
+ *
+ * insert, remove and the search are the engine's algorithms (preemptive
+ * split on the way down, borrow/merge on the way down, predecessor or
+ * successor replacement for internal keys) applied to page handles. Pages
+ * that a split or a merge touches are marked dirty and written back on
+ * eviction or `flush`. Freed pages are chained into a free list and reused.
+ *
+ * Keys are stored as raw bytes, so they must be trivially copyable. The
+ * default B is the largest one whose node fits in a page.
+ */
+
+template<typename T>
+constexpr size_t paged_btree_fanout() {
+    return (BufferPool::page_size - sizeof(uint64_t) + sizeof(T))
+        / (2 * (sizeof(T) + sizeof(BufferPool::page_id)));
+}
+
+template<typename T, size_t B>
+struct PagedBTreeNode {
+    NodeType type;
+    uint32_t n;
+    std::array<T, 2 * B - 1> keys;
+    std::array<BufferPool::page_id, 2 * B> edges;
+
+    size_t get_index(const T& t) const {
+        return btree_search_policy_t<T, B>::index(keys.data(), n, t);
+    }
+};
+
+template<typename T, size_t B = paged_btree_fanout<T>()>
+class PagedBTree {
+    static_assert(std::is_trivially_copyable_v<T>, "keys are stored as raw bytes");
+    static_assert(sizeof(PagedBTreeNode<T, B>) <= BufferPool::page_size,
+                  "a node must fit in a page");
+
+    using Node = PagedBTreeNode<T, B>;
+    using PageRef = BufferPool::PageRef;
+    using page_id = BufferPool::page_id;
+
+public:
+    /* Open the tree stored in `path`, or create an empty one */
+    explicit PagedBTree(const std::string& path, size_t num_frames = 256);
+    PagedBTree(const PagedBTree&) = delete;
+    PagedBTree& operator=(const PagedBTree&) = delete;
+    ~PagedBTree();
+
+    bool insert(const T&);
+    bool remove(const T&);
+    bool contains(const T&);
+
+    void for_all(std::function<void(const T&)>);
+    const std::optional<size_t> depth();
+
+    /* Write every dirty page and the metadata back */
+    void flush();
+
+    BufferPool& buffer_pool() { return pool; }
+    size_t num_pages() const { return meta.num_pages; }
+
+private:
+    struct Meta {
+        char magic[8];
+        uint64_t page_size;
+        uint64_t key_size;
+        uint64_t fanout;
+        page_id root;
+        uint64_t num_pages;
+        page_id free_head;
+    };
+
+    static constexpr char MAGIC[8] = {'B', 'T', 'R', 'E', 'E', 'P', 'G', '1'};
+
+    static int open_file(const std::string& path);
+
+    static Node& node(const PageRef& ref) { return ref.as<Node>(); }
+
+    PageRef allocate(NodeType);
+    void free_page(page_id);
+
+    bool remove(PageRef& ref, const T& t);
+    void split_child(PageRef& parent, size_t idx);
+    void merge_children(PageRef& parent, size_t idx);
+    void borrow_from_left(PageRef& parent, size_t idx);
+    void borrow_from_right(PageRef& parent, size_t idx);
+    T find_rightmost_key(page_id);
+    T find_leftmost_key(page_id);
+    void for_all(page_id, std::function<void(const T&)>&);
+
+    int fd;
+    Meta meta;
+    BufferPool pool;
+};
+
+template<typename T, size_t B>
+int PagedBTree<T, B>::open_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    return fd;
+}
+
+template<typename T, size_t B>
+PagedBTree<T, B>::PagedBTree(const std::string& path, size_t num_frames)
+    : fd(open_file(path)), pool(fd, num_frames) {
+    ssize_t r = pread(fd, &meta, sizeof(meta), 0);
+    if (r < 0) {
+        ::close(fd);
+        throw std::system_error(errno, std::generic_category(), "pread " + path);
+    }
+
+    if (r == 0) {
+        std::memcpy(meta.magic, MAGIC, sizeof(MAGIC));
+        meta.page_size = BufferPool::page_size;
+        meta.key_size = sizeof(T);
+        meta.fanout = B;
+        meta.root = 0;
+        meta.num_pages = 1;
+        meta.free_head = 0;
+        return;
+    }
+
+    if (r != sizeof(meta) || std::memcmp(meta.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        meta.page_size != BufferPool::page_size || meta.key_size != sizeof(T) ||
+        meta.fanout != B) {
+        ::close(fd);
+        throw std::runtime_error(path + ": not a paged B-tree of this key type and fanout");
+    }
+}
+
+template<typename T, size_t B>
+PagedBTree<T, B>::~PagedBTree() {
+    try {
+        flush();
+    } catch (...) {
+        /* Nothing sensible to do from a destructor */
+    }
+
+    ::close(fd);
+}
+
+template<typename T, size_t B>
+void PagedBTree<T, B>::flush() {
+    pool.flush();
+
+    std::array<char, BufferPool::page_size> page{};
+    std::memcpy(page.data(), &meta, sizeof(meta));
+
+    if (pwrite(fd, page.data(), page.size(), 0) != static_cast<ssize_t>(page.size()))
+        throw std::system_error(errno, std::generic_category(), "pwrite");
+}
+
+template<typename T, size_t B>
+typename PagedBTree<T, B>::PageRef PagedBTree<T, B>::allocate(NodeType type) {
+    PageRef ref;
+
+    if (meta.free_head) {
+        page_id id = meta.free_head;
+        ref = pool.fetch(id);
+        std::memcpy(&meta.free_head, ref.data(), sizeof(page_id));
+        std::memset(ref.data(), 0, BufferPool::page_size);
+        ref.mark_dirty();
+    } else {
+        ref = pool.create(meta.num_pages++);
+    }
+
+    node(ref).type = type;
+    node(ref).n = 0;
+
+    return ref;
+}
+
+/* A free page holds the id of the next free page in its first bytes */
+template<typename T, size_t B>
+void PagedBTree<T, B>::free_page(page_id id) {
+    PageRef ref = pool.create(id);
+
+    std::memcpy(ref.data(), &meta.free_head, sizeof(page_id));
+    meta.free_head = id;
+}
+
+template<typename T, size_t B>
+bool PagedBTree<T, B>::insert(const T& t) {
+    if (!meta.root) {
+        PageRef root = allocate(NodeType::LEAF);
+        node(root).keys[0] = t;
+        node(root).n = 1;
+        meta.root = root.id();
+        return true;
+    }
+
+    PageRef ref = pool.fetch(meta.root);
+
+    /* Make sure the root node is not full */
+    if (node(ref).n >= 2 * B - 1) {
+        PageRef new_root = allocate(NodeType::INTERNAL);
+        node(new_root).edges[0] = meta.root;
+        split_child(new_root, 0);
+        meta.root = new_root.id();
+        ref = std::move(new_root);
+    }
+
+    while (node(ref).type == NodeType::INTERNAL) {
+        size_t idx = node(ref).get_index(t);
+        PageRef child = pool.fetch(node(ref).edges[idx]);
+
+        if (node(child).n == 2 * B - 1) {
+            child = PageRef();
+            split_child(ref, idx);
+            idx = node(ref).get_index(t);
+            child = pool.fetch(node(ref).edges[idx]);
+        }
+
+        ref = std::move(child);
+    }
+
+    Node& leaf = node(ref);
+    size_t idx = leaf.get_index(t);
+
+    for (size_t j = leaf.n; j > idx; j--)
+        leaf.keys[j] = leaf.keys[j - 1];
+    leaf.keys[idx] = t;
+    leaf.n++;
+    ref.mark_dirty();
+
+    return true;
+}
+
+template<typename T, size_t B>
+bool PagedBTree<T, B>::contains(const T& t) {
+    for (page_id id = meta.root; id; ) {
+        PageRef ref = pool.fetch(id);
+        const Node& nd = node(ref);
+        size_t idx = nd.get_index(t);
+
+        if (idx < nd.n && nd.keys[idx] == t)
+            return true;
+
+        if (nd.type == NodeType::LEAF)
+            return false;
+
+        id = nd.edges[idx];
+    }
+
+    return false;
+}
+
+template<typename T, size_t B>
+bool PagedBTree<T, B>::remove(const T& t) {
+    if (!meta.root)
+        return false;
+
+    PageRef root = pool.fetch(meta.root);
+    bool removed = remove(root, t);
+
+    /* After merging, the size of the root may become 0. */
+    if (node(root).n == 0 && node(root).type == NodeType::INTERNAL) {
+        page_id prev_root = meta.root;
+        meta.root = node(root).edges[0];
+        root = PageRef();
+        free_page(prev_root);
+    }
+
+    return removed;
+}
+
+template<typename T, size_t B>
+bool PagedBTree<T, B>::remove(PageRef& ref, const T& t) {
+    Node& nd = node(ref);
+    size_t idx = nd.get_index(t);
+
+    if (idx < nd.n && nd.keys[idx] == t) {
+        if (nd.type == NodeType::LEAF) {
+            for (size_t i = idx; i + 1 < nd.n; i++)
+                nd.keys[i] = nd.keys[i + 1];
+            nd.n--;
+            ref.mark_dirty();
+            return true;
+        }
+
+        PageRef left = pool.fetch(nd.edges[idx]);
+        if (node(left).n >= B) {
+            T pred_key = find_rightmost_key(nd.edges[idx]);
+            nd.keys[idx] = pred_key;
+            ref.mark_dirty();
+            return remove(left, pred_key);
+        }
+
+        PageRef right = pool.fetch(nd.edges[idx + 1]);
+        if (node(right).n >= B) {
+            T succ_key = find_leftmost_key(nd.edges[idx + 1]);
+            nd.keys[idx] = succ_key;
+            ref.mark_dirty();
+            return remove(right, succ_key);
+        }
+
+        right = PageRef();
+        merge_children(ref, idx);
+        return remove(left, t);
+    }
+
+    if (nd.type == NodeType::LEAF)
+        return false;
+
+    PageRef child = pool.fetch(nd.edges[idx]);
+    if (node(child).n < B) {
+        child = PageRef();
+
+        PageRef prev, next;
+        if (idx != 0)
+            prev = pool.fetch(nd.edges[idx - 1]);
+        if (idx != nd.n)
+            next = pool.fetch(nd.edges[idx + 1]);
+
+        if (idx != 0 && node(prev).n >= B) {
+            borrow_from_left(ref, idx);
+        } else if (idx != nd.n && node(next).n >= B) {
+            borrow_from_right(ref, idx);
+        } else {
+            prev = PageRef();
+            next = PageRef();
+            if (idx != nd.n) merge_children(ref, idx);
+            else merge_children(ref, idx - 1);
+        }
+
+        idx = nd.get_index(t);
+        child = pool.fetch(nd.edges[idx]);
+    }
+
+    return remove(child, t);
+}
+
+/* Assume this is called only when the child parent.edges[idx] is full, and
+   the parent is not full. */
+template<typename T, size_t B>
+void PagedBTree<T, B>::split_child(PageRef& parent_ref, size_t idx) {
+    Node& parent = node(parent_ref);
+    PageRef y_ref = pool.fetch(parent.edges[idx]);
+    Node& y = node(y_ref);
+    PageRef z_ref = allocate(y.type);
+    Node& z = node(z_ref);
+
+    for (size_t j = 0; j < B - 1; j++)
+        z.keys[j] = y.keys[j + B];
+
+    if (y.type == NodeType::INTERNAL) {
+        for (size_t j = 0; j < B; j++)
+            z.edges[j] = y.edges[j + B];
+    }
+
+    for (size_t j = parent.n + 1; j > idx + 1; j--)
+        parent.edges[j] = parent.edges[j - 1];
+
+    for (size_t j = parent.n; j > idx; j--)
+        parent.keys[j] = parent.keys[j - 1];
+
+    parent.edges[idx + 1] = z_ref.id();
+    parent.keys[idx] = y.keys[B - 1];
+    parent.n++;
+
+    z.n = B - 1;
+    y.n = B - 1;
+
+    parent_ref.mark_dirty();
+    y_ref.mark_dirty();
+}
+
+template<typename T, size_t B>
+void PagedBTree<T, B>::borrow_from_right(PageRef& parent_ref, size_t e) {
+    Node& parent = node(parent_ref);
+    PageRef child_ref = pool.fetch(parent.edges[e]);
+    PageRef sibling_ref = pool.fetch(parent.edges[e + 1]);
+    Node& child = node(child_ref);
+    Node& sibling = node(sibling_ref);
+
+    child.keys[child.n] = parent.keys[e];
+    if (child.type == NodeType::INTERNAL)
+        child.edges[child.n + 1] = sibling.edges[0];
+
+    parent.keys[e] = sibling.keys[0];
+
+    for (size_t i = 0; i + 1 < sibling.n; i++)
+        sibling.keys[i] = sibling.keys[i + 1];
+
+    if (sibling.type == NodeType::INTERNAL) {
+        for (size_t i = 0; i < sibling.n; i++)
+            sibling.edges[i] = sibling.edges[i + 1];
+    }
+
+    child.n++;
+    sibling.n--;
+
+    parent_ref.mark_dirty();
+    child_ref.mark_dirty();
+    sibling_ref.mark_dirty();
+}
+
+template<typename T, size_t B>
+void PagedBTree<T, B>::borrow_from_left(PageRef& parent_ref, size_t e) {
+    Node& parent = node(parent_ref);
+    PageRef child_ref = pool.fetch(parent.edges[e]);
+    PageRef sibling_ref = pool.fetch(parent.edges[e - 1]);
+    Node& child = node(child_ref);
+    Node& sibling = node(sibling_ref);
+
+    for (size_t i = child.n; i > 0; i--)
+        child.keys[i] = child.keys[i - 1];
+
+    if (child.type == NodeType::INTERNAL) {
+        for (size_t i = child.n + 1; i > 0; i--)
+            child.edges[i] = child.edges[i - 1];
+        child.edges[0] = sibling.edges[sibling.n];
+    }
+
+    child.keys[0] = parent.keys[e - 1];
+    parent.keys[e - 1] = sibling.keys[sibling.n - 1];
+
+    child.n++;
+    sibling.n--;
+
+    parent_ref.mark_dirty();
+    child_ref.mark_dirty();
+    sibling_ref.mark_dirty();
+}
+
+template<typename T, size_t B>
+void PagedBTree<T, B>::merge_children(PageRef& parent_ref, size_t idx) {
+    Node& parent = node(parent_ref);
+    PageRef child_ref = pool.fetch(parent.edges[idx]);
+    page_id sibling_id = parent.edges[idx + 1];
+    Node& child = node(child_ref);
+
+    {
+        PageRef sibling_ref = pool.fetch(sibling_id);
+        Node& sibling = node(sibling_ref);
+
+        child.keys[child.n] = parent.keys[idx];
+        for (size_t i = 0; i < sibling.n; i++)
+            child.keys[child.n + 1 + i] = sibling.keys[i];
+
+        if (child.type == NodeType::INTERNAL) {
+            for (size_t i = 0; i <= sibling.n; i++)
+                child.edges[child.n + 1 + i] = sibling.edges[i];
+        }
+
+        child.n += sibling.n + 1;
+    }
+
+    for (size_t i = idx + 1; i < parent.n; i++)
+        parent.keys[i - 1] = parent.keys[i];
+
+    for (size_t i = idx + 2; i <= parent.n; i++)
+        parent.edges[i - 1] = parent.edges[i];
+
+    parent.n--;
+
+    parent_ref.mark_dirty();
+    child_ref.mark_dirty();
+    free_page(sibling_id);
+}
+
+template<typename T, size_t B>
+T PagedBTree<T, B>::find_rightmost_key(page_id id) {
+    while (true) {
+        PageRef ref = pool.fetch(id);
+        const Node& nd = node(ref);
+
+        if (nd.type == NodeType::LEAF)
+            return nd.keys[nd.n - 1];
+
+        id = nd.edges[nd.n];
+    }
+}
+
+template<typename T, size_t B>
+T PagedBTree<T, B>::find_leftmost_key(page_id id) {
+    while (true) {
+        PageRef ref = pool.fetch(id);
+        const Node& nd = node(ref);
+
+        if (nd.type == NodeType::LEAF)
+            return nd.keys[0];
+
+        id = nd.edges[0];
+    }
+}
+
+/* In-order traversal */
+template<typename T, size_t B>
+void PagedBTree<T, B>::for_all(std::function<void(const T&)> func) {
+    if (meta.root)
+        for_all(meta.root, func);
+}
+
+template<typename T, size_t B>
+void PagedBTree<T, B>::for_all(page_id id, std::function<void(const T&)>& func) {
+    PageRef ref = pool.fetch(id);
+    const Node& nd = node(ref);
+
+    for (size_t j = 0; j < nd.n; j++) {
+        if (nd.type == NodeType::INTERNAL)
+            for_all(nd.edges[j], func);
+        func(nd.keys[j]);
+    }
+
+    if (nd.type == NodeType::INTERNAL)
+        for_all(nd.edges[nd.n], func);
+}
+
+template<typename T, size_t B>
+const std::optional<size_t> PagedBTree<T, B>::depth() {
+    if (!meta.root)
+        return std::nullopt;
+
+    size_t d = 0;
+    for (page_id id = meta.root; ; d++) {
+        PageRef ref = pool.fetch(id);
+        if (node(ref).type == NodeType::LEAF)
+            return d;
+        id = node(ref).edges[0];
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Fixed-size slots carved out of fixed-size slabs.
+ *
+ * A slot is handed out from the free list if there is one, otherwise from
+ * the unused tail of the newest slab, and a new slab is allocated only when
+ * both run out. Freed slots are threaded through an intrusive free list that
+ * lives in the slots themselves, so the pool needs no bookkeeping memory per
+ * slot. Objects allocated one after the other end up next to each other.
+ *
+ * `release` (and the destructor) give every slab back at once without
+ * touching the objects in them. Destructors are the owner's business.
+ *
+ * Not thread-safe.
+ */
+template<size_t Size, size_t Align, size_t SlabBytes = 64 * 1024>
+class SlabPool {
+    struct FreeSlot { FreeSlot* next; };
+
+    static constexpr size_t align =
+        Align > alignof(FreeSlot) ? Align : alignof(FreeSlot);
+    static constexpr size_t min_size =
+        Size > sizeof(FreeSlot) ? Size : sizeof(FreeSlot);
+
+public:
+    static constexpr size_t slot_size = (min_size + align - 1) / align * align;
+    static constexpr size_t slots_per_slab =
+        SlabBytes / slot_size > 16 ? SlabBytes / slot_size : 16;
+
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    ~SlabPool() { release(); }
+
+    void* allocate() {
+        if (free_list) {
+            FreeSlot* slot = free_list;
+            free_list = slot->next;
+            return slot;
+        }
+
+        if (bump == bump_end) {
+            char* slab = static_cast<char*>(
+                ::operator new(slot_size * slots_per_slab, std::align_val_t(align)));
+            slabs.push_back(slab);
+            bump = slab;
+            bump_end = slab + slot_size * slots_per_slab;
+        }
+
+        void* slot = bump;
+        bump += slot_size;
+        return slot;
+    }
+
+    void deallocate(void* p) {
+        FreeSlot* slot = ::new (p) FreeSlot{free_list};
+        free_list = slot;
+    }
+
+    void release() {
+        for (auto slab : slabs)
+            ::operator delete(slab, std::align_val_t(align));
+
+        slabs.clear();
+        free_list = nullptr;
+        bump = bump_end = nullptr;
+    }
+
+    size_t num_slabs() const { return slabs.size(); }
+
+private:
+    std::vector<char*> slabs;
+    FreeSlot* free_list = nullptr;
+    char* bump = nullptr;
+    char* bump_end = nullptr;
+};
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "btree.hpp"
+
+/**
+ * B-tree of string keys with prefix-compressed nodes.
+ *
+ * A BTree<std::string> node holds 2B - 1 std::string objects, each with its
+ * own allocation once a key outgrows the small-string buffer, and every
+ * comparison goes through one of them. Here a node keeps all of its keys in
+ * a single byte buffer instead: the prefix its keys share, stored once,
+ * followed by the rest of every key (its suffix), back to back in key
+ * order, with the offsets of the suffixes alongside. `get_index` compares
+ * the prefix once and then binary searches the suffixes only.
+ *
+ * When a node is (re)built, its prefix is the common prefix of its first
+ * and last key, which in a sorted node is common to all of them. Inserting
+ * a key that does not start with the prefix rebuilds the node around a
+ * shorter one; removing its first or last key may let it grow again.
+ *
+ * insert and remove are the engine's algorithms (see BTree), with keys
+ * moved between nodes as strings. Keys are handed out as std::string,
+ * assembled from prefix and suffix. Like BTree, it is a multiset.
+ */
+
+template<size_t B>
+struct StringBTreeNode {
+    NodeType type;
+    uint32_t n = 0;
+    uint32_t prefix_len = 0;
+
+    /* Suffix i spans [offsets[i], offsets[i + 1]) of `data` */
+    std::array<uint32_t, 2 * B> offsets{};
+    std::string data;
+
+    /* Internal nodes only */
+    std::vector<StringBTreeNode*> edges;
+
+    explicit StringBTreeNode(NodeType type) : type(type) {
+        if (type == NodeType::INTERNAL)
+            edges.resize(2 * B);
+    }
+
+    std::string_view prefix() const { return { data.data(), prefix_len }; }
+
+    std::string_view suffix(size_t i) const {
+        return { data.data() + offsets[i], offsets[i + 1] - offsets[i] };
+    }
+
+    std::string key(size_t i) const;
+    std::vector<std::string> keys_from(size_t from) const;
+
+    size_t get_index(std::string_view t) const;
+    bool key_equals(size_t i, std::string_view t) const;
+
+    void insert_key(size_t i, std::string_view k);
+    void erase_key(size_t i);
+    void replace_key(size_t i, std::string_view k) { erase_key(i); insert_key(i, k); }
+    void truncate(size_t m);
+    void assign(const std::vector<std::string>& keys);
+
+    /* Rebuild around a longer prefix if the keys have one */
+    void compact();
+};
+
+template<size_t B = 16>
+class StringBTree {
+    using Node = StringBTreeNode<B>;
+
+public:
+    StringBTree() = default;
+    StringBTree(const StringBTree&) = delete;
+    StringBTree& operator=(const StringBTree&) = delete;
+    ~StringBTree() { if (root) destroy(root); }
+
+    bool insert(std::string_view);
+    bool remove(std::string_view);
+    bool contains(std::string_view) const;
+
+    /* In-order. The string passed in is only valid during the call. */
+    void for_all(std::function<void(const std::string&)>) const;
+    void for_all_nodes(std::function<void(const Node&)>) const;
+    const std::optional<size_t> depth() const;
+
+    /* The bytes held by the nodes, their key buffers included */
+    size_t memory_bytes() const;
+
+    Node* root = nullptr;
+
+private:
+    static void destroy(Node*);
+    static bool remove(Node&, std::string_view);
+    static void split_child(Node&, size_t);
+    static void merge_children(Node&, size_t);
+    static void borrow_from_left(Node&, size_t);
+    static void borrow_from_right(Node&, size_t);
+    static std::string find_rightmost_key(const Node*);
+    static std::string find_leftmost_key(const Node*);
+    static void for_all(const Node*, std::string&, std::function<void(const std::string&)>&);
+    static void for_all_nodes(const Node*, std::function<void(const Node&)>&);
+};
+
+namespace btree_detail {
+
+inline size_t common_prefix(std::string_view a, std::string_view b) {
+    size_t len = std::min(a.size(), b.size());
+    return std::mismatch(a.begin(), a.begin() + len, b.begin()).first - a.begin();
+}
+
+} // namespace btree_detail
+
+template<size_t B>
+std::string StringBTreeNode<B>::key(size_t i) const {
+    std::string k;
+    k.reserve(prefix_len + suffix(i).size());
+    k.append(prefix()).append(suffix(i));
+    return k;
+}
+
+template<size_t B>
+std::vector<std::string> StringBTreeNode<B>::keys_from(size_t from) const {
+    std::vector<std::string> keys;
+    keys.reserve(n - from);
+
+    for (size_t i = from; i < n; i++)
+        keys.push_back(key(i));
+
+    return keys;
+}
+
+/* Same contract as BTreeNode::get_index: the first key not less than t */
+template<size_t B>
+size_t StringBTreeNode<B>::get_index(std::string_view t) const {
+    size_t p = std::min<size_t>(prefix_len, t.size());
+    int c = std::memcmp(t.data(), data.data(), p);
+
+    /* t sorts before (or after) the prefix, and so every key */
+    if (c < 0 || (c == 0 && t.size() < prefix_len))
+        return 0;
+    if (c > 0)
+        return n;
+
+    std::string_view rest = t.substr(prefix_len);
+    size_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (suffix(mid) < rest)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+template<size_t B>
+bool StringBTreeNode<B>::key_equals(size_t i, std::string_view t) const {
+    return t.size() == prefix_len + suffix(i).size()
+        && t.substr(0, prefix_len) == prefix()
+        && t.substr(prefix_len) == suffix(i);
+}
+
+template<size_t B>
+void StringBTreeNode<B>::insert_key(size_t i, std::string_view k) {
+    if (n == 0 || k.substr(0, prefix_len) != prefix()) {
+        std::vector<std::string> keys = keys_from(0);
+        keys.insert(keys.begin() + i, std::string(k));
+        assign(keys);
+        return;
+    }
+
+    uint32_t len = k.size() - prefix_len;
+    data.insert(offsets[i], k.data() + prefix_len, len);
+
+    for (size_t j = n + 1; j > i; j--)
+        offsets[j] = offsets[j - 1] + len;
+    n++;
+}
+
+template<size_t B>
+void StringBTreeNode<B>::erase_key(size_t i) {
+    uint32_t len = offsets[i + 1] - offsets[i];
+    data.erase(offsets[i], len);
+
+    for (size_t j = i + 1; j < n; j++)
+        offsets[j] = offsets[j + 1] - len;
+    n--;
+
+    if (i == 0 || i == n)
+        compact();
+}
+
+template<size_t B>
+void StringBTreeNode<B>::truncate(size_t m) {
+    data.resize(offsets[m]);
+    n = m;
+    compact();
+}
+
+template<size_t B>
+void StringBTreeNode<B>::assign(const std::vector<std::string>& keys) {
+    n = keys.size();
+    prefix_len = n ? btree_detail::common_prefix(keys.front(), keys.back()) : 0;
+
+    data.clear();
+    if (n)
+        data.append(keys.front(), 0, prefix_len);
+
+    for (size_t i = 0; i < n; i++) {
+        offsets[i] = data.size();
+        data.append(keys[i], prefix_len);
+    }
+    offsets[n] = data.size();
+}
+
+template<size_t B>
+void StringBTreeNode<B>::compact() {
+    if (n > 0 && btree_detail::common_prefix(suffix(0), suffix(n - 1)) > 0)
+        assign(keys_from(0));
+}
+
+template<size_t B>
+void StringBTree<B>::destroy(Node* node) {
+    if (node->type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= node->n; i++)
+            destroy(node->edges[i]);
+
+    delete node;
+}
+
+template<size_t B>
+bool StringBTree<B>::insert(std::string_view k) {
+    if (!root) {
+        root = new Node(NodeType::LEAF);
+        root->insert_key(0, k);
+        return true;
+    }
+
+    /* Make sure the root node is not full */
+    if (root->n >= 2 * B - 1) {
+        Node* new_root = new Node(NodeType::INTERNAL);
+        new_root->edges[0] = root;
+        split_child(*new_root, 0);
+        root = new_root;
+    }
+
+    Node* node = root;
+    while (node->type == NodeType::INTERNAL) {
+        size_t idx = node->get_index(k);
+
+        if (node->edges[idx]->n == 2 * B - 1) {
+            split_child(*node, idx);
+            idx = node->get_index(k);
+        }
+
+        node = node->edges[idx];
+    }
+
+    node->insert_key(node->get_index(k), k);
+    return true;
+}
+
+template<size_t B>
+bool StringBTree<B>::contains(std::string_view k) const {
+    for (const Node* node = root; node; ) {
+        size_t idx = node->get_index(k);
+
+        if (idx < node->n && node->key_equals(idx, k))
+            return true;
+
+        if (node->type == NodeType::LEAF)
+            return false;
+
+        node = node->edges[idx];
+    }
+
+    return false;
+}
+
+template<size_t B>
+bool StringBTree<B>::remove(std::string_view k) {
+    if (!root)
+        return false;
+
+    bool removed = remove(*root, k);
+
+    /* After merging, the size of the root may become 0. */
+    if (root->n == 0 && root->type == NodeType::INTERNAL) {
+        Node* prev_root = root;
+        root = root->edges[0];
+        delete prev_root;
+    }
+
+    return removed;
+}
+
+template<size_t B>
+bool StringBTree<B>::remove(Node& node, std::string_view k) {
+    size_t idx = node.get_index(k);
+
+    if (idx < node.n && node.key_equals(idx, k)) {
+        if (node.type == NodeType::LEAF) {
+            node.erase_key(idx);
+            return true;
+        }
+
+        if (node.edges[idx]->n >= B) {
+            std::string pred_key = find_rightmost_key(node.edges[idx]);
+            node.replace_key(idx, pred_key);
+            return remove(*node.edges[idx], pred_key);
+        }
+
+        if (node.edges[idx + 1]->n >= B) {
+            std::string succ_key = find_leftmost_key(node.edges[idx + 1]);
+            node.replace_key(idx, succ_key);
+            return remove(*node.edges[idx + 1], succ_key);
+        }
+
+        merge_children(node, idx);
+        return remove(*node.edges[idx], k);
+    }
+
+    if (node.type == NodeType::LEAF)
+        return false;
+
+    if (node.edges[idx]->n < B) {
+        if (idx != 0 && node.edges[idx - 1]->n >= B)
+            borrow_from_left(node, idx);
+        else if (idx != node.n && node.edges[idx + 1]->n >= B)
+            borrow_from_right(node, idx);
+        else
+            merge_children(node, idx != node.n ? idx : idx - 1);
+
+        idx = node.get_index(k);
+    }
+
+    return remove(*node.edges[idx], k);
+}
+
+/* Assume parent.edges[idx] is full and the parent is not. */
+template<size_t B>
+void StringBTree<B>::split_child(Node& parent, size_t idx) {
+    Node* y = parent.edges[idx];
+    Node* z = new Node(y->type);
+
+    std::string mid = y->key(B - 1);
+    z->assign(y->keys_from(B));
+
+    if (y->type == NodeType::INTERNAL)
+        std::copy(y->edges.begin() + B, y->edges.begin() + 2 * B, z->edges.begin());
+
+    y->truncate(B - 1);
+
+    std::copy_backward(parent.edges.begin() + idx + 1, parent.edges.begin() + parent.n + 1,
+                       parent.edges.begin() + parent.n + 2);
+    parent.edges[idx + 1] = z;
+    parent.insert_key(idx, mid);
+}
+
+template<size_t B>
+void StringBTree<B>::merge_children(Node& node, size_t idx) {
+    Node* child = node.edges[idx];
+    Node* sibling = node.edges[idx + 1];
+
+    std::vector<std::string> keys = child->keys_from(0);
+    keys.push_back(node.key(idx));
+    for (size_t i = 0; i < sibling->n; i++)
+        keys.push_back(sibling->key(i));
+
+    if (child->type == NodeType::INTERNAL)
+        std::copy(sibling->edges.begin(), sibling->edges.begin() + sibling->n + 1,
+                  child->edges.begin() + child->n + 1);
+
+    child->assign(keys);
+
+    std::copy(node.edges.begin() + idx + 2, node.edges.begin() + node.n + 1,
+              node.edges.begin() + idx + 1);
+    node.erase_key(idx);
+
+    /* The edges of the sibling now belong to the child */
+    delete sibling;
+}
+
+template<size_t B>
+void StringBTree<B>::borrow_from_right(Node& node, size_t e) {
+    Node* child = node.edges[e];
+    Node* sibling = node.edges[e + 1];
+
+    child->insert_key(child->n, node.key(e));
+    node.replace_key(e, sibling->key(0));
+
+    if (child->type == NodeType::INTERNAL) {
+        child->edges[child->n] = sibling->edges[0];
+        std::copy(sibling->edges.begin() + 1, sibling->edges.begin() + sibling->n + 1,
+                  sibling->edges.begin());
+    }
+
+    sibling->erase_key(0);
+}
+
+template<size_t B>
+void StringBTree<B>::borrow_from_left(Node& node, size_t e) {
+    Node* child = node.edges[e];
+    Node* sibling = node.edges[e - 1];
+
+    child->insert_key(0, node.key(e - 1));
+    node.replace_key(e - 1, sibling->key(sibling->n - 1));
+
+    if (child->type == NodeType::INTERNAL) {
+        std::copy_backward(child->edges.begin(), child->edges.begin() + child->n,
+                           child->edges.begin() + child->n + 1);
+        child->edges[0] = sibling->edges[sibling->n];
+    }
+
+    sibling->erase_key(sibling->n - 1);
+}
+
+template<size_t B>
+std::string StringBTree<B>::find_rightmost_key(const Node* node) {
+    while (node->type == NodeType::INTERNAL)
+        node = node->edges[node->n];
+
+    return node->key(node->n - 1);
+}
+
+template<size_t B>
+std::string StringBTree<B>::find_leftmost_key(const Node* node) {
+    while (node->type == NodeType::INTERNAL)
+        node = node->edges[0];
+
+    return node->key(0);
+}
+
+template<size_t B>
+void StringBTree<B>::for_all(std::function<void(const std::string&)> func) const {
+    std::string buffer;
+    if (root)
+        for_all(root, buffer, func);
+}
+
+template<size_t B>
+void StringBTree<B>::for_all(const Node* node, std::string& buffer,
+                             std::function<void(const std::string&)>& func) {
+    for (size_t i = 0; i <= node->n; i++) {
+        if (node->type == NodeType::INTERNAL)
+            for_all(node->edges[i], buffer, func);
+
+        if (i < node->n) {
+            buffer.assign(node->prefix()).append(node->suffix(i));
+            func(buffer);
+        }
+    }
+}
+
+template<size_t B>
+void StringBTree<B>::for_all_nodes(std::function<void(const Node&)> func) const {
+    if (root)
+        for_all_nodes(root, func);
+}
+
+template<size_t B>
+void StringBTree<B>::for_all_nodes(const Node* node, std::function<void(const Node&)>& func) {
+    func(*node);
+
+    if (node->type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= node->n; i++)
+            for_all_nodes(node->edges[i], func);
+}
+
+template<size_t B>
+const std::optional<size_t> StringBTree<B>::depth() const {
+    if (!root)
+        return std::nullopt;
+
+    size_t d = 0;
+    for (const Node* node = root; node->type == NodeType::INTERNAL; node = node->edges[0])
+        d++;
+
+    return d;
+}
+
+/* Heap blocks are counted at their capacity; a key buffer that still fits
+   in the small-string buffer costs nothing beyond the node. */
+template<size_t B>
+size_t StringBTree<B>::memory_bytes() const {
+    size_t bytes = 0;
+
+    for_all_nodes([&bytes](const Node& node) {
+        bytes += sizeof(Node) + node.edges.capacity() * sizeof(Node*);
+        if (node.data.capacity() > std::string().capacity())
+            bytes += node.data.capacity() + 1;
+    });
+
+    return bytes;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "betree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B, size_t BUF>
+static void check_structure(const BeTree<T, B, BUF>& tree) {
+    auto root = tree.root;
+    if (!root)
+        return;
+
+    size_t leaf_depth = *tree.depth();
+
+    /* Every leaf is at the same depth, and every key and message sits
+       between the separators that lead to it */
+    std::function<void(const BeTreeNode<T, B, BUF>*, size_t, bool,
+                       std::optional<T>, std::optional<T>)> visit =
+        [&](auto node, size_t d, bool only_child, std::optional<T> lo, std::optional<T> hi) {
+            auto in_range = [&](const T& t) {
+                return (!lo || !(t < *lo)) && (!hi || t < *hi);
+            };
+
+            REQUIRE(node->n <= 2 * B - 1);
+            REQUIRE(std::is_sorted(node->keys.begin(), node->keys.begin() + node->n));
+            for (size_t i = 0; i < node->n; i++)
+                REQUIRE(in_range(node->keys[i]));
+
+            if (node->type == NodeType::LEAF) {
+                REQUIRE(d == leaf_depth);
+                /* Empty leaves go away, unless nothing could take their range */
+                REQUIRE((only_child || node->n > 0));
+                return;
+            }
+
+            auto& inner = node->internal();
+            REQUIRE(inner.pending <= BUF);
+            for (size_t i = 0; i < inner.pending; i++) {
+                REQUIRE(in_range(inner.messages[i]));
+                if (i > 0)
+                    REQUIRE(inner.messages[i - 1] < inner.messages[i]);
+            }
+
+            for (size_t i = 0; i <= node->n; i++)
+                visit(node->edge(i), d + 1, node->n == 0,
+                      i == 0 ? lo : std::optional<T>(node->keys[i - 1]),
+                      i == node->n ? hi : std::optional<T>(node->keys[i]));
+        };
+
+    visit(root, 0, true, std::nullopt, std::nullopt);
+}
+
+TEST_CASE("Bε-tree behaves like a set", "[betree]") {
+    BeTree<int, 3, 8> tree;
+    std::set<int> ref;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 5'000);
+
+    for (auto i = 0; i < 200'000; i++) {
+        int k = key(g);
+        switch (g() % 4) {
+        case 0:
+            tree.remove(k);
+            ref.erase(k);
+            break;
+        case 1:
+        case 2:
+            tree.insert(k);
+            ref.insert(k);
+            break;
+        default:
+            REQUIRE(tree.contains(k) == (ref.count(k) == 1));
+        }
+
+        if (i % 10'000 == 0)
+            check_structure(tree);
+    }
+
+    check_structure(tree);
+
+    std::vector<int> xs;
+    tree.for_all([&xs](const int& t) { xs.push_back(t); });
+    REQUIRE(xs == std::vector<int>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("Bε-tree drains to nothing", "[betree]") {
+    BeTree<int, 4, 16> tree;
+
+    std::vector<int> keys(20'000);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::mt19937 g(1);
+    std::shuffle(keys.begin(), keys.end(), g);
+
+    for (auto k : keys)
+        tree.insert(k);
+    for (auto k : keys)
+        REQUIRE(tree.contains(k));
+
+    std::shuffle(keys.begin(), keys.end(), g);
+    for (auto k : keys)
+        tree.remove(k);
+
+    /* Push the erase messages down with some more traffic */
+    for (auto k : keys)
+        tree.remove(k + 1'000'000);
+
+    for (auto k : keys)
+        REQUIRE_FALSE(tree.contains(k));
+
+    check_structure(tree);
+
+    size_t count = 0;
+    tree.for_all([&count](const int&) { count++; });
+    REQUIRE(count == 0);
+}
+
+TEST_CASE("Bε-tree batches leaf writes", "[betree]") {
+    BeTree<uint64_t> tree;
+    std::mt19937_64 g(2);
+
+    static constexpr size_t N = 200'000;
+    for (size_t i = 0; i < N; i++)
+        tree.insert(g());
+
+    check_structure(tree);
+    REQUIRE(tree.stats.leaf_writes < N / 4);
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <vector>
+#include <random>
+#include <set>
+
+#include "bplustree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B>
+static void check_utilization(const BPlusTree<T, B>& tree) {
+    bool root_visited = false;
+    size_t leaf_depth = 0;
+    bool leaf_seen = false;
+
+    std::function<void(const BPlusTreeNode<T, B>*, size_t)> visit =
+        [&](const BPlusTreeNode<T, B>* node, size_t d) {
+            if (node != tree.root)
+                REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+            else
+                root_visited = true;
+
+            if (node->type == NodeType::LEAF) {
+                /* Perfect balance */
+                if (!leaf_seen)
+                    leaf_depth = d;
+                leaf_seen = true;
+                REQUIRE(leaf_depth == d);
+            } else {
+                for (size_t i = 0; i <= node->n; i++)
+                    visit(node->edge(i), d + 1);
+            }
+        };
+
+    if (tree.root)
+        visit(tree.root, 0);
+}
+
+TEST_CASE("B+ tree insert, remove and full scan", "[bplustree]") {
+    BPlusTree<int, 3> tree;
+    std::set<int> ref;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 20'000);
+
+    for (auto i = 0; i < 100'000; i++) {
+        int k = key(g);
+        if (g() % 3 == 0)
+            REQUIRE(tree.remove(k) == (ref.erase(k) == 1));
+        else
+            REQUIRE(tree.insert(k) == ref.insert(k).second);
+    }
+
+    check_utilization(tree);
+
+    std::vector<int> xs(tree.begin(), tree.end());
+    REQUIRE(xs == std::vector<int>(ref.begin(), ref.end()));
+
+    for (auto k = -1; k <= 20'001; k += 7)
+        REQUIRE(tree.contains(k) == (ref.count(k) == 1));
+}
+
+TEST_CASE("B+ tree range cursor", "[bplustree]") {
+    BPlusTree<int> tree;
+    std::vector<int> xs;
+    size_t N = 50'000;
+
+    for (auto i = 0; i < N; i++)
+        xs.push_back(i * 2);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::shuffle(xs.begin(), xs.end(), g);
+
+    for (auto i : xs)
+        tree.insert(i);
+
+    std::uniform_int_distribution<int> bound(-10, 2 * N + 10);
+    for (auto r = 0; r < 1'000; r++) {
+        int lo = bound(g), hi = bound(g);
+
+        std::vector<int> expected;
+        for (int k = std::max(lo, 0); k < hi && k < 2 * (int)N; k++)
+            if (k % 2 == 0)
+                expected.push_back(k);
+
+        auto range = tree.range(lo, hi);
+        std::vector<int> got(range.begin(), range.end());
+
+        REQUIRE(got == expected);
+        REQUIRE(range.empty() == expected.empty());
+    }
+
+    /* The range survives deletions that empty leaves and shrink the tree */
+    for (auto i : xs)
+        if (i % 4 != 0)
+            tree.remove(i);
+
+    auto range = tree.range(100, 200);
+    std::vector<int> got(range.begin(), range.end());
+    std::vector<int> expected;
+    for (int k = 100; k < 200; k += 4)
+        expected.push_back(k);
+
+    REQUIRE(got == expected);
+    check_utilization(tree);
+}
+
+TEST_CASE("B+ tree removing everything", "[bplustree]") {
+    BPlusTree<int, 2> tree;
+    std::vector<int> xs(10'000);
+
+    std::iota(xs.begin(), xs.end(), 0);
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::shuffle(xs.begin(), xs.end(), g);
+
+    for (auto i : xs)
+        REQUIRE(tree.insert(i));
+
+    REQUIRE(tree.depth().value() > 0);
+
+    std::shuffle(xs.begin(), xs.end(), g);
+    for (auto i : xs)
+        REQUIRE(tree.remove(i));
+
+    REQUIRE(tree.depth().value() == 0);
+    REQUIRE(tree.root->n == 0);
+    REQUIRE(tree.begin() == tree.end());
+    REQUIRE(tree.range(0, 100).empty());
+}
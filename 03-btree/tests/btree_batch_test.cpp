@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+/* Occupancy, equal leaf depths and (when counted) edge counts of a subtree;
+   return its number of keys */
+template<typename T, size_t B, typename Traits>
+static size_t check_subtree(const BTreeNode<T, B, Traits>* node, bool is_root,
+                            size_t level, size_t& leaf_level) {
+    if (!is_root)
+        REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+    REQUIRE(std::is_sorted(node->keys.begin(), node->keys.begin() + node->n));
+
+    if (node->type == NodeType::LEAF) {
+        if (leaf_level == SIZE_MAX)
+            leaf_level = level;
+        REQUIRE(level == leaf_level);
+        return node->n;
+    }
+
+    REQUIRE(node->n > 0);
+
+    size_t total = node->n;
+    for (size_t i = 0; i <= node->n; i++) {
+        size_t below = check_subtree(node->edge(i), false, level + 1, leaf_level);
+        if constexpr (Traits::counted)
+            REQUIRE(node->count(i) == below);
+        total += below;
+    }
+
+    return total;
+}
+
+template<typename T, size_t B, typename Traits>
+static void check_tree(BTree<T, B, Traits>& tree, const std::multiset<T>& ref) {
+    REQUIRE(std::vector<T>(tree.begin(), tree.end()) == std::vector<T>(ref.begin(), ref.end()));
+
+    if (tree.root) {
+        size_t leaf_level = SIZE_MAX;
+        REQUIRE(check_subtree(tree.root, true, 0, leaf_level) == ref.size());
+    }
+}
+
+template<typename Traits, size_t B>
+static void batches(unsigned seed, int range, size_t max_batch) {
+    BTree<int, B, Traits> tree;
+    std::multiset<int> ref;
+
+    std::mt19937 g(seed);
+    std::uniform_int_distribution<int> key(0, range);
+
+    for (auto round = 0; round < 60; round++) {
+        std::vector<int> batch(g() % max_batch);
+        for (auto& k : batch)
+            k = key(g);
+        std::sort(batch.begin(), batch.end());
+
+        if (g() % 3 != 0) {
+            tree.insert_batch(batch.begin(), batch.end());
+            ref.insert(batch.begin(), batch.end());
+        } else {
+            size_t expected = 0;
+            for (int k : batch) {
+                auto it = ref.find(k);
+                if (it != ref.end()) {
+                    ref.erase(it);
+                    expected++;
+                }
+            }
+
+            REQUIRE(tree.remove_batch(batch.begin(), batch.end()) == expected);
+        }
+
+        check_tree(tree, ref);
+    }
+
+    /* Empty the tree in one go */
+    std::vector<int> all(ref.begin(), ref.end());
+    REQUIRE(tree.remove_batch(all.begin(), all.end()) == all.size());
+    ref.clear();
+    check_tree(tree, ref);
+}
+
+TEST_CASE("Batches keep the B-tree invariants", "[batch]") {
+    for (unsigned seed = 0; seed < 10; seed++) {
+        batches<BTreeTraits, 2>(seed, 1000, 300);
+        batches<BTreeTraits, 3>(seed, 100, 50);
+        batches<BTreeTraits, 6>(seed, 100000, 5000);
+    }
+}
+
+TEST_CASE("Batches keep the edge counts", "[batch]") {
+    for (unsigned seed = 0; seed < 10; seed++) {
+        batches<BTreeCountedTraits, 2>(seed, 1000, 300);
+        batches<BTreeCountedTraits, 5>(seed, 50000, 3000);
+    }
+}
+
+TEST_CASE("Batches mix with single inserts and removes", "[batch]") {
+    BTree<int, 3> tree;
+    std::multiset<int> ref;
+
+    for (int i = 0; i < 2000; i++) {
+        tree.insert(3 * i);
+        ref.insert(3 * i);
+    }
+
+    /* Every separator is in this batch */
+    std::vector<int> evens;
+    for (int i = 0; i < 6000; i += 2)
+        evens.push_back(i);
+
+    size_t expected = 0;
+    for (int k : evens)
+        expected += ref.erase(k);
+
+    REQUIRE(tree.remove_batch(evens.begin(), evens.end()) == expected);
+    check_tree(tree, ref);
+
+    std::vector<int> odds;
+    for (int i = 1; i < 6000; i += 2)
+        odds.push_back(i);
+
+    tree.insert_batch(odds.begin(), odds.end());
+    ref.insert(odds.begin(), odds.end());
+    check_tree(tree, ref);
+
+    for (int i = 0; i < 6000; i += 7) {
+        tree.remove(i);
+        if (ref.count(i))
+            ref.erase(ref.find(i));
+    }
+    check_tree(tree, ref);
+}
+
+TEST_CASE("Batches leave snapshots alone", "[batch]") {
+    BTree<int, 3, BTreeCowTraits> tree;
+
+    std::vector<int> xs(5000);
+    for (int i = 0; i < 5000; i++)
+        xs[i] = 2 * i;
+
+    tree.insert_batch(xs.begin(), xs.end());
+    auto snapshot = tree.snapshot();
+
+    std::vector<int> odds(xs);
+    for (auto& x : odds)
+        x++;
+
+    tree.insert_batch(odds.begin(), odds.end());
+    REQUIRE(tree.remove_batch(xs.begin(), xs.end()) == xs.size());
+
+    REQUIRE(std::vector<int>(snapshot->begin(), snapshot->end()) == xs);
+    REQUIRE(std::vector<int>(tree.begin(), tree.end()) == odds);
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <vector>
+#include <random>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+/* In-order keys, occupancy and perfect balance of a bulk-loaded tree */
+template<typename T, size_t B>
+static void check_tree(BTree<T, B>& btree, const std::vector<T>& xs) {
+    std::vector<T> ys;
+    btree.for_all([&ys](T& t){ ys.push_back(t); });
+    REQUIRE(xs == ys);
+
+    if (xs.empty()) {
+        REQUIRE(btree.root == nullptr);
+        return;
+    }
+
+    btree.for_all_nodes([&btree](const BTreeNode<T, B>& bn) {
+        if (&bn != btree.root)
+            REQUIRE((B - 1 <= bn.n && bn.n <= 2 * B - 1));
+    });
+
+    auto depth = btree.depth().value();
+    for (auto i = 0; i < depth; i++)
+        for (auto node : btree.root->find_nodes_at_level(i))
+            REQUIRE(node->type == NodeType::INTERNAL);
+
+    for (auto node : btree.root->find_nodes_at_level(depth))
+        REQUIRE(node->type == NodeType::LEAF);
+}
+
+template<size_t B>
+static void check_sizes(double fill_factor, size_t threads) {
+    for (size_t n = 0; n < 2'000; n += (n < 100 ? 1 : 97)) {
+        std::vector<int> xs(n);
+        std::iota(xs.begin(), xs.end(), 1);
+
+        BTree<int, B> btree;
+        btree.bulk_load(xs.begin(), xs.end(), fill_factor, threads);
+
+        check_tree(btree, xs);
+    }
+}
+
+TEST_CASE("Bulk load keeps the B-tree invariants", "[bulk_load]") {
+    for (double ff : {0.0, 0.5, 0.75, 1.0}) {
+        check_sizes<2>(ff, 1);
+        check_sizes<3>(ff, 1);
+        check_sizes<6>(ff, 1);
+        check_sizes<16>(ff, 1);
+    }
+}
+
+TEST_CASE("Multi-threaded bulk load", "[bulk_load]") {
+    check_sizes<6>(1.0, 4);
+
+    BTree<int> btree;
+    std::vector<int> xs(1'000'000);
+    std::iota(xs.begin(), xs.end(), 0);
+
+    btree.bulk_load(xs.begin(), xs.end(), 0.9, 8);
+    check_tree(btree, xs);
+}
+
+TEST_CASE("Bulk load packs nodes fuller than inserting", "[bulk_load]") {
+    static constexpr size_t B = 6;
+    std::vector<int> xs(100'000);
+    std::iota(xs.begin(), xs.end(), 0);
+
+    BTree<int, B> inserted, loaded;
+    for (auto i : xs)
+        inserted.insert(i);
+    loaded.bulk_load(xs.begin(), xs.end());
+
+    size_t inserted_nodes = 0, loaded_nodes = 0;
+    inserted.for_all_nodes([&](const BTreeNode<int, B>&) { inserted_nodes++; });
+    loaded.for_all_nodes([&](const BTreeNode<int, B>&) { loaded_nodes++; });
+
+    /* With fill factor 1, every node is (nearly) full */
+    REQUIRE(loaded_nodes * (2 * B - 1) < xs.size() * 11 / 10);
+    REQUIRE(loaded_nodes < inserted_nodes);
+}
+
+TEST_CASE("Insert and remove after bulk load", "[bulk_load]") {
+    BTree<int, 3> btree;
+    std::vector<int> xs;
+
+    for (auto i = 0; i < 50'000; i++)
+        xs.push_back(i * 2);
+
+    btree.bulk_load(xs.begin(), xs.end(), 1.0);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::vector<int> odd;
+    for (auto i = 0; i < 50'000; i++)
+        odd.push_back(i * 2 + 1);
+    std::shuffle(odd.begin(), odd.end(), g);
+
+    for (auto i : odd)
+        btree.insert(i);
+
+    std::vector<int> evens(xs);
+    std::shuffle(evens.begin(), evens.end(), g);
+    for (auto i : evens)
+        btree.remove(i);
+
+    std::sort(odd.begin(), odd.end());
+    check_tree(btree, odd);
+
+    /* Loading again replaces the contents */
+    btree.bulk_load(xs.begin(), xs.begin() + 10);
+    check_tree(btree, std::vector<int>(xs.begin(), xs.begin() + 10));
+}
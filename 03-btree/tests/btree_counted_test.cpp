@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B>
+using CountedBTree = BTree<T, B, BTreeCountedTraits>;
+
+/* Every edge count matches the keys actually below it */
+template<typename T, size_t B>
+static size_t check_counts(const BTreeNode<T, B, BTreeCountedTraits>* node) {
+    if (node->type == NodeType::LEAF)
+        return node->n;
+
+    size_t total = node->n;
+    for (size_t i = 0; i <= node->n; i++) {
+        size_t below = check_counts(node->edge(i));
+        REQUIRE(node->count(i) == below);
+        total += below;
+    }
+
+    return total;
+}
+
+template<typename T, size_t B>
+static void check_order_statistics(const CountedBTree<T, B>& tree, const std::multiset<T>& ref) {
+    if (tree.root)
+        REQUIRE(check_counts<T, B>(tree.root) == ref.size());
+    REQUIRE(tree.size() == ref.size());
+
+    std::vector<T> sorted(ref.begin(), ref.end());
+    for (size_t k = 0; k < sorted.size(); k++)
+        REQUIRE(tree.select(k) == sorted[k]);
+    REQUIRE_FALSE(tree.select(sorted.size()).has_value());
+}
+
+TEST_CASE("Counts survive inserts and removes", "[counted]") {
+    CountedBTree<int, 2> tree;
+    std::multiset<int> ref;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 500);
+
+    for (auto round = 0; round < 50; round++) {
+        for (auto i = 0; i < 200; i++) {
+            int k = key(g);
+            if (g() % 5 < 3) {
+                tree.insert(k);
+                ref.insert(k);
+            } else if (ref.count(k)) {
+                tree.remove(k);
+                ref.erase(ref.find(k));
+            } else {
+                /* Missing keys may still reshape the path */
+                tree.remove(k);
+            }
+        }
+
+        check_order_statistics(tree, ref);
+
+        for (int t = -1; t <= 501; t += 7) {
+            auto lo = std::distance(ref.begin(), ref.lower_bound(t));
+            REQUIRE(tree.rank(t) == static_cast<size_t>(lo));
+            REQUIRE(tree.count_range(t, t + 20) ==
+                    static_cast<size_t>(std::distance(ref.lower_bound(t), ref.lower_bound(t + 20))));
+        }
+    }
+}
+
+TEST_CASE("Counts with find_or_insert and bulk_load", "[counted]") {
+    CountedBTree<int, 3> tree;
+
+    std::vector<int> keys(10'000);
+    std::iota(keys.begin(), keys.end(), 0);
+    tree.bulk_load(keys.begin(), keys.end(), 0.7);
+
+    std::multiset<int> ref(keys.begin(), keys.end());
+    check_order_statistics(tree, ref);
+
+    std::mt19937 g(11);
+    for (auto i = 0; i < 5'000; i++) {
+        int k = g() % 20'000;
+        bool inserted = tree.find_or_insert(k).second;
+        REQUIRE(inserted == (ref.count(k) == 0));
+        if (inserted)
+            ref.insert(k);
+    }
+
+    check_order_statistics(tree, ref);
+
+    /* Percentiles */
+    std::vector<int> sorted(ref.begin(), ref.end());
+    for (auto p : {0, 25, 50, 90, 99})
+        REQUIRE(*tree.select(sorted.size() * p / 100) == sorted[sorted.size() * p / 100]);
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B>
+using CowBTree = BTree<T, B, BTreeCowTraits>;
+
+struct CowCountedTraits : BTreeTraits {
+    static constexpr bool counted = true;
+    static constexpr bool cow = true;
+};
+
+template<typename T, size_t B, typename Traits>
+static std::vector<T> contents(const BTree<T, B, Traits>& tree) {
+    return std::vector<T>(tree.begin(), tree.end());
+}
+
+template<typename T, size_t B, typename Traits>
+static void collect_nodes(const BTreeNode<T, B, Traits>* node,
+                          std::unordered_set<const void*>& nodes) {
+    nodes.insert(node);
+    if (node->type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= node->n; i++)
+            collect_nodes(node->edge(i), nodes);
+}
+
+template<typename T, size_t B, typename Traits>
+static void require_unshared(const BTreeNode<T, B, Traits>* node) {
+    REQUIRE(node->refs.load() == 1);
+    if (node->type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= node->n; i++)
+            require_unshared(node->edge(i));
+}
+
+TEST_CASE("Snapshots do not see later writes", "[cow]") {
+    CowBTree<int, 2> tree;
+    std::multiset<int> ref;
+
+    std::mt19937 g(7);
+    std::uniform_int_distribution<int> key(0, 400);
+
+    std::vector<std::shared_ptr<const CowBTree<int, 2>>> snapshots;
+    std::vector<std::vector<int>> expected;
+
+    for (auto round = 0; round < 30; round++) {
+        for (auto i = 0; i < 100; i++) {
+            int k = key(g);
+            if (g() % 3 != 0) {
+                tree.insert(k);
+                ref.insert(k);
+            } else if (ref.count(k)) {
+                tree.remove(k);
+                ref.erase(ref.find(k));
+            }
+        }
+
+        snapshots.push_back(tree.snapshot());
+        expected.emplace_back(ref.begin(), ref.end());
+
+        /* Drop some versions along the way */
+        if (round % 4 == 3) {
+            snapshots.erase(snapshots.begin() + round % snapshots.size());
+            expected.erase(expected.begin() + round % expected.size());
+        }
+    }
+
+    REQUIRE(contents(tree) == std::vector<int>(ref.begin(), ref.end()));
+
+    for (size_t s = 0; s < snapshots.size(); s++) {
+        REQUIRE(contents(*snapshots[s]) == expected[s]);
+        for (int k : expected[s])
+            REQUIRE(snapshots[s]->contains(k));
+    }
+
+    snapshots.clear();
+    if (tree.root)
+        require_unshared(tree.root);
+}
+
+TEST_CASE("Snapshots of an empty tree", "[cow]") {
+    CowBTree<int, 3> tree;
+    auto empty = tree.snapshot();
+
+    for (int i = 0; i < 100; i++)
+        tree.insert(i);
+
+    auto full = tree.snapshot();
+
+    for (int i = 0; i < 100; i++)
+        tree.remove(i);
+
+    REQUIRE(empty->begin() == empty->end());
+    REQUIRE(contents(*full).size() == 100);
+    REQUIRE(tree.begin() == tree.end());
+}
+
+TEST_CASE("A write copies only its path", "[cow]") {
+    CowBTree<int, 3> tree;
+    for (int i = 0; i < 10000; i++)
+        tree.insert(2 * i);
+
+    auto snapshot = tree.snapshot();
+
+    std::unordered_set<const void*> before;
+    collect_nodes(tree.root, before);
+
+    tree.insert(5001);
+
+    std::unordered_set<const void*> after;
+    collect_nodes(tree.root, after);
+
+    size_t copied = 0;
+    for (auto node : after)
+        if (!before.count(node))
+            copied++;
+
+    /* The path, plus at most one node from splitting a full one */
+    REQUIRE(copied <= *tree.depth() + 2);
+    REQUIRE_FALSE(snapshot->contains(5001));
+    REQUIRE(tree.contains(5001));
+}
+
+TEST_CASE("Snapshots of a counted tree keep their order statistics", "[cow]") {
+    BTree<int, 2, CowCountedTraits> tree;
+    for (int i = 0; i < 1000; i++)
+        tree.insert(i);
+
+    auto snapshot = tree.snapshot();
+
+    for (int i = 0; i < 1000; i += 2)
+        tree.remove(i);
+
+    REQUIRE(snapshot->size() == 1000);
+    REQUIRE(snapshot->select(500) == 500);
+    REQUIRE(tree.size() == 500);
+    REQUIRE(tree.select(0) == 1);
+    REQUIRE(tree.rank(500) == 250);
+}
+
+TEST_CASE("Readers iterate snapshots while the writer goes on", "[cow]") {
+    CowBTree<int, 4> tree;
+    for (int i = 0; i < 5000; i++)
+        tree.insert(i);
+
+    std::shared_ptr<const CowBTree<int, 4>> latest = tree.snapshot();
+    std::atomic<bool> done{false};
+    std::atomic<size_t> checked{0};
+    std::atomic<size_t> broken{0};
+
+    /* Catch assertions are not thread-safe, so the reader only counts */
+    std::thread reader([&] {
+        while (!done.load() || checked.load() == 0) {
+            auto version = std::atomic_load(&latest);
+
+            std::vector<int> keys(version->begin(), version->end());
+            if (keys.size() != 5000 || !std::is_sorted(keys.begin(), keys.end())
+                || keys.back() - keys.front() != 4999)
+                broken++;
+            checked++;
+        }
+    });
+
+    /* Every version holds 5000 consecutive keys */
+    for (int step = 0; step < 5000; step++) {
+        tree.remove(step);
+        tree.insert(step + 5000);
+        std::atomic_store(&latest, tree.snapshot());
+    }
+
+    done.store(true);
+    reader.join();
+
+    REQUIRE(checked.load() > 0);
+    REQUIRE(broken.load() == 0);
+}
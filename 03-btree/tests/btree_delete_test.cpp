@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <iterator>
+#include <set>
+#include <string>
 #include <vector>
 #include <random>
 
@@ -120,3 +122,230 @@ TEST_CASE("Node utilization after deletions", "[btree]") {
                                 return false;
                             }}));
 }
+
+TEST_CASE("Freed nodes are reused by the node pool", "[btree]") {
+    BTree<std::string, 3> btree;
+    std::vector<std::string> xs, ys;
+    size_t N = 20'000;
+
+    for (auto i = 0; i < N; i++)
+        xs.push_back(std::to_string(i) + std::string(20, 'x'));
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(xs.begin(), xs.end(), g);
+    for (auto& x : xs)
+        btree.insert(x);
+
+    auto slabs = btree.pool.num_slabs();
+    REQUIRE(slabs > 0);
+
+    /* Churn: the same insertion order builds the same tree again, entirely
+       out of recycled nodes */
+    ys = xs;
+    for (auto round = 0; round < 3; round++) {
+        std::shuffle(ys.begin(), ys.end(), g);
+        for (auto& y : ys)
+            btree.remove(y);
+
+        REQUIRE(btree.root->n == 0);
+
+        for (auto& x : xs)
+            btree.insert(x);
+    }
+
+    REQUIRE(btree.pool.num_slabs() == slabs);
+
+    std::vector<std::string> zs;
+    btree.for_all([&zs](std::string& s){ zs.push_back(s); });
+    std::sort(xs.begin(), xs.end());
+    REQUIRE(xs == zs);
+}
+
+/* Occupancy, equal leaf depths and (when counted) edge counts of a subtree;
+   return its number of keys */
+template<typename T, size_t B, typename Traits>
+static size_t check_subtree(const BTreeNode<T, B, Traits>* node, bool is_root,
+                            size_t level, size_t& leaf_level) {
+    if (!is_root)
+        REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+
+    if (node->type == NodeType::LEAF) {
+        if (leaf_level == SIZE_MAX)
+            leaf_level = level;
+        REQUIRE(level == leaf_level);
+        return node->n;
+    }
+
+    size_t total = node->n;
+    for (size_t i = 0; i <= node->n; i++) {
+        size_t below = check_subtree(node->edge(i), false, level + 1, leaf_level);
+        if constexpr (Traits::counted)
+            REQUIRE(node->count(i) == below);
+        total += below;
+    }
+
+    return total;
+}
+
+template<typename Traits, size_t B>
+static void erase_ranges(unsigned seed, int range) {
+    BTree<int, B, Traits> tree;
+    std::multiset<int> ref;
+    std::mt19937 g(seed);
+
+    for (auto round = 0; round < 200; round++) {
+        for (auto i = g() % 500; i > 0; i--) {
+            int k = g() % range;
+            tree.insert(k);
+            ref.insert(k);
+        }
+
+        int lo = int(g() % (range + 2)) - 1;
+        int hi = lo + int(g() % (range / (1 + g() % 8) + 1));
+
+        size_t expected = 0;
+        if (lo < hi) {
+            auto first = ref.lower_bound(lo), last = ref.lower_bound(hi);
+            expected = std::distance(first, last);
+            ref.erase(first, last);
+        }
+
+        REQUIRE(tree.erase_range(lo, hi) == expected);
+        REQUIRE(std::vector<int>(tree.begin(), tree.end()) == std::vector<int>(ref.begin(), ref.end()));
+
+        if (tree.root) {
+            size_t leaf_level = SIZE_MAX;
+            REQUIRE(check_subtree(tree.root, true, 0, leaf_level) == ref.size());
+        }
+    }
+}
+
+TEST_CASE("Range erase against std::multiset", "[btree]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        erase_ranges<BTreeTraits, 2>(seed, 2000);
+        erase_ranges<BTreeTraits, 3>(seed, 100);
+        erase_ranges<BTreeTraits, 16>(seed, 100000);
+        erase_ranges<BTreeCountedTraits, 2>(seed, 2000);
+        erase_ranges<BTreeCountedTraits, 6>(seed, 5000);
+    }
+}
+
+TEST_CASE("Range erase hands whole subtrees back to the node pool", "[btree]") {
+    BTree<std::string, 3> btree;
+    std::vector<std::string> xs;
+
+    for (auto i = 0; i < 20'000; i++)
+        xs.push_back(std::to_string(100'000 + i) + std::string(20, 'x'));
+    for (auto& x : xs)
+        btree.insert(x);
+
+    auto slabs = btree.pool.num_slabs();
+
+    for (auto round = 0; round < 3; round++) {
+        REQUIRE(btree.erase_range(xs[1000], xs[19'000]) == 18'000);
+        REQUIRE(std::distance(btree.begin(), btree.end()) == 2000);
+
+        for (auto i = 1000; i < 19'000; i++)
+            btree.insert(xs[i]);
+    }
+
+    REQUIRE(btree.pool.num_slabs() == slabs);
+    REQUIRE(std::vector<std::string>(btree.begin(), btree.end()) == xs);
+
+    REQUIRE(btree.erase_range(xs.front(), xs.back() + "~") == 20'000);
+    REQUIRE(btree.begin() == btree.end());
+    REQUIRE(btree.erase_range(xs.front(), xs.back()) == 0);
+}
+
+TEST_CASE("Range erase leaves snapshots alone", "[btree]") {
+    BTree<int, 4, BTreeCowTraits> tree;
+    std::vector<int> xs;
+
+    for (auto i = 0; i < 10'000; i++) {
+        xs.push_back(i);
+        tree.insert(i);
+    }
+
+    auto snapshot = tree.snapshot();
+    REQUIRE(tree.erase_range(2500, 7500) == 5000);
+
+    std::vector<int> rest(xs.begin(), xs.begin() + 2500);
+    rest.insert(rest.end(), xs.begin() + 7500, xs.end());
+
+    REQUIRE(std::vector<int>(tree.begin(), tree.end()) == rest);
+    REQUIRE(std::vector<int>(snapshot->begin(), snapshot->end()) == xs);
+}
+
+template<typename Traits, size_t B>
+static void remove_results(unsigned seed) {
+    BTree<int, B, Traits> tree;
+    std::multiset<int> ref;
+    std::mt19937 g(seed);
+
+    for (auto round = 0; round < 20; round++) {
+        for (auto i = 0; i < 2000; i++) {
+            int k = g() % 4000;
+
+            if (g() % 2) {
+                tree.insert(k);
+                ref.insert(k);
+            } else {
+                auto it = ref.find(k);
+                REQUIRE(tree.remove(k) == (it != ref.end()));
+                if (it != ref.end())
+                    ref.erase(it);
+            }
+        }
+
+        REQUIRE(std::vector<int>(tree.begin(), tree.end()) == std::vector<int>(ref.begin(), ref.end()));
+
+        size_t leaf_level = SIZE_MAX;
+        REQUIRE(check_subtree(tree.root, true, 0, leaf_level) == ref.size());
+    }
+}
+
+TEST_CASE("Remove reports whether the key was there", "[btree]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        remove_results<BTreeTraits, 2>(seed);
+        remove_results<BTreeCountedTraits, 3>(seed);
+        remove_results<BTreeCowTraits, 2>(seed);
+        remove_results<BTreeFilteredTraits, 4>(seed);
+        remove_results<BTreeTraits, 16>(seed);
+    }
+}
+
+TEST_CASE("Removing a missing key writes nothing", "[btree]") {
+    BTree<int, 2, BTreeStatsTraits> tree;
+    for (auto i = 0; i < 10'000; i += 2)
+        tree.insert(i);
+
+    /* Leave most nodes with B - 1 keys, which a remove on the way down
+       would have merged or borrowed into */
+    for (auto i = 0; i < 10'000; i += 8)
+        tree.remove(i);
+
+    tree.reset_stats();
+    for (auto i = -1; i < 10'000; i += 2)
+        REQUIRE_FALSE(tree.remove(i));
+
+    const BTreeStats& s = tree.stats();
+    REQUIRE(s.merges == 0);
+    REQUIRE(s.borrows_left + s.borrows_right == 0);
+    REQUIRE(s.nodes_freed == 0);
+    REQUIRE(s.root_shrinks == 0);
+
+    /* A copy-on-write tree keeps sharing every node with its snapshot */
+    BTree<int, 2, BTreeCowTraits> cow;
+    for (auto i = 0; i < 10'000; i += 2)
+        cow.insert(i);
+
+    auto snapshot = cow.snapshot();
+    for (auto i = 1; i < 10'000; i += 2)
+        REQUIRE_FALSE(cow.remove(i));
+
+    REQUIRE(cow.root == snapshot->root);
+    REQUIRE(cow.remove(0));
+    REQUIRE(cow.root != snapshot->root);
+}
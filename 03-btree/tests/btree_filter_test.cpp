@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+struct FilteredCountedTraits : BTreeFilteredTraits {
+    static constexpr bool counted = true;
+};
+
+/* Every key of the tree must pass the filter */
+template<typename T, size_t B, typename Traits>
+static void check_filter(const BTree<T, B, Traits>& tree, const std::multiset<T>& ref) {
+    REQUIRE(std::vector<T>(tree.begin(), tree.end()) == std::vector<T>(ref.begin(), ref.end()));
+
+    for (const T& k : ref)
+        REQUIRE(tree.filter.may_contain(btree_detail::filter_hash(k)));
+}
+
+/* The fraction of keys outside [0, range) the filter lets through */
+template<typename T, size_t B, typename Traits>
+static double false_positive_rate(const BTree<T, B, Traits>& tree, int range) {
+    size_t passed = 0;
+    for (int i = 0; i < 100'000; i++)
+        passed += tree.filter.may_contain(btree_detail::filter_hash(range + i));
+
+    return passed / 100'000.0;
+}
+
+TEST_CASE("BlockedBloomFilter has no false negatives", "[filter]") {
+    for (size_t capacity : { 0, 1000, 5000, 100'000 }) {
+        BlockedBloomFilter filter(capacity);
+        REQUIRE(filter.capacity() >= std::max(capacity, BlockedBloomFilter::min_capacity));
+
+        for (uint64_t i = 0; i < filter.capacity(); i++)
+            filter.add(btree_detail::filter_hash(i));
+        for (uint64_t i = 0; i < filter.capacity(); i++)
+            REQUIRE(filter.may_contain(btree_detail::filter_hash(i)));
+
+        size_t passed = 0;
+        for (uint64_t i = 0; i < 100'000; i++)
+            passed += filter.may_contain(btree_detail::filter_hash(i + (uint64_t(1) << 40)));
+
+        REQUIRE(passed < 1000);
+        REQUIRE_FALSE(filter.stale());
+    }
+}
+
+TEST_CASE("Merged filters answer for the keys of both", "[filter]") {
+    for (size_t a : { 100, 3000, 50'000 }) {
+        for (size_t b : { 100, 3000, 50'000 }) {
+            BlockedBloomFilter left(a), right(b);
+            for (uint64_t i = 0; i < a; i++)
+                left.add(btree_detail::filter_hash(i));
+            for (uint64_t i = 0; i < b; i++)
+                right.add(btree_detail::filter_hash(i + 1'000'000));
+
+            left.merge(right);
+            REQUIRE(left.capacity() == std::max(BlockedBloomFilter(a).capacity(),
+                                                BlockedBloomFilter(b).capacity()));
+            REQUIRE(left.added == a + b);
+
+            for (uint64_t i = 0; i < a; i++)
+                REQUIRE(left.may_contain(btree_detail::filter_hash(i)));
+            for (uint64_t i = 0; i < b; i++)
+                REQUIRE(left.may_contain(btree_detail::filter_hash(i + 1'000'000)));
+        }
+    }
+}
+
+TEST_CASE("Filtered B-tree against std::multiset", "[filter]") {
+    for (unsigned seed = 0; seed < 3; seed++) {
+        BTree<int, 4, BTreeFilteredTraits> tree;
+        std::multiset<int> ref;
+        std::mt19937 g(seed);
+
+        for (auto round = 0; round < 20; round++) {
+            for (auto i = 0; i < 5000; i++) {
+                int k = g() % 20'000;
+
+                /* Grow, then shrink, so that rebuilds on both counts happen */
+                if (g() % 10 < (round < 10 ? 7u : 2u)) {
+                    tree.insert(k);
+                    ref.insert(k);
+                } else {
+                    tree.remove(k);
+                    auto it = ref.find(k);
+                    if (it != ref.end())
+                        ref.erase(it);
+                }
+            }
+
+            for (auto i = 0; i < 2000; i++) {
+                int k = g() % 40'000;
+                REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+                REQUIRE((tree.find(k) != tree.end()) == (ref.count(k) > 0));
+            }
+
+            check_filter(tree, ref);
+        }
+    }
+}
+
+TEST_CASE("Removing most keys rebuilds the filter", "[filter]") {
+    BTree<int, 6, BTreeFilteredTraits> tree;
+    std::multiset<int> ref;
+
+    for (int i = 0; i < 100'000; i++)
+        tree.insert(i);
+
+    /* Keep every hundredth key; the filter must shrink back to fit them */
+    for (int i = 0; i < 100'000; i++) {
+        if (i % 100)
+            tree.remove(i);
+        else
+            ref.insert(i);
+    }
+
+    check_filter(tree, ref);
+    REQUIRE(tree.filter.capacity() < 10'000);
+
+    /* Removed keys no longer pass, apart from the odd false positive */
+    size_t passed = 0;
+    for (int i = 0; i < 100'000; i++)
+        passed += i % 100 && tree.filter.may_contain(btree_detail::filter_hash(i));
+
+    REQUIRE(passed < 2000);
+    REQUIRE(false_positive_rate(tree, 100'000) < 0.02);
+}
+
+TEST_CASE("Bulk and batch operations keep the filter", "[filter]") {
+    std::mt19937 g(7);
+    std::vector<int> keys(30'000);
+    for (auto& k : keys)
+        k = g() % 100'000;
+    std::sort(keys.begin(), keys.end());
+
+    BTree<int, 5, FilteredCountedTraits> tree;
+    tree.bulk_load(keys.begin(), keys.end());
+    std::multiset<int> ref(keys.begin(), keys.end());
+    check_filter(tree, ref);
+    REQUIRE(tree.size() == ref.size());
+
+    std::vector<int> more(20'000);
+    for (auto& k : more)
+        k = 100'000 + g() % 100'000;
+    std::sort(more.begin(), more.end());
+    tree.insert_batch(more.begin(), more.end());
+    ref.insert(more.begin(), more.end());
+    check_filter(tree, ref);
+
+    std::vector<int> gone(keys.begin(), keys.begin() + 25'000);
+    tree.remove_batch(gone.begin(), gone.end());
+    for (int k : gone)
+        ref.erase(ref.find(k));
+    check_filter(tree, ref);
+    REQUIRE(tree.size() == ref.size());
+
+    REQUIRE(false_positive_rate(tree, 200'000) < 0.02);
+}
+
+TEST_CASE("Split, join and erase_range keep the filter", "[filter]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        std::mt19937 g(seed);
+        BTree<int, 3, BTreeFilteredTraits> tree, right;
+        std::multiset<int> ref;
+
+        for (int i = 0; i < 20'000; i++) {
+            int k = g() % 50'000;
+            tree.insert(k);
+            ref.insert(k);
+        }
+
+        int at = g() % 50'000;
+        tree.split_at(at, right);
+
+        std::multiset<int> lo(ref.begin(), ref.lower_bound(at));
+        std::multiset<int> hi(ref.lower_bound(at), ref.end());
+        check_filter(tree, lo);
+        check_filter(right, hi);
+
+        /* Each half answers exactly, whatever the filter lets through */
+        for (int i = 0; i < 2000; i++) {
+            int k = g() % 50'000;
+            REQUIRE(tree.contains(k) == (lo.count(k) > 0));
+            REQUIRE(right.contains(k) == (hi.count(k) > 0));
+        }
+
+        tree.join(right);
+        check_filter(tree, ref);
+        REQUIRE_FALSE(right.contains(at));
+
+        int a = g() % 50'000, b = a + g() % 20'000;
+        size_t erased = tree.erase_range(a, b);
+        REQUIRE(erased == size_t(std::distance(ref.lower_bound(a), ref.lower_bound(b))));
+        ref.erase(ref.lower_bound(a), ref.lower_bound(b));
+        check_filter(tree, ref);
+
+        for (int i = 0; i < 2000; i++) {
+            int k = g() % 60'000;
+            REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+        }
+    }
+}
+
+TEST_CASE("Filtered trees of strings", "[filter]") {
+    BTree<std::string, 4, FilteredCountedTraits> tree;
+    std::multiset<std::string> ref;
+
+    for (int i = 0; i < 5000; i++) {
+        std::string k = "user/" + std::to_string(i * 3);
+        tree.insert(k);
+        ref.insert(k);
+    }
+
+    for (int i = 0; i < 15'000; i++)
+        REQUIRE(tree.contains("user/" + std::to_string(i)) == (i % 3 == 0));
+
+    for (int i = 0; i < 15'000; i += 2) {
+        std::string k = "user/" + std::to_string(i);
+        tree.remove(k);
+        auto it = ref.find(k);
+        if (it != ref.end())
+            ref.erase(it);
+    }
+
+    check_filter(tree, ref);
+    REQUIRE(tree.size() == ref.size());
+    REQUIRE(tree.rank("user/9") == size_t(std::distance(ref.begin(), ref.lower_bound("user/9"))));
+}
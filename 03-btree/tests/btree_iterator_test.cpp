@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B>
+static void check_iterators(const BTree<T, B>& tree, const std::multiset<T>& ref) {
+    REQUIRE(std::vector<T>(tree.begin(), tree.end()) == std::vector<T>(ref.begin(), ref.end()));
+    REQUIRE(std::vector<T>(tree.rbegin(), tree.rend()) == std::vector<T>(ref.rbegin(), ref.rend()));
+    REQUIRE(std::distance(tree.begin(), tree.end()) == static_cast<std::ptrdiff_t>(ref.size()));
+}
+
+TEST_CASE("Iterators visit keys in order", "[iterator]") {
+    BTree<int, 3> tree;
+    std::multiset<int> ref;
+
+    REQUIRE(tree.begin() == tree.end());
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 1'000);
+
+    for (auto round = 0; round < 20; round++) {
+        for (auto i = 0; i < 500; i++) {
+            int k = key(g);
+            if (g() % 3) {
+                tree.insert(k);
+                ref.insert(k);
+            } else if (ref.count(k)) {
+                tree.remove(k);
+                ref.erase(ref.find(k));
+            }
+        }
+
+        check_iterators(tree, ref);
+    }
+
+    /* Remove everything: the root ends up as an empty leaf */
+    for (auto k : std::vector<int>(ref.begin(), ref.end()))
+        tree.remove(k);
+    REQUIRE(tree.begin() == tree.end());
+    REQUIRE(tree.lower_bound(0) == tree.end());
+}
+
+TEST_CASE("lower_bound, upper_bound and find", "[iterator]") {
+    BTree<int, 2> tree;
+    std::multiset<int> ref;
+
+    std::mt19937 g(5);
+    for (auto i = 0; i < 5'000; i++) {
+        int k = g() % 2'000 * 2;
+        tree.insert(k);
+        ref.insert(k);
+    }
+
+    for (int t = -1; t <= 4'001; t++) {
+        auto lo = tree.lower_bound(t);
+        auto ref_lo = ref.lower_bound(t);
+        REQUIRE((lo == tree.end()) == (ref_lo == ref.end()));
+        if (ref_lo != ref.end()) {
+            REQUIRE(*lo == *ref_lo);
+            REQUIRE(std::distance(tree.begin(), lo) == std::distance(ref.begin(), ref_lo));
+        }
+
+        auto hi = tree.upper_bound(t);
+        auto ref_hi = ref.upper_bound(t);
+        REQUIRE((hi == tree.end()) == (ref_hi == ref.end()));
+        if (ref_hi != ref.end())
+            REQUIRE(*hi == *ref_hi);
+
+        REQUIRE(std::distance(lo, hi) == static_cast<std::ptrdiff_t>(ref.count(t)));
+        REQUIRE((tree.find(t) != tree.end()) == (ref.count(t) > 0));
+    }
+}
+
+TEST_CASE("Iterators step both ways", "[iterator]") {
+    BTree<std::string, 2> tree;
+    std::set<std::string> ref;
+
+    for (auto i = 0; i < 2'000; i++) {
+        auto s = std::to_string(i * 7919 % 2'003);
+        tree.insert(s);
+        ref.insert(s);
+    }
+
+    auto it = tree.begin();
+    auto ref_it = ref.begin();
+    for (; it != tree.end(); ++it, ++ref_it) {
+        REQUIRE(*it == *ref_it);
+        REQUIRE(it->size() == ref_it->size());
+
+        if (it != tree.begin()) {
+            auto prev = it;
+            --prev;
+            REQUIRE(*prev == *std::prev(ref_it));
+            REQUIRE(++prev == it);
+        }
+    }
+
+    REQUIRE(*std::prev(tree.end()) == *ref.rbegin());
+    REQUIRE(std::is_sorted(tree.begin(), tree.end()));
+    REQUIRE(*std::max_element(tree.begin(), tree.end()) == *ref.rbegin());
+    REQUIRE(std::count_if(tree.begin(), tree.end(),
+                          [](const std::string& s) { return s.size() == 3; }) ==
+            std::count_if(ref.begin(), ref.end(),
+                          [](const std::string& s) { return s.size() == 3; }));
+}
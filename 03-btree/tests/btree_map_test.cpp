@@ -0,0 +1,84 @@
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree_map.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename K, typename V, size_t B>
+static void require_same(BTreeMap<K, V, B>& map, const std::map<K, V>& ref) {
+    REQUIRE(map.size() == ref.size());
+
+    std::vector<std::pair<K, V>> xs;
+    map.for_all([&xs](const K& k, V& v) { xs.emplace_back(k, v); });
+    REQUIRE(xs == std::vector<std::pair<K, V>>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("BTreeMap behaves like std::map", "[map]") {
+    BTreeMap<int, std::string, 3> map;
+    std::map<int, std::string> ref;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 2'000);
+
+    for (auto i = 0; i < 100'000; i++) {
+        int k = key(g);
+        std::string v = std::to_string(g());
+
+        switch (g() % 5) {
+        case 0:
+            REQUIRE(map.erase(k) == (ref.erase(k) == 1));
+            break;
+        case 1:
+            REQUIRE(map.insert_or_assign(k, v) == (ref.count(k) == 0));
+            ref[k] = v;
+            break;
+        case 2: {
+            auto [value, inserted] = map.try_emplace(k, v);
+            auto [it, ref_inserted] = ref.try_emplace(k, v);
+            REQUIRE(inserted == ref_inserted);
+            REQUIRE(*value == it->second);
+            break;
+        }
+        case 3:
+            REQUIRE(map.upsert(k, [](std::string& s) { s += "!"; }) == (ref.count(k) == 0));
+            ref[k] += "!";
+            break;
+        default: {
+            auto value = map.find(k);
+            auto it = ref.find(k);
+            REQUIRE((value != nullptr) == (it != ref.end()));
+            if (value)
+                REQUIRE(*value == it->second);
+        }
+        }
+    }
+
+    require_same(map, ref);
+
+    for (auto& [k, v] : ref)
+        REQUIRE(map.erase(k));
+    REQUIRE(map.empty());
+}
+
+TEST_CASE("BTreeMap counts with upsert", "[map]") {
+    BTreeMap<std::string, size_t> map;
+    std::map<std::string, size_t> ref;
+
+    std::mt19937 g(3);
+    for (auto i = 0; i < 50'000; i++) {
+        auto word = std::to_string(g() % 3'000);
+        map.upsert(word, [](size_t& c) { c++; });
+        ref[word]++;
+    }
+
+    require_same(map, ref);
+
+    const auto& cmap = map;
+    REQUIRE(cmap.find("not a number") == nullptr);
+    REQUIRE(*cmap.find(ref.begin()->first) == ref.begin()->second);
+}
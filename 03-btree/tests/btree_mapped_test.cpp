@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+namespace fs = std::filesystem;
+
+struct TempDir {
+    fs::path path;
+
+    explicit TempDir(const std::string& name)
+        : path(fs::temp_directory_path() / (name + "." + std::to_string(getpid()))) {
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+
+    ~TempDir() { fs::remove_all(path); }
+};
+
+/* Every key, lookups of keys there and not, and lower bounds, against the
+   sorted keys the image was saved from */
+template<typename T, size_t B>
+static void check_image(const MappedBTree<T, B>& image, const std::vector<T>& xs,
+                        const std::vector<T>& probes) {
+    REQUIRE(image.size() == xs.size());
+    REQUIRE(std::vector<T>(image.begin(), image.end()) == xs);
+
+    for (const T& t : probes) {
+        auto expected = std::lower_bound(xs.begin(), xs.end(), t);
+        bool present = expected != xs.end() && *expected == t;
+
+        REQUIRE(image.contains(t) == present);
+
+        auto it = image.lower_bound(t);
+        REQUIRE(std::distance(it, image.end()) == std::distance(expected, xs.end()));
+        if (expected != xs.end())
+            REQUIRE(*it == *expected);
+
+        auto found = image.find(t);
+        REQUIRE((found != image.end()) == present);
+        if (present)
+            REQUIRE(*found == t);
+    }
+}
+
+template<size_t B>
+static void round_trip(const fs::path& file) {
+    std::mt19937 g(B);
+
+    for (size_t n = 0; n < 3000; n += (n < 100 ? 1 : 499)) {
+        BTree<int, B> tree;
+        std::vector<int> xs;
+
+        /* Duplicates included */
+        for (size_t i = 0; i < n; i++) {
+            int k = g() % (2 * n + 1);
+            tree.insert(k);
+            xs.push_back(k);
+        }
+        std::sort(xs.begin(), xs.end());
+
+        std::vector<int> probes;
+        for (int k = -1; k <= int(2 * n + 1); k++)
+            probes.push_back(k);
+
+        tree.save(file.string());
+        auto image = BTree<int, B>::open_mapped(file.string());
+        check_image(image, xs, probes);
+
+        /* Full nodes: never higher than the tree it came from */
+        if (n)
+            REQUIRE(image.height() <= tree.depth().value() + 1);
+        else
+            REQUIRE(image.height() == 0);
+    }
+}
+
+TEST_CASE("Saved trees read back the same", "[mapped]") {
+    TempDir dir("btree_mapped_round_trip");
+
+    round_trip<2>(dir.path / "image");
+    round_trip<3>(dir.path / "image");
+    round_trip<6>(dir.path / "image");
+    round_trip<16>(dir.path / "image");
+}
+
+TEST_CASE("Images of every kind of tree", "[mapped]") {
+    TempDir dir("btree_mapped_kinds");
+    auto file = (dir.path / "image").string();
+
+    std::vector<double> xs(20'000);
+    for (size_t i = 0; i < xs.size(); i++)
+        xs[i] = i * 0.5;
+
+    std::vector<double> probes;
+    for (int i = -1; i < 41'000; i += 7)
+        probes.push_back(i * 0.25);
+
+    /* Leaves emptied by relaxed removes do not make it into the image */
+    BTree<double, 6, BTreeRelaxedTraits> relaxed;
+    for (double x : xs)
+        relaxed.insert(x);
+    for (size_t i = 0; i < xs.size(); i++)
+        if (i % 10)
+            relaxed.remove(xs[i]);
+
+    std::vector<double> kept;
+    for (size_t i = 0; i < xs.size(); i += 10)
+        kept.push_back(xs[i]);
+
+    relaxed.save(file);
+    check_image(BTree<double, 6, BTreeRelaxedTraits>::open_mapped(file), kept, probes);
+
+    BTree<double, 6, BTreeCountedTraits> counted;
+    counted.bulk_load(xs.begin(), xs.end(), 0.6);
+    counted.save(file);
+    check_image(BTree<double, 6, BTreeCountedTraits>::open_mapped(file), xs, probes);
+
+    /* A snapshot saves what it had */
+    BTree<double, 6, BTreeCowTraits> cow;
+    for (double x : xs)
+        cow.insert(x);
+    auto snapshot = cow.snapshot();
+    for (double x : xs)
+        cow.remove(x);
+
+    snapshot->save(file);
+    check_image(BTree<double, 6>::open_mapped(file), xs, probes);
+
+    cow.save(file);
+    auto empty = BTree<double, 6>::open_mapped(file);
+    REQUIRE(empty.height() == 0);
+    check_image(empty, std::vector<double>(), probes);
+}
+
+TEST_CASE("Saving over an open image leaves it as it was", "[mapped]") {
+    TempDir dir("btree_mapped_replace");
+    auto file = (dir.path / "image").string();
+
+    BTree<int64_t> tree;
+    std::vector<int64_t> xs;
+    for (int64_t i = 0; i < 10'000; i++) {
+        tree.insert(i);
+        xs.push_back(i);
+    }
+
+    tree.save(file);
+    auto image = BTree<int64_t>::open_mapped(file);
+
+    tree.erase_range(0, 5000);
+    tree.save(file);
+
+    check_image(image, xs, {0, 4999, 9999, 10'000});
+
+    auto reopened = BTree<int64_t>::open_mapped(file);
+    check_image(reopened, std::vector<int64_t>(xs.begin() + 5000, xs.end()), {0, 4999, 9999});
+
+    /* Moving hands the mapping over */
+    MappedBTree<int64_t> moved = std::move(image);
+    REQUIRE(moved.size() == 10'000);
+    REQUIRE(image.size() == 0);
+    REQUIRE(image.begin() == image.end());
+
+    image = std::move(reopened);
+    REQUIRE(image.size() == 5000);
+    REQUIRE(*image.begin() == 5000);
+}
+
+TEST_CASE("Opening checks the image", "[mapped]") {
+    TempDir dir("btree_mapped_checks");
+    auto file = (dir.path / "image").string();
+
+    REQUIRE_THROWS_AS(BTree<int>::open_mapped(file), std::system_error);
+
+    BTree<int64_t, 6> tree;
+    for (int64_t i = 0; i < 1000; i++)
+        tree.insert(i);
+    tree.save(file);
+
+    REQUIRE_THROWS_AS((BTree<int32_t, 6>::open_mapped(file)), std::runtime_error);
+    REQUIRE_THROWS_AS((BTree<int64_t, 8>::open_mapped(file)), std::runtime_error);
+    REQUIRE_NOTHROW(BTree<uint64_t, 6>::open_mapped(file));
+
+    fs::resize_file(file, fs::file_size(file) - 1);
+    REQUIRE_THROWS_AS((BTree<int64_t, 6>::open_mapped(file)), std::runtime_error);
+
+    std::ofstream(file) << "not an image, but long enough to hold a header of one";
+    REQUIRE_THROWS_AS((BTree<int64_t, 6>::open_mapped(file)), std::runtime_error);
+
+    std::ofstream(file) << "short";
+    REQUIRE_THROWS_AS((BTree<int64_t, 6>::open_mapped(file)), std::runtime_error);
+}
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+struct RelaxedCountedTraits : BTreeRelaxedTraits {
+    static constexpr bool counted = true;
+};
+
+template<size_t Min>
+struct RelaxedMinTraits : BTreeRelaxedTraits {
+    static constexpr bool counted = true;
+    static constexpr size_t relaxed_min = Min;
+};
+
+struct RelaxedStatsTraits : BTreeRelaxedTraits {
+    static constexpr bool stats = true;
+};
+
+struct RelaxedCowTraits : BTreeRelaxedTraits {
+    static constexpr bool cow = true;
+};
+
+struct RelaxedFilteredTraits : BTreeRelaxedTraits {
+    static constexpr bool filtered = true;
+};
+
+/* Sorted keys, equal leaf depths, edge counts when counted, and at least
+   `min_keys` keys in every node but the root; return the number of keys */
+template<typename T, size_t B, typename Traits>
+static size_t check_subtree(const BTreeNode<T, B, Traits>* node, bool is_root, size_t min_keys,
+                            size_t level, size_t& leaf_level) {
+    if (!is_root)
+        REQUIRE(node->n >= min_keys);
+    REQUIRE(node->n <= 2 * B - 1);
+    REQUIRE(std::is_sorted(node->keys.begin(), node->keys.begin() + node->n));
+
+    if (node->type == NodeType::LEAF) {
+        if (leaf_level == SIZE_MAX)
+            leaf_level = level;
+        REQUIRE(level == leaf_level);
+        return node->n;
+    }
+
+    size_t total = node->n;
+    for (size_t i = 0; i <= node->n; i++) {
+        size_t below = check_subtree(node->edge(i), false, min_keys, level + 1, leaf_level);
+        if constexpr (Traits::counted)
+            REQUIRE(node->count(i) == below);
+        total += below;
+    }
+
+    return total;
+}
+
+template<typename T, size_t B, typename Traits>
+static void check_tree(const BTree<T, B, Traits>& tree, const std::multiset<T>& ref,
+                       size_t min_keys) {
+    std::vector<T> expected(ref.begin(), ref.end());
+    REQUIRE(std::vector<T>(tree.begin(), tree.end()) == expected);
+    REQUIRE(std::vector<T>(tree.rbegin(), tree.rend())
+            == std::vector<T>(expected.rbegin(), expected.rend()));
+
+    if (tree.root) {
+        size_t leaf_level = SIZE_MAX;
+        REQUIRE(check_subtree(tree.root, true, min_keys, 0, leaf_level) == ref.size());
+    }
+}
+
+/* Phases of mostly inserts and mostly removes, with a rebalance now and
+   then, against std::multiset */
+template<typename Traits, size_t B>
+static void random_phases(unsigned seed) {
+    BTree<int, B, Traits> tree;
+    std::multiset<int> ref;
+    std::mt19937 g(seed);
+
+    for (auto round = 0; round < 24; round++) {
+        bool deleting = round % 6 >= 3;
+
+        for (auto i = 0; i < 3000; i++) {
+            int k = g() % 5000;
+
+            if (g() % 10 < (deleting ? 1u : 7u)) {
+                tree.insert(k);
+                ref.insert(k);
+            } else {
+                tree.remove(k);
+                auto it = ref.find(k);
+                if (it != ref.end())
+                    ref.erase(it);
+            }
+        }
+
+        check_tree(tree, ref, Traits::relaxed_min);
+
+        for (auto i = 0; i < 500; i++) {
+            int k = g() % 5000;
+            REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+
+            auto it = tree.lower_bound(k);
+            auto expected = ref.lower_bound(k);
+            if (expected == ref.end())
+                REQUIRE(it == tree.end());
+            else
+                REQUIRE(*it == *expected);
+        }
+
+        if constexpr (Traits::counted) {
+            REQUIRE(tree.size() == ref.size());
+            if (!ref.empty())
+                REQUIRE(tree.select(ref.size() / 2) == *std::next(ref.begin(), ref.size() / 2));
+        }
+
+        if (round % 6 == 5) {
+            tree.rebalance();
+            REQUIRE(tree.unbalanced == 0);
+            check_tree(tree, ref, B - 1);
+        }
+    }
+}
+
+TEST_CASE("Relaxed B-tree against std::multiset", "[relaxed]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        random_phases<BTreeRelaxedTraits, 2>(seed);
+        random_phases<RelaxedCountedTraits, 3>(seed);
+        random_phases<RelaxedCountedTraits, 16>(seed);
+    }
+}
+
+TEST_CASE("Nodes keep the relaxed minimum", "[relaxed]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        random_phases<RelaxedMinTraits<1>, 2>(seed);
+        random_phases<RelaxedMinTraits<1>, 4>(seed);
+        random_phases<RelaxedMinTraits<3>, 6>(seed);
+        random_phases<RelaxedMinTraits<7>, 8>(seed);
+    }
+}
+
+TEST_CASE("Relaxed removes do not restructure", "[relaxed]") {
+    BTree<int, 4, RelaxedStatsTraits> tree;
+    std::vector<int> keys(50'000);
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = i;
+
+    for (int k : keys)
+        tree.insert(k);
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+    tree.reset_stats();
+
+    /* A burst that leaves one key in fifty */
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] % 50)
+            tree.remove(keys[i]);
+
+    const BTreeStats& s = tree.stats();
+    REQUIRE(s.merges == 0);
+    REQUIRE(s.borrows_left + s.borrows_right == 0);
+    REQUIRE(s.splits == 0);
+    REQUIRE(s.nodes_allocated == 0);
+    REQUIRE(tree.unbalanced == 49'000);
+
+    /* Misses write nothing */
+    BTreeStats before = tree.stats();
+    for (int i = 0; i < 1000; i++)
+        tree.remove(i * 50 + 1);
+    REQUIRE(tree.stats().nodes_freed == before.nodes_freed);
+    REQUIRE(tree.unbalanced == 49'000);
+
+    size_t depth = tree.depth().value();
+    tree.rebalance();
+    REQUIRE(tree.stats().merges > 0);
+    REQUIRE(tree.depth().value() < depth);
+
+    std::multiset<int> ref;
+    for (int i = 0; i < 50'000; i += 50)
+        ref.insert(i);
+    check_tree(tree, ref, 3);
+}
+
+TEST_CASE("Split, join and erase_range rebalance first", "[relaxed]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        std::mt19937 g(seed);
+        BTree<int, 3, RelaxedCountedTraits> tree, right;
+        std::multiset<int> ref;
+
+        for (int i = 0; i < 10'000; i++) {
+            int k = g() % 20'000;
+            tree.insert(k);
+            ref.insert(k);
+        }
+
+        for (int i = 0; i < 8000; i++) {
+            int k = g() % 20'000;
+            tree.remove(k);
+            auto it = ref.find(k);
+            if (it != ref.end())
+                ref.erase(it);
+        }
+
+        int at = g() % 20'000;
+        tree.split_at(at, right);
+        REQUIRE(tree.unbalanced == 0);
+
+        std::multiset<int> lo(ref.begin(), ref.lower_bound(at));
+        std::multiset<int> hi(ref.lower_bound(at), ref.end());
+        check_tree(tree, lo, 2);
+        check_tree(right, hi, 2);
+
+        /* Unbalance both halves again before joining them */
+        for (int i = 0; i < 2000; i++) {
+            int k = g() % 20'000;
+            auto& half = k < at ? lo : hi;
+            (k < at ? tree : right).remove(k);
+            auto it = half.find(k);
+            if (it != half.end())
+                half.erase(it);
+        }
+
+        tree.join(right);
+        ref = lo;
+        ref.insert(hi.begin(), hi.end());
+        check_tree(tree, ref, 2);
+
+        for (int i = 0; i < 2000; i++) {
+            int k = g() % 20'000;
+            tree.remove(k);
+            auto it = ref.find(k);
+            if (it != ref.end())
+                ref.erase(it);
+        }
+
+        int a = g() % 20'000, b = a + g() % 5000;
+        size_t erased = tree.erase_range(a, b);
+        REQUIRE(erased == size_t(std::distance(ref.lower_bound(a), ref.lower_bound(b))));
+        ref.erase(ref.lower_bound(a), ref.lower_bound(b));
+        check_tree(tree, ref, 2);
+    }
+}
+
+TEST_CASE("Relaxed removes leave snapshots alone", "[relaxed]") {
+    BTree<std::string, 3, RelaxedCowTraits> tree;
+    std::multiset<std::string> ref;
+
+    for (int i = 0; i < 3000; i++) {
+        std::string k = "key-" + std::to_string(10000 + i);
+        tree.insert(k);
+        ref.insert(k);
+    }
+
+    auto snapshot = tree.snapshot();
+    std::vector<std::string> before(ref.begin(), ref.end());
+
+    for (int i = 0; i < 3000; i += 3) {
+        std::string k = "key-" + std::to_string(10000 + i);
+        tree.remove(k);
+        ref.erase(k);
+    }
+
+    check_tree(tree, ref, 0);
+    REQUIRE(std::vector<std::string>(snapshot->begin(), snapshot->end()) == before);
+
+    auto second = tree.snapshot();
+    tree.rebalance();
+    check_tree(tree, ref, 2);
+    REQUIRE(std::vector<std::string>(second->begin(), second->end())
+            == std::vector<std::string>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("A filter is rebuilt over empty leaves", "[relaxed]") {
+    BTree<int, 2, RelaxedFilteredTraits> tree;
+    std::multiset<int> ref;
+
+    for (int i = 0; i < 20'000; i++)
+        tree.insert(i);
+
+    /* Enough removes for rebuilds, most leaves end up empty */
+    for (int i = 0; i < 20'000; i++)
+        if (i % 97)
+            tree.remove(i);
+        else
+            ref.insert(i);
+
+    check_tree(tree, ref, 0);
+    REQUIRE(tree.find_leftmost_key() == 0);
+    REQUIRE(tree.find_rightmost_key() == 19'982);
+
+    for (int i = 0; i < 20'000; i++)
+        REQUIRE(tree.contains(i) == (i % 97 == 0));
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <random>
+#include <string>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+/* Compare a policy against std::lower_bound for every prefix length and
+   every probe between (and around) the keys. */
+template<typename Policy, typename T>
+static void check_policy(const std::vector<T>& keys, const std::vector<T>& probes) {
+    for (size_t n = 0; n <= keys.size(); n++) {
+        for (const auto& t : probes) {
+            auto expected = std::lower_bound(keys.begin(), keys.begin() + n, t)
+                - keys.begin();
+            REQUIRE(Policy::index(keys.data(), n, t) == static_cast<size_t>(expected));
+        }
+    }
+}
+
+template<typename T>
+static void check_all_policies(const std::vector<T>& keys, const std::vector<T>& probes) {
+    check_policy<LinearSearch>(keys, probes);
+    check_policy<BinarySearch>(keys, probes);
+    check_policy<SimdSearch>(keys, probes);
+}
+
+TEST_CASE("Search policies agree with lower_bound", "[search]") {
+    std::vector<int8_t> i8;
+    std::vector<uint8_t> u8;
+    std::vector<int16_t> i16;
+    std::vector<uint16_t> u16;
+    std::vector<int32_t> i32;
+    std::vector<uint32_t> u32;
+    std::vector<int64_t> i64;
+    std::vector<uint64_t> u64;
+    std::vector<float> f32;
+    std::vector<double> f64;
+
+    for (int i = 0; i < 37; i++) {
+        i8.push_back(i * 4 - 60);
+        u8.push_back(i * 4 + 100);
+        i16.push_back(i * 4 - 60);
+        u16.push_back(i * 4 + 0x7ff0);
+        i32.push_back(i * 4 - 60);
+        u32.push_back(i * 4 + 0x7ffffff0u);
+        i64.push_back((i - 18) * 0x100000000LL);
+        u64.push_back(i * 4 + 0x7ffffffffffffff0ull);
+        f32.push_back(i * 0.5f - 9.0f);
+        f64.push_back(i * 0.5 - 9.0);
+    }
+
+    auto probes_of = [](const auto& keys) {
+        using K = typename std::decay_t<decltype(keys)>::value_type;
+        std::vector<K> ps;
+        ps.push_back(std::numeric_limits<K>::lowest());
+        ps.push_back(std::numeric_limits<K>::max());
+        for (auto k : keys) {
+            ps.push_back(k);
+            ps.push_back(k + 1);
+            ps.push_back(k - 1);
+        }
+        return ps;
+    };
+
+    check_all_policies(i8, probes_of(i8));
+    check_all_policies(u8, probes_of(u8));
+    check_all_policies(i16, probes_of(i16));
+    check_all_policies(u16, probes_of(u16));
+    check_all_policies(i32, probes_of(i32));
+    check_all_policies(u32, probes_of(u32));
+    check_all_policies(i64, probes_of(i64));
+    check_all_policies(u64, probes_of(u64));
+    check_all_policies(f32, probes_of(f32));
+    check_all_policies(f64, probes_of(f64));
+}
+
+TEST_CASE("Non-arithmetic keys fall back to the scalar search", "[search]") {
+    std::vector<std::string> keys{"apple", "banana", "cherry", "grape", "melon"};
+    std::vector<std::string> probes{"", "apple", "b", "cherry", "kiwi", "zebra"};
+
+    check_all_policies(keys, probes);
+}
+
+template<size_t B>
+static void check_contains() {
+    BTree<int, B> tree;
+    std::vector<int> xs;
+    size_t N = 20'000;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    for (auto i = 0; i < N; i++)
+        xs.push_back(i * 2);
+
+    std::shuffle(xs.begin(), xs.end(), g);
+
+    for (auto i : xs)
+        tree.insert(i);
+
+    for (auto i = 0; i < N; i++) {
+        REQUIRE(tree.contains(i * 2));
+        REQUIRE_FALSE(tree.contains(i * 2 + 1));
+    }
+
+    /* Removed keys may linger in the slots past `n`; they must not be found */
+    for (auto i = 0; i < N; i += 2)
+        tree.remove(i * 2);
+
+    for (auto i = 0; i < N; i++)
+        REQUIRE(tree.contains(i * 2) == (i % 2 == 1));
+}
+
+TEST_CASE("contains() with every policy in use", "[search]") {
+    REQUIRE(std::is_same_v<btree_search_policy_t<std::string, 2>, LinearSearch>);
+    REQUIRE(std::is_same_v<btree_search_policy_t<std::string, 64>, BinarySearch>);
+
+    check_contains<2>();
+    check_contains<6>();
+    check_contains<32>();
+    check_contains<128>();
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+struct CowCountedTraits : BTreeTraits {
+    static constexpr bool counted = true;
+    static constexpr bool cow = true;
+};
+
+/* Occupancy, equal leaf depths and (when counted) edge counts of a subtree;
+   return its number of keys */
+template<typename T, size_t B, typename Traits>
+static size_t check_subtree(const BTreeNode<T, B, Traits>* node, bool is_root,
+                            size_t level, size_t& leaf_level) {
+    if (!is_root)
+        REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+    REQUIRE(std::is_sorted(node->keys.begin(), node->keys.begin() + node->n));
+
+    if (node->type == NodeType::LEAF) {
+        if (leaf_level == SIZE_MAX)
+            leaf_level = level;
+        REQUIRE(level == leaf_level);
+        return node->n;
+    }
+
+    REQUIRE(node->n > 0);
+
+    size_t total = node->n;
+    for (size_t i = 0; i <= node->n; i++) {
+        size_t below = check_subtree(node->edge(i), false, level + 1, leaf_level);
+        if constexpr (Traits::counted)
+            REQUIRE(node->count(i) == below);
+        total += below;
+    }
+
+    return total;
+}
+
+template<typename T, size_t B, typename Traits>
+static void check_tree(const BTree<T, B, Traits>& tree, const std::vector<T>& expected) {
+    REQUIRE(std::vector<T>(tree.begin(), tree.end()) == expected);
+
+    if (tree.root && tree.root->n > 0) {
+        size_t leaf_level = SIZE_MAX;
+        REQUIRE(check_subtree(tree.root, true, 0, leaf_level) == expected.size());
+    }
+}
+
+template<typename T, size_t B, typename Traits>
+static void collect_nodes(const BTreeNode<T, B, Traits>* node,
+                          std::unordered_set<const void*>& nodes) {
+    if (!node)
+        return;
+
+    nodes.insert(node);
+    if (node->type == NodeType::INTERNAL)
+        for (size_t i = 0; i <= node->n; i++)
+            collect_nodes(node->edge(i), nodes);
+}
+
+/* Split a random multiset at random keys, present or not, join the halves
+   back, and split the result again, checking both sides every time */
+template<typename Traits, size_t B>
+static void split_and_join(unsigned seed, size_t size, int range) {
+    std::mt19937 g(seed);
+
+    for (auto round = 0; round < 20; round++) {
+        BTree<int, B, Traits> tree;
+        std::multiset<int> ref;
+
+        for (size_t i = 0; i < size; i++) {
+            int k = g() % range;
+            tree.insert(k);
+            ref.insert(k);
+        }
+
+        int at = int(g() % (range + 2)) - 1;
+        std::vector<int> lo(ref.begin(), ref.lower_bound(at));
+        std::vector<int> hi(ref.lower_bound(at), ref.end());
+
+        BTree<int, B, Traits> right;
+        right.insert(12345);
+        tree.split_at(at, right);
+
+        check_tree(tree, lo);
+        check_tree(right, hi);
+
+        /* Both halves stay usable on their own */
+        tree.insert(at - 1);
+        lo.push_back(at - 1);
+        right.insert(at + range);
+        hi.push_back(at + range);
+        check_tree(tree, lo);
+        check_tree(right, hi);
+
+        tree.join(right);
+        lo.insert(lo.end(), hi.begin(), hi.end());
+        check_tree(tree, lo);
+        REQUIRE(right.begin() == right.end());
+
+        int again = int(g() % range);
+        std::vector<int> lo2(lo.begin(), std::lower_bound(lo.begin(), lo.end(), again));
+        std::vector<int> hi2(std::lower_bound(lo.begin(), lo.end(), again), lo.end());
+
+        tree.split_at(again, right);
+        check_tree(tree, lo2);
+        check_tree(right, hi2);
+    }
+}
+
+TEST_CASE("Split and join keep the B-tree invariants", "[split_join]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        for (size_t size : { 0, 1, 5, 40, 300, 3000 }) {
+            split_and_join<BTreeTraits, 2>(seed, size, 1000);
+            split_and_join<BTreeTraits, 3>(seed, size, 1000);
+            split_and_join<BTreeTraits, 6>(seed, size, 50);
+            split_and_join<BTreeTraits, 16>(seed, size, 100000);
+        }
+    }
+}
+
+TEST_CASE("Split and join keep the edge counts", "[split_join]") {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        split_and_join<BTreeCountedTraits, 2>(seed, 2000, 1000);
+        split_and_join<BTreeCountedTraits, 5>(seed, 2000, 100);
+    }
+
+    BTree<int, 4, BTreeCountedTraits> tree, right;
+    for (int i = 0; i < 1000; i++)
+        tree.insert(i);
+
+    tree.split_at(600, right);
+    REQUIRE(tree.size() == 600);
+    REQUIRE(right.size() == 400);
+    REQUIRE(right.rank(700) == 100);
+    REQUIRE(right.select(0) == 600);
+}
+
+TEST_CASE("Joining trees of very different heights", "[split_join]") {
+    for (int small : { 1, 3, 20, 200 }) {
+        BTree<int, 2, BTreeCountedTraits> big, little;
+        std::vector<int> expected;
+
+        for (int i = 0; i < 5000; i++)
+            big.insert(i);
+        for (int i = 0; i < small; i++)
+            little.insert(5000 + i);
+
+        for (int i = 0; i < 5000 + small; i++)
+            expected.push_back(i);
+
+        /* Tall on the left, then tall on the right */
+        big.join(little);
+        check_tree(big, expected);
+
+        BTree<int, 2, BTreeCountedTraits> front;
+        for (int i = -small; i < 0; i++)
+            front.insert(i);
+        front.join(big);
+
+        std::vector<int> all;
+        for (int i = -small; i < 5000 + small; i++)
+            all.push_back(i);
+        check_tree(front, all);
+    }
+}
+
+TEST_CASE("A split moves subtrees rather than keys", "[split_join]") {
+    BTree<int, 4> tree, right;
+    for (int i = 0; i < 100'000; i++)
+        tree.insert(i);
+
+    std::unordered_set<const void*> before, after;
+    collect_nodes(tree.root, before);
+
+    tree.split_at(31'337, right);
+
+    collect_nodes(tree.root, after);
+    collect_nodes(right.root, after);
+
+    size_t fresh = 0;
+    for (auto node : after)
+        fresh += !before.count(node);
+
+    /* A few new nodes per level, out of thousands */
+    REQUIRE(fresh <= 4 * tree.depth().value() + 4 * right.depth().value() + 4);
+    REQUIRE(after.size() > before.size() - 4 * tree.depth().value() - 4);
+}
+
+TEST_CASE("Split and join leave snapshots alone", "[split_join]") {
+    BTree<std::string, 3, CowCountedTraits> tree, right;
+    std::vector<std::string> keys;
+
+    for (int i = 0; i < 3000; i++) {
+        keys.push_back("key-" + std::to_string(10000 + i));
+        tree.insert(keys.back());
+    }
+
+    auto snapshot = tree.snapshot();
+
+    tree.split_at("key-11500", right);
+    auto right_snapshot = right.snapshot();
+
+    check_tree(tree, std::vector<std::string>(keys.begin(), keys.begin() + 1500));
+    check_tree(right, std::vector<std::string>(keys.begin() + 1500, keys.end()));
+
+    right.remove("key-11500");
+    tree.join(right);
+
+    std::vector<std::string> joined(keys);
+    joined.erase(joined.begin() + 1500);
+    check_tree(tree, joined);
+
+    REQUIRE(std::vector<std::string>(snapshot->begin(), snapshot->end()) == keys);
+    REQUIRE(std::vector<std::string>(right_snapshot->begin(), right_snapshot->end())
+            == std::vector<std::string>(keys.begin() + 1500, keys.end()));
+}
+
+TEST_CASE("Split-off trees outlive the tree they came from", "[split_join]") {
+    BTree<std::string, 3> right;
+    std::vector<std::string> expected;
+
+    {
+        BTree<std::string, 3> tree;
+        for (int i = 0; i < 2000; i++) {
+            std::string k = "a fairly long key, past the small-string buffer " + std::to_string(i);
+            tree.insert(k);
+            expected.push_back(k);
+        }
+
+        std::sort(expected.begin(), expected.end());
+        tree.split_at(expected[700], right);
+    }
+
+    expected.erase(expected.begin(), expected.begin() + 700);
+    check_tree(right, expected);
+
+    for (auto& k : expected)
+        right.remove(k);
+    REQUIRE(right.begin() == right.end());
+}
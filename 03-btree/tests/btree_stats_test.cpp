@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+struct CountedStatsTraits : BTreeStatsTraits {
+    static constexpr bool counted = true;
+};
+
+template<typename T, size_t B, typename Traits>
+static size_t count_nodes(BTree<T, B, Traits>& tree) {
+    size_t nodes = 0;
+    if (tree.root)
+        tree.for_all_nodes([&nodes](const BTreeNode<T, B, Traits>&) { nodes++; });
+
+    return nodes;
+}
+
+/* What the counters must agree on, whatever the tree went through */
+template<typename T, size_t B, typename Traits>
+static void check_balance(BTree<T, B, Traits>& tree) {
+    const BTreeStats& s = tree.stats();
+
+    REQUIRE(s.root_grows - s.root_shrinks == (tree.root ? tree.depth().value() + 1 : 0));
+    REQUIRE(s.nodes_allocated - s.nodes_freed == count_nodes(tree));
+}
+
+TEST_CASE("Trees without stats do not grow", "[stats]") {
+    REQUIRE(sizeof(BTreeNodePool<int, 6>) < sizeof(BTreeNodePool<int, 6, BTreeStatsTraits>));
+    REQUIRE(sizeof(BTree<int, 6>) + sizeof(BTreeStats) == sizeof(BTree<int, 6, BTreeStatsTraits>));
+}
+
+TEST_CASE("Inserts count splits, allocations and root growth", "[stats]") {
+    BTree<int, 2, BTreeStatsTraits> tree;
+    for (int i = 0; i < 10'000; i++)
+        tree.insert(i);
+
+    const BTreeStats& s = tree.stats();
+
+    /* Every node but the first leaf came from a split or a new root */
+    REQUIRE(s.nodes_allocated == s.splits + s.root_grows);
+    REQUIRE(s.root_grows == tree.depth().value() + 1);
+    REQUIRE(s.merges == 0);
+    REQUIRE(s.borrows_left + s.borrows_right == 0);
+    REQUIRE(s.nodes_freed == 0);
+    REQUIRE(s.nodes_visited >= 10'000);
+    REQUIRE(s.keys_compared >= s.nodes_visited);
+    check_balance(tree);
+
+    /* A miss looks into one node per level */
+    BTreeStats before = tree.stats();
+    REQUIRE(tree.reset_stats().splits == before.splits);
+    REQUIRE(tree.stats().nodes_visited == 0);
+    REQUIRE(tree.stats().root_grows == 0);
+
+    REQUIRE_FALSE(tree.contains(-1));
+    REQUIRE(tree.stats().nodes_visited == tree.depth().value() + 1);
+    REQUIRE(tree.stats().keys_compared >= tree.depth().value() + 1);
+    REQUIRE(tree.stats().keys_compared <= 3 * (tree.depth().value() + 1));
+}
+
+TEST_CASE("Removes count merges, borrows, frees and root shrinks", "[stats]") {
+    BTree<int, 3, CountedStatsTraits> tree;
+    std::vector<int> keys(20'000);
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = i;
+
+    for (int k : keys)
+        tree.insert(k);
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    tree.reset_stats();
+
+    for (int k : keys)
+        tree.remove(k);
+
+    const BTreeStats& s = tree.stats();
+
+    /* Every merge frees the right sibling, every lost level the old root */
+    REQUIRE(s.nodes_freed == s.merges + s.root_shrinks);
+    REQUIRE(s.merges > 0);
+    REQUIRE(s.borrows_left > 0);
+    REQUIRE(s.borrows_right > 0);
+    REQUIRE(s.splits == 0);
+    REQUIRE(s.root_grows == 0);
+    REQUIRE(tree.size() == 0);
+}
+
+TEST_CASE("Counters stay consistent through every operation", "[stats]") {
+    for (unsigned seed = 0; seed < 3; seed++) {
+        std::mt19937 g(seed);
+        BTree<int, 2, CountedStatsTraits> tree;
+
+        for (auto round = 0; round < 30; round++) {
+            switch (g() % 5) {
+            case 0: {
+                std::vector<int> batch(g() % 3000);
+                for (auto& k : batch)
+                    k = g() % 10'000;
+                std::sort(batch.begin(), batch.end());
+
+                if (g() % 2)
+                    tree.insert_batch(batch.begin(), batch.end());
+                else
+                    tree.remove_batch(batch.begin(), batch.end());
+                break;
+            }
+            case 1: {
+                int lo = g() % 10'000;
+                tree.erase_range(lo, lo + g() % 3000);
+                break;
+            }
+            case 2: {
+                std::vector<int> keys(g() % 5000);
+                for (auto& k : keys)
+                    k = g() % 10'000;
+                std::sort(keys.begin(), keys.end());
+                tree.bulk_load(keys.begin(), keys.end(), 0.7);
+                break;
+            }
+            default:
+                for (int i = 0; i < 2000; i++) {
+                    if (g() % 3)
+                        tree.insert(g() % 10'000);
+                    else
+                        tree.remove(g() % 10'000);
+                }
+            }
+
+            check_balance(tree);
+        }
+    }
+}
+
+TEST_CASE("Split and join count the height changes of both trees", "[stats]") {
+    BTree<int, 2, BTreeStatsTraits> tree, right;
+
+    for (int i = 0; i < 5000; i++)
+        tree.insert(i);
+    right.insert(-1);
+
+    tree.split_at(4990, right);
+    REQUIRE(right.stats().root_grows - right.stats().root_shrinks == right.depth().value() + 1);
+    REQUIRE(tree.stats().root_grows - tree.stats().root_shrinks == tree.depth().value() + 1);
+
+    tree.join(right);
+    REQUIRE(tree.stats().root_grows - tree.stats().root_shrinks == tree.depth().value() + 1);
+    REQUIRE(right.stats().root_grows == right.stats().root_shrinks);
+}
+
+TEST_CASE("Exporting the counters", "[stats]") {
+    BTree<std::string, 4, BTreeStatsTraits> tree;
+    for (int i = 0; i < 1000; i++)
+        tree.insert("key-" + std::to_string(i));
+
+    /* What an exporter to a metrics pipeline would do every interval */
+    std::map<std::string, uint64_t> exported;
+    auto export_interval = [&] {
+        tree.reset_stats().for_each([&exported](const char* name, uint64_t value) {
+            exported["btree." + std::string(name)] += value;
+        });
+    };
+
+    export_interval();
+    REQUIRE(exported.size() == 10);
+    REQUIRE(exported["btree.nodes_allocated"] > 0);
+    REQUIRE(exported["btree.splits"] == exported["btree.nodes_allocated"]
+                                        - exported["btree.root_grows"]);
+
+    tree.find("key-5");
+    export_interval();
+    REQUIRE(exported["btree.nodes_visited"] > 0);
+    REQUIRE(tree.stats().nodes_visited == 0);
+
+    /* Readings of several trees add up */
+    BTreeStats sum;
+    tree.insert("key-x");
+    sum += tree.stats();
+    sum += tree.stats();
+    REQUIRE(sum.nodes_visited == 2 * tree.stats().nodes_visited);
+}
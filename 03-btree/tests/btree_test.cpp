@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 #include <vector>
 #include <random>
 
@@ -156,3 +157,88 @@ TEST_CASE("Perfect balance") {
                             return n->type == NodeType::LEAF;
                         }));
 }
+
+TEST_CASE("Leaves do not carry edges", "[btree]") {
+    static constexpr size_t B = 6;
+
+    REQUIRE(sizeof(BTreeLeafNode<int, B>) + 2 * B * sizeof(void*)
+            <= sizeof(BTreeInternalNode<int, B>));
+
+    BTree<int, B> btree;
+    size_t n = 10'000;
+
+    for (auto i = 1; i <= n; i++)
+        btree.insert(i);
+
+    /* Every node reached through an edge has the layout its type says */
+    size_t leaves = 0, internals = 0;
+    btree.for_all_nodes([&](const BTreeNode<int, B>& bn) {
+        if (bn.type == NodeType::LEAF) {
+            leaves++;
+        } else {
+            internals++;
+            for (auto i = 0; i <= bn.n; i++)
+                REQUIRE(bn.edge(i) != nullptr);
+        }
+    });
+
+    REQUIRE(leaves > internals);
+}
+
+/* Counts the copies made of it; moves are free */
+struct CopyCounted {
+    static inline size_t copies = 0;
+
+    int value = 0;
+
+    CopyCounted() = default;
+    CopyCounted(int v) : value(v) {}
+    CopyCounted(const CopyCounted& o) : value(o.value) { copies++; }
+    CopyCounted(CopyCounted&&) = default;
+    CopyCounted& operator=(const CopyCounted& o) { value = o.value; copies++; return *this; }
+    CopyCounted& operator=(CopyCounted&&) = default;
+
+    bool operator<(const CopyCounted& o) const { return value < o.value; }
+    bool operator==(const CopyCounted& o) const { return value == o.value; }
+};
+
+TEST_CASE("Keys are moved, not copied, when nodes shift them", "[btree]") {
+    static_assert(!std::is_trivially_copyable_v<CopyCounted>);
+
+    BTree<CopyCounted, 4> btree;
+    std::vector<int> xs(10'000);
+    std::iota(xs.begin(), xs.end(), 0);
+    std::shuffle(xs.begin(), xs.end(), std::mt19937(3));
+
+    CopyCounted::copies = 0;
+    for (int x : xs)
+        btree.insert(CopyCounted(x));
+
+    /* Storing the key is the only copy an insert makes, splits included */
+    REQUIRE(CopyCounted::copies == xs.size());
+
+    std::vector<int> ys;
+    btree.for_all([&ys](CopyCounted& c) { ys.push_back(c.value); });
+    std::sort(xs.begin(), xs.end());
+    REQUIRE(xs == ys);
+}
+
+TEST_CASE("btree_fanout sizes nodes from the key", "[btree]") {
+    static_assert(btree_fanout<uint32_t>() == 64);
+    static_assert(btree_fanout<uint64_t>() == 32);
+    static_assert(btree_fanout<uint64_t>(4096) == 256);
+    static_assert(btree_fanout<std::array<char, 4096>>() == 2);
+    static_assert(btree_fanout<std::string>() == 4);
+
+    constexpr size_t B = btree_fanout<uint64_t>(64);
+    REQUIRE((2 * B - 1) * sizeof(uint64_t) <= 64);
+
+    BTree<uint64_t, btree_fanout<uint64_t>()> btree;
+    for (uint64_t i = 0; i < 10'000; i++)
+        btree.insert(i * 7 % 10'007);
+
+    std::vector<uint64_t> xs;
+    btree.for_all([&xs](uint64_t& x) { xs.push_back(x); });
+    REQUIRE(std::is_sorted(xs.begin(), xs.end()));
+    REQUIRE(xs.size() == 10'000);
+}
@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "btree_wal.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+namespace fs = std::filesystem;
+
+struct TempDir {
+    fs::path path;
+
+    explicit TempDir(const std::string& name)
+        : path(fs::temp_directory_path() / (name + "." + std::to_string(getpid()))) {
+        fs::remove_all(path);
+    }
+
+    ~TempDir() { fs::remove_all(path); }
+};
+
+template<typename T, size_t B>
+static std::vector<T> contents(DurableBTree<T, B>& tree) {
+    std::vector<T> xs;
+    tree.for_all([&xs](const T& t) { xs.push_back(t); });
+    return xs;
+}
+
+template<typename Tree>
+static void random_ops(Tree& tree, std::multiset<int64_t>& ref, size_t ops, uint32_t seed) {
+    std::mt19937 g(seed);
+    std::uniform_int_distribution<int64_t> key(0, 5'000);
+
+    for (size_t i = 0; i < ops; i++) {
+        int64_t k = key(g);
+        if (g() % 3) {
+            tree.insert(k);
+            ref.insert(k);
+        } else {
+            auto it = ref.find(k);
+            bool present = it != ref.end();
+            if (present)
+                ref.erase(it);
+            REQUIRE(tree.remove(k) == present);
+        }
+    }
+}
+
+TEST_CASE("Reopening replays the log", "[wal]") {
+    TempDir dir("btree_wal_test");
+    std::multiset<int64_t> ref;
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path, WalOptions{16, 4, 0});
+        random_ops(tree, ref, 20'000, 1);
+    }
+
+    DurableBTree<int64_t, 4> tree(dir.path);
+    REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+
+    /* And the reopened log keeps growing where it stopped */
+    random_ops(tree, ref, 5'000, 2);
+    tree.commit();
+
+    DurableBTree<int64_t, 4> again(dir.path);
+    REQUIRE(contents(again) == std::vector<int64_t>(ref.begin(), ref.end()));
+    REQUIRE(again.lsn() == tree.lsn());
+}
+
+TEST_CASE("Checkpoints truncate the log", "[wal]") {
+    TempDir dir("btree_wal_checkpoint_test");
+    std::multiset<int64_t> ref;
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path);
+        random_ops(tree, ref, 20'000, 3);
+        tree.checkpoint();
+        REQUIRE(fs::file_size(dir.path / "wal") == 0);
+
+        random_ops(tree, ref, 1'000, 4);
+    }
+
+    REQUIRE(fs::file_size(dir.path / "wal") > 0);
+
+    DurableBTree<int64_t, 4> tree(dir.path);
+    REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("Periodic checkpoints", "[wal]") {
+    TempDir dir("btree_wal_periodic_test");
+    std::multiset<int64_t> ref;
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path, WalOptions{64, 1, 1'000});
+        random_ops(tree, ref, 10'500, 5);
+        REQUIRE(fs::exists(dir.path / "checkpoint"));
+    }
+
+    DurableBTree<int64_t, 4> tree(dir.path);
+    REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("A crash between checkpoint and log truncation", "[wal]") {
+    TempDir dir("btree_wal_crash_test");
+    std::multiset<int64_t> ref;
+    fs::path saved = dir.path.string() + ".wal";
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path);
+        random_ops(tree, ref, 5'000, 6);
+        tree.commit();
+        fs::copy_file(dir.path / "wal", saved);
+        tree.checkpoint();
+    }
+
+    /* The old log is still there: its records are in the checkpoint */
+    fs::copy_file(saved, dir.path / "wal", fs::copy_options::overwrite_existing);
+    fs::remove(saved);
+
+    DurableBTree<int64_t, 4> tree(dir.path);
+    REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("A torn group at the end of the log is dropped", "[wal]") {
+    TempDir dir("btree_wal_torn_test");
+    std::multiset<int64_t> ref;
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path);
+        random_ops(tree, ref, 5'000, 7);
+    }
+
+    {
+        std::ofstream wal(dir.path / "wal", std::ios::binary | std::ios::app);
+        wal.write("\x01\x00\x00\x00\x00\x00\x00\x00\x20\x00\x00\x00garbage", 19);
+    }
+
+    {
+        DurableBTree<int64_t, 4> tree(dir.path);
+        REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+        random_ops(tree, ref, 1'000, 8);
+    }
+
+    DurableBTree<int64_t, 4> tree(dir.path);
+    REQUIRE(contents(tree) == std::vector<int64_t>(ref.begin(), ref.end()));
+}
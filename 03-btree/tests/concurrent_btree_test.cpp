@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <numeric>
+#include <vector>
+#include <random>
+#include <set>
+#include <thread>
+
+#include "concurrent_btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+template<typename T, size_t B>
+static void check_structure(const ConcurrentBTree<T, B>& tree) {
+    auto root = tree.root_node();
+
+    tree.for_all_nodes([root](const ConcurrentBTreeNode<T, B>& node) {
+        if (&node != root)
+            REQUIRE((B - 1 <= node.n && node.n <= 2 * B - 1));
+    });
+
+    std::vector<T> xs;
+    tree.for_all([&xs](const T& t) { xs.push_back(t); });
+    REQUIRE(std::is_sorted(xs.begin(), xs.end()));
+    REQUIRE(std::adjacent_find(xs.begin(), xs.end()) == xs.end());
+}
+
+TEST_CASE("Concurrent B-tree behaves like a set on one thread", "[concurrent]") {
+    ConcurrentBTree<int, 3> tree;
+    std::set<int> ref;
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::uniform_int_distribution<int> key(0, 10'000);
+
+    for (auto i = 0; i < 100'000; i++) {
+        int k = key(g);
+        switch (g() % 3) {
+        case 0:
+            REQUIRE(tree.remove(k) == (ref.erase(k) == 1));
+            break;
+        case 1:
+            REQUIRE(tree.insert(k) == ref.insert(k).second);
+            break;
+        default:
+            REQUIRE(tree.contains(k) == (ref.count(k) == 1));
+        }
+    }
+
+    check_structure(tree);
+
+    std::vector<int> xs;
+    tree.for_all([&xs](const int& t) { xs.push_back(t); });
+    REQUIRE(xs == std::vector<int>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("Concurrent inserts, lookups and removes", "[concurrent]") {
+    static constexpr size_t THREADS = 4;
+    static constexpr int PER_THREAD = 20'000;
+
+    ConcurrentBTree<int, 4> tree;
+    std::atomic<bool> failed{false};
+
+    /* Thread i owns the keys congruent to i modulo THREADS */
+    auto keys_of = [](size_t i) {
+        std::vector<int> ks;
+        for (int k = 0; k < PER_THREAD; k++)
+            ks.push_back(k * THREADS + i);
+
+        std::mt19937 g(i);
+        std::shuffle(ks.begin(), ks.end(), g);
+        return ks;
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < THREADS; i++) {
+        workers.emplace_back([&, i] {
+            for (auto k : keys_of(i))
+                if (!tree.insert(k))
+                    failed = true;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    REQUIRE_FALSE(failed);
+    check_structure(tree);
+
+    /* Half of the threads remove their odd keys, the other half keeps
+       checking that keys nobody removes are always found. */
+    workers.clear();
+    for (size_t i = 0; i < THREADS; i++) {
+        workers.emplace_back([&, i] {
+            auto ks = keys_of(i);
+
+            if (i % 2 == 0) {
+                for (auto k : ks)
+                    if (k % 2 == 1 && !tree.remove(k))
+                        failed = true;
+            } else {
+                for (auto round = 0; round < 3; round++)
+                    for (auto k : ks)
+                        if (!tree.contains(k))
+                            failed = true;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    REQUIRE_FALSE(failed);
+    check_structure(tree);
+
+    std::vector<int> expected;
+    for (size_t i = 0; i < THREADS; i++)
+        for (auto k : keys_of(i))
+            if (i % 2 == 1 || k % 2 == 0)
+                expected.push_back(k);
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<int> xs;
+    tree.for_all([&xs](const int& t) { xs.push_back(t); });
+    REQUIRE(xs == expected);
+}
+
+TEST_CASE("Concurrent churn on shared keys", "[concurrent]") {
+    static constexpr size_t THREADS = 4;
+
+    ConcurrentBTree<uint64_t, 2> tree;
+    std::vector<std::thread> workers;
+    std::vector<std::set<uint64_t>> owned(THREADS);
+
+    /* Every thread works on the whole key space, but only inserts and
+       removes keys it owns, so the final contents are known. */
+    for (size_t i = 0; i < THREADS; i++) {
+        workers.emplace_back([&, i] {
+            std::mt19937_64 g(i);
+            for (auto op = 0; op < 50'000; op++) {
+                uint64_t k = (g() % 5'000) * THREADS + i;
+                if (g() % 2) {
+                    if (tree.insert(k) != owned[i].insert(k).second)
+                        owned[i].insert(~0ull);
+                } else {
+                    if (tree.remove(k) != (owned[i].erase(k) == 1))
+                        owned[i].insert(~0ull);
+                }
+                tree.contains(g() % (5'000 * THREADS));
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    std::vector<uint64_t> expected;
+    for (auto& s : owned) {
+        REQUIRE(s.count(~0ull) == 0);
+        expected.insert(expected.end(), s.begin(), s.end());
+    }
+    std::sort(expected.begin(), expected.end());
+
+    check_structure(tree);
+
+    std::vector<uint64_t> xs;
+    tree.for_all([&xs](const uint64_t& t) { xs.push_back(t); });
+    REQUIRE(xs == expected);
+}
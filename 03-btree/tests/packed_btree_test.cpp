@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "btree.hpp"
+#include "packed_btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+/* Internal occupancy, equal leaf depths, sorted keys, lanes no narrower
+   than their deltas need, and every key within the bounds of its edge */
+template<typename T, size_t B, size_t LeafBytes>
+static void check_structure(const PackedBTree<T, B, LeafBytes>& tree) {
+    using Tree = PackedBTree<T, B, LeafBytes>;
+    using U = std::make_unsigned_t<T>;
+
+    if (!tree.root)
+        return;
+
+    size_t leaf_depth = tree.depth().value();
+    size_t keys = 0;
+
+    std::function<void(const typename Tree::Node*, size_t, std::optional<T>, std::optional<T>)>
+        check = [&](const typename Tree::Node* node, size_t level,
+                    std::optional<T> lo, std::optional<T> hi) {
+            if (node->type == NodeType::LEAF) {
+                auto* leaf = static_cast<const typename Tree::Leaf*>(node);
+                REQUIRE(level == leaf_depth);
+                REQUIRE(leaf->n <= leaf->capacity());
+                if (node != tree.root)
+                    REQUIRE(leaf->n > 0);
+
+                for (size_t i = 0; i < leaf->n; i++) {
+                    T k = leaf->key(i);
+                    REQUIRE(k >= leaf->base);
+                    REQUIRE(U(U(k) - U(leaf->base)) >> (8 * leaf->width - 1) >> 1 == 0);
+                    if (i > 0)
+                        REQUIRE(leaf->key(i - 1) < k);
+                    if (lo)
+                        REQUIRE(*lo <= k);
+                    if (hi)
+                        REQUIRE(k < *hi);
+                }
+
+                keys += leaf->n;
+                return;
+            }
+
+            auto* internal = static_cast<const typename Tree::Internal*>(node);
+            if (node != tree.root)
+                REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+            else
+                REQUIRE(node->n >= 1);
+
+            for (size_t i = 0; i <= internal->n; i++)
+                check(internal->edges[i], level + 1,
+                      i > 0 ? std::optional<T>(internal->keys[i - 1]) : lo,
+                      i < internal->n ? std::optional<T>(internal->keys[i]) : hi);
+        };
+
+    check(tree.root, 0, std::nullopt, std::nullopt);
+    REQUIRE(keys == tree.size());
+}
+
+template<typename T, size_t B, size_t LeafBytes = 256>
+static void random_ops(unsigned seed, std::function<T(std::mt19937_64&)> next) {
+    PackedBTree<T, B, LeafBytes> tree;
+    std::set<T> ref;
+
+    std::mt19937_64 g(seed);
+
+    for (auto round = 0; round < 30; round++) {
+        for (auto i = 0; i < 2000; i++) {
+            T k = next(g);
+
+            /* Grow for the first rounds, then shrink */
+            if (g() % 30 < (round < 20 ? 20u : 8u))
+                REQUIRE(tree.insert(k) == ref.insert(k).second);
+            else
+                REQUIRE(tree.remove(k) == (ref.erase(k) > 0));
+        }
+
+        std::vector<T> keys;
+        tree.for_all([&keys](const T& k) { keys.push_back(k); });
+        REQUIRE(keys == std::vector<T>(ref.begin(), ref.end()));
+
+        for (auto i = 0; i < 200; i++) {
+            T k = next(g);
+            REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+        }
+
+        check_structure(tree);
+    }
+
+    for (auto k : std::vector<T>(ref.begin(), ref.end()))
+        REQUIRE(tree.remove(k));
+
+    REQUIRE(tree.size() == 0);
+    REQUIRE(tree.depth() == 0);
+    REQUIRE_FALSE(tree.contains(next(g)));
+}
+
+TEST_CASE("Packed B-tree against std::set", "[packed_btree]") {
+    /* Dense: a few thousand values, so leaves hold one-byte lanes */
+    auto dense = [](std::mt19937_64& g) { return uint64_t(1'000'000'000'000 + g() % 30'000); };
+    /* Every lane width, and keys either side of zero */
+    auto mixed = [](std::mt19937_64& g) {
+        int shift = 8 * (1 << (g() % 4));
+        return int64_t(g() >> (64 - shift + 1)) * (g() % 2 ? 1 : -1);
+    };
+    auto full = [](std::mt19937_64& g) { return uint32_t(g()); };
+    auto small = [](std::mt19937_64& g) { return int16_t(g() % 5000); };
+
+    for (unsigned seed = 0; seed < 3; seed++) {
+        random_ops<uint64_t, 2>(seed, dense);
+        random_ops<uint64_t, 16>(seed, dense);
+        random_ops<uint64_t, 3, 32>(seed, dense);
+        random_ops<int64_t, 2, 64>(seed, mixed);
+        random_ops<int64_t, 16>(seed, mixed);
+        random_ops<uint32_t, 4>(seed, full);
+        random_ops<int16_t, 2, 16>(seed, small);
+    }
+}
+
+TEST_CASE("Packed leaves search the edges of the key range", "[packed_btree]") {
+    PackedBTree<int64_t, 4, 32> tree;
+    std::vector<int64_t> keys{ std::numeric_limits<int64_t>::min(), -1, 0, 1,
+                               std::numeric_limits<int64_t>::max() };
+
+    for (int i = 0; i < 300; i++)
+        keys.push_back(i * 7 - 1003);
+
+    for (auto k : keys)
+        REQUIRE(tree.insert(k));
+    for (auto k : keys) {
+        REQUIRE(tree.contains(k));
+        REQUIRE_FALSE(tree.insert(k));
+    }
+
+    REQUIRE_FALSE(tree.contains(std::numeric_limits<int64_t>::min() + 1));
+    REQUIRE_FALSE(tree.contains(std::numeric_limits<int64_t>::max() - 1));
+    REQUIRE_FALSE(tree.contains(-1002));
+    check_structure(tree);
+}
+
+TEST_CASE("Dense keys take fewer bytes than plain leaves", "[packed_btree]") {
+    static constexpr size_t B = 16;
+
+    PackedBTree<uint64_t, B> packed;
+    BTree<uint64_t, B> plain;
+
+    /* IDs handed out in order, with a few gaps */
+    std::mt19937_64 g(3);
+    uint64_t id = 1'700'000'000'000;
+    for (int i = 0; i < 100'000; i++) {
+        id += 1 + g() % 4;
+        packed.insert(id);
+        plain.insert(id);
+    }
+
+    size_t plain_bytes = 0;
+    plain.for_all_nodes([&plain_bytes](const BTreeNode<uint64_t, B>& node) {
+        plain_bytes += node.type == NodeType::LEAF ? sizeof(BTreeLeafNode<uint64_t, B>)
+                                                   : sizeof(BTreeInternalNode<uint64_t, B>);
+    });
+
+    REQUIRE(packed.memory_bytes() * 4 < plain_bytes);
+    REQUIRE(packed.depth().value() <= plain.depth().value());
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "paged_btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+namespace fs = std::filesystem;
+
+struct TempFile {
+    fs::path path;
+
+    explicit TempFile(const std::string& name)
+        : path(fs::temp_directory_path() / (name + "." + std::to_string(getpid()))) {
+        fs::remove(path);
+    }
+
+    ~TempFile() { fs::remove(path); }
+};
+
+TEST_CASE("Paged B-tree matches a reference under eviction", "[paged]") {
+    TempFile file("paged_btree_test");
+    std::multiset<int64_t> ref;
+
+    std::mt19937 g(7);
+    std::uniform_int_distribution<int64_t> key(0, 20'000);
+
+    {
+        /* Few frames and a small B, so most operations fault pages in */
+        PagedBTree<int64_t, 8> tree(file.path, 16);
+
+        for (auto i = 0; i < 100'000; i++) {
+            int64_t k = key(g);
+            switch (g() % 3) {
+            case 0: {
+                auto it = ref.find(k);
+                bool present = it != ref.end();
+                if (present)
+                    ref.erase(it);
+                REQUIRE(tree.remove(k) == present);
+                break;
+            }
+            case 1:
+                tree.insert(k);
+                ref.insert(k);
+                break;
+            default:
+                REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+            }
+        }
+
+        std::vector<int64_t> xs;
+        tree.for_all([&xs](const int64_t& t) { xs.push_back(t); });
+        REQUIRE(xs == std::vector<int64_t>(ref.begin(), ref.end()));
+
+        auto& stats = tree.buffer_pool().stats();
+        REQUIRE(stats.faults > 0);
+        REQUIRE(stats.evictions > 0);
+        REQUIRE(stats.writebacks > 0);
+    }
+
+    /* Everything survives closing and reopening the file */
+    PagedBTree<int64_t, 8> tree(file.path, 16);
+
+    std::vector<int64_t> xs;
+    tree.for_all([&xs](const int64_t& t) { xs.push_back(t); });
+    REQUIRE(xs == std::vector<int64_t>(ref.begin(), ref.end()));
+}
+
+TEST_CASE("Paged B-tree reuses freed pages", "[paged]") {
+    TempFile file("paged_btree_reuse_test");
+    PagedBTree<int32_t> tree(file.path, 8);
+
+    std::vector<int32_t> keys(50'000);
+    std::iota(keys.begin(), keys.end(), 0);
+
+    for (auto k : keys)
+        tree.insert(k);
+    size_t pages = tree.num_pages();
+
+    for (auto k : keys)
+        REQUIRE(tree.remove(k));
+    REQUIRE(tree.depth() == 0);
+
+    for (auto k : keys)
+        tree.insert(k);
+    REQUIRE(tree.num_pages() == pages);
+
+    for (auto k : keys)
+        REQUIRE(tree.contains(k));
+}
+
+TEST_CASE("Paged B-tree rejects a file of another layout", "[paged]") {
+    TempFile file("paged_btree_layout_test");
+
+    {
+        PagedBTree<int64_t, 8> tree(file.path);
+        tree.insert(1);
+    }
+
+    REQUIRE_THROWS((PagedBTree<int64_t, 16>(file.path)));
+    REQUIRE_THROWS((PagedBTree<int32_t, 8>(file.path)));
+    REQUIRE_NOTHROW((PagedBTree<int64_t, 8>(file.path)));
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+#include "string_btree.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+static std::string url(std::mt19937& g) {
+    static const char* hosts[] = { "https://example.com/", "https://example.org/",
+                                   "https://docs.example.com/", "http://a.io/" };
+    std::string k = hosts[g() % 4];
+    k += "path/" + std::to_string(g() % 50) + "/item-" + std::to_string(g() % 2000);
+    return k;
+}
+
+/* Occupancy, equal leaf depths, and every stored prefix shared by all the
+   keys of its node */
+template<size_t B>
+static void check_structure(const StringBTree<B>& tree) {
+    if (!tree.root)
+        return;
+
+    size_t leaf_depth = tree.depth().value();
+
+    std::function<void(const StringBTreeNode<B>*, size_t)> check =
+        [&](const StringBTreeNode<B>* node, size_t level) {
+            if (node != tree.root)
+                REQUIRE((B - 1 <= node->n && node->n <= 2 * B - 1));
+
+            REQUIRE(node->offsets[0] == node->prefix_len);
+            REQUIRE(node->offsets[node->n] == node->data.size());
+            for (size_t i = 0; i + 1 < node->n; i++)
+                REQUIRE(node->key(i) <= node->key(i + 1));
+
+            if (node->type == NodeType::LEAF) {
+                REQUIRE(level == leaf_depth);
+                return;
+            }
+
+            for (size_t i = 0; i <= node->n; i++)
+                check(node->edges[i], level + 1);
+        };
+
+    check(tree.root, 0);
+}
+
+template<size_t B>
+static void random_ops(unsigned seed) {
+    StringBTree<B> tree;
+    std::multiset<std::string> ref;
+
+    std::mt19937 g(seed);
+
+    for (auto round = 0; round < 40; round++) {
+        for (auto i = 0; i < 250; i++) {
+            std::string k = url(g);
+
+            if (g() % 3 != 0) {
+                tree.insert(k);
+                ref.insert(k);
+            } else {
+                bool present = ref.count(k);
+                if (present)
+                    ref.erase(ref.find(k));
+                REQUIRE(tree.remove(k) == present);
+            }
+        }
+
+        std::vector<std::string> keys;
+        tree.for_all([&keys](const std::string& k) { keys.push_back(k); });
+        REQUIRE(keys == std::vector<std::string>(ref.begin(), ref.end()));
+
+        for (auto i = 0; i < 100; i++) {
+            std::string k = url(g);
+            REQUIRE(tree.contains(k) == (ref.count(k) > 0));
+        }
+
+        check_structure(tree);
+    }
+
+    for (auto& k : std::vector<std::string>(ref.begin(), ref.end()))
+        REQUIRE(tree.remove(k));
+
+    REQUIRE(tree.root->n == 0);
+}
+
+TEST_CASE("String B-tree against std::multiset", "[string_btree]") {
+    for (unsigned seed = 0; seed < 5; seed++) {
+        random_ops<2>(seed);
+        random_ops<3>(seed);
+        random_ops<16>(seed);
+    }
+}
+
+TEST_CASE("Keys of a node share their prefix", "[string_btree]") {
+    StringBTree<16> tree;
+    std::mt19937 g(1);
+    std::vector<std::string> keys;
+
+    for (int i = 0; i < 20'000; i++) {
+        keys.push_back("https://example.com/users/" + std::to_string(g() % 1'000'000) + "/profile");
+        tree.insert(keys.back());
+    }
+
+    size_t nodes = 0, compressed = 0;
+    tree.for_all_nodes([&](const StringBTreeNode<16>& node) {
+        nodes++;
+        compressed += node.prefix_len >= std::string("https://example.com/users/").size();
+    });
+
+    REQUIRE(compressed == nodes);
+
+    /* Keys shorter than, or sorting around, the prefix of a node */
+    for (auto k : { "", "h", "https://example.com/", "https://example.com/users/",
+                    "https://example.com/users/~", "zzz" }) {
+        REQUIRE_FALSE(tree.contains(k));
+        tree.insert(k);
+        REQUIRE(tree.contains(k));
+    }
+
+    check_structure(tree);
+
+    for (auto& k : keys)
+        REQUIRE(tree.contains(k));
+}
+
+TEST_CASE("Prefix compression takes less memory than string slots", "[string_btree]") {
+    static constexpr size_t B = 16;
+
+    StringBTree<B> tree;
+    BTree<std::string, B> plain;
+    std::mt19937 g(2);
+
+    for (int i = 0; i < 20'000; i++) {
+        std::string k = url(g);
+        tree.insert(k);
+        plain.insert(k);
+    }
+
+    size_t plain_bytes = 0;
+    plain.for_all_nodes([&plain_bytes](const BTreeNode<std::string, B>& node) {
+        plain_bytes += node.type == NodeType::LEAF ? sizeof(BTreeLeafNode<std::string, B>)
+                                                   : sizeof(BTreeInternalNode<std::string, B>);
+        for (size_t i = 0; i < node.n; i++)
+            if (node.keys[i].capacity() > std::string().capacity())
+                plain_bytes += node.keys[i].capacity() + 1;
+    });
+
+    REQUIRE(tree.memory_bytes() < plain_bytes);
+}